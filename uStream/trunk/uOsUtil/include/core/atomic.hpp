@@ -0,0 +1,194 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef ATOMIC_HPP
+#define ATOMIC_HPP
+
+#include "typedefs.hpp"
+
+/*
+ * Here, we choose the right implementation using
+ * conditional compilation.
+ */
+
+#if defined(_WIN32) || defined(WIN32)
+#include "win32_atomic.hpp"
+#else
+#include "linux_atomic.hpp"
+#endif
+
+/*
+ * Size of a cache line: used to pad data shared by
+ * different threads and avoid false sharing.
+ */
+#define US_CACHE_LINE_SIZE 64
+
+namespace uStreamLib {
+	/**
+	 * Atomic operations on 32 bit integers, 64 bit integers and
+	 * pointers. Read-modify-write operations are full barriers,
+	 * load() has acquire semantics and store() has release semantics.
+	 * All methods are static and inlined.
+	 */
+	class Atomic {
+	public:
+		/**
+		 * Atomically add n to the value pointed by v.
+		 * @return the new value.
+		 */
+		static int32 add(volatile int32* v, int32 n)
+		{
+			return Impl_Atomic::add(v, n);
+		}
+
+		/**
+		 * Atomically increment the value pointed by v.
+		 * @return the new value.
+		 */
+		static int32 increment(volatile int32* v)
+		{
+			return Impl_Atomic::add(v, 1);
+		}
+
+		/**
+		 * Atomically decrement the value pointed by v.
+		 * @return the new value.
+		 */
+		static int32 decrement(volatile int32* v)
+		{
+			return Impl_Atomic::add(v, -1);
+		}
+
+		/**
+		 * Atomically replace the value pointed by v.
+		 * @return the old value.
+		 */
+		static int32 exchange(volatile int32* v, int32 n)
+		{
+			return Impl_Atomic::exchange(v, n);
+		}
+
+		/**
+		 * Atomically replace the pointer pointed by v.
+		 * @return the old pointer.
+		 */
+		static void* exchangePtr(void* volatile* v, void* n)
+		{
+			return Impl_Atomic::exchangePtr(v, n);
+		}
+
+		/**
+		 * Replace the value pointed by v with newval if it
+		 * is equal to oldval.
+		 * @return true if the value has been replaced.
+		 */
+		static bool compareAndSwap(volatile int32* v, int32 oldval,
+			int32 newval)
+		{
+			return Impl_Atomic::cas(v, oldval, newval);
+		}
+
+		/**
+		 * 64 bit version of compareAndSwap().
+		 */
+		static bool compareAndSwap64(volatile uint64* v, uint64 oldval,
+			uint64 newval)
+		{
+			return Impl_Atomic::cas64(v, oldval, newval);
+		}
+
+		/**
+		 * Pointer version of compareAndSwap().
+		 */
+		static bool compareAndSwapPtr(void* volatile* v, void* oldval,
+			void* newval)
+		{
+			return Impl_Atomic::casPtr(v, oldval, newval);
+		}
+
+		/**
+		 * Read a value written by another thread (acquire).
+		 */
+		static int32 load(volatile int32* v)
+		{
+			return Impl_Atomic::load(v);
+		}
+
+		/**
+		 * 64 bit version of load().
+		 */
+		static uint64 load64(volatile uint64* v)
+		{
+			return Impl_Atomic::load64(v);
+		}
+
+		/**
+		 * Pointer version of load().
+		 */
+		static void* loadPtr(void* volatile* v)
+		{
+			return Impl_Atomic::loadPtr(v);
+		}
+
+		/**
+		 * Publish a value to other threads (release).
+		 */
+		static void store(volatile int32* v, int32 n)
+		{
+			Impl_Atomic::store(v, n);
+		}
+
+		/**
+		 * 64 bit version of store().
+		 */
+		static void store64(volatile uint64* v, uint64 n)
+		{
+			Impl_Atomic::store64(v, n);
+		}
+
+		/**
+		 * Pointer version of store().
+		 */
+		static void storePtr(void* volatile* v, void* n)
+		{
+			Impl_Atomic::storePtr(v, n);
+		}
+
+		/**
+		 * Full memory barrier.
+		 */
+		static void barrier(void)
+		{
+			Impl_Atomic::barrier();
+		}
+
+		/**
+		 * Hint the processor that we are spinning.
+		 */
+		static void pause(void)
+		{
+			Impl_Atomic::pause();
+		}
+	};
+}
+
+#endif
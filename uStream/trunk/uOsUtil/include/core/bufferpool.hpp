@@ -23,19 +23,42 @@
 #define BUFFERPOOL_HPP
 
 #include "databuf.hpp"
-#include "pstack.hpp"
 #include "semaphore.hpp"
 #include "mutex.hpp"
+#include "atomic.hpp"
+#include "thread.hpp"
+#include "callback.hpp"
 
 namespace uStreamLib {
 	/**
 	 * This class manages a pool of buffers which can be
-	 * locked or unlocked by different threads. The pool
-	 * uses a SharedQueue to store buffer identifiers.
+	 * locked or unlocked by different threads. Free buffer
+	 * identifiers are kept in a lock-free stack and in small
+	 * per-thread caches (magazines), so getting and freeing
+	 * a buffer takes no lock unless a thread has to wait.
 	 * Each buffer is a DataBuf.
+	 * The pool is elastic: it grows when getters keep finding it
+	 * empty, up to a maximum count, and gives memory back after
+	 * sustained idle (see housekeep()) or on trim(). Buffers in
+	 * use are never touched: they are retired when freed.
 	 */
 	class US_API_EXPORT BufferPool : public Object {
 	public:
+		/**
+		 * Flags for init().
+		 */
+		enum {
+		/**
+		 * Carve all buffers out of one contiguous memory region
+		 * instead of allocating each of them on the heap.
+		 */
+		POOL_CONTIGUOUS = 1,
+		/**
+		 * Back the contiguous region with huge pages when the
+		 * system allows it (implies POOL_CONTIGUOUS).
+		 */
+		POOL_HUGEPAGES = 2 };
+
 		/**
 		 * Constructor.
 		 */
@@ -51,24 +74,126 @@ namespace uStreamLib {
 		 * @param bsize buffer size.
 		 * @param bcount buffers count.
 		 * @param limit size limit for each buffer.
+		 * @param strategy allocation strategy of each buffer,
+		 * possibly with an alignment flag.
+		 * @param flags POOL_* flags.
+		 * @param maxcount the count the pool can grow to (zero or
+		 * less than bcount means bcount).
 		 * @return SUCCESS or FAILURE.
 		 */
 		int32 init(
 			char* name,		// buffer pool's name
 	  		uint32 bsize,		// single buffer size
 	  		uint32 bcount,		// buffers count
-	  		uint32 limit = 8388608	// size limit for each buffer
+	  		uint32 limit = 8388608,	// size limit for each buffer
+			DataBuf::AllocStrategy strategy = DataBuf::ALLOC_ONUSE,
+			uint32 flags = 0,	// POOL_* flags
+			uint32 maxcount = 0	// max buffers count
 		);
 
 		/**
-		 * Resize the whole buffer pool and its buffers.
-		 * Don't use this method.
+		 * Create a buffer pool viewing buffers in a memory region
+		 * owned by someone else, eg. shared with another process.
+		 * Buffers of a view are never handed out by getBuffer():
+		 * the owner of the region gives them with claimBuffer()
+		 * and gets them back through a callback when they are
+		 * freed. A view never grows or shrinks.
+		 * @param region the memory holding the buffers.
+		 * @param stride distance between two buffers in region.
+		 * @param bsize buffer size.
+		 * @param bcount buffers count.
+		 * @param freecb callback performed with a pointer to the
+		 * buffer id when a buffer is freed.
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 initView(
+			char* name,		// buffer pool's name
+			char* region,		// memory holding buffers
+			uint32 stride,		// distance between buffers
+			uint32 bsize,		// single buffer size
+			uint32 bcount,		// buffers count
+			CallBack* freecb	// performed on free
+		);
+
+		/**
+		 * Hand out a buffer of a view (see initView()). The buffer
+		 * gets back its slice of the region if it was stretched
+		 * out of it.
+		 * @param bid the buffer id.
+		 * @return the buffer holding the first reference or NULL
+		 * if bid is out of range.
+		 */
+		DataBuf* claimBuffer(uint32 bid);
+
+		/**
+		 * Check if a buffer of a view still uses its slice of the
+		 * region, ie. it was not stretched beyond its size.
+		 * @param bid the buffer id.
+		 * @return true if the buffer is in the region.
+		 */
+		bool isInRegion(uint32 bid)
+		{
+			return bid < _bcount &&
+				_bufs[bid]->getAddr() == &_region[bid * _stride];
+		}
+
+		/**
+		 * Resize the whole buffer pool. New buffers get the new
+		 * size, buffers already allocated are stretched by DataBuf
+		 * when needed. The pool grows or shrinks to the new count,
+		 * which becomes the count restored by growing after a
+		 * shrink. Buffers in use stay valid.
 		 * @param bsize new buffer size.
 		 * @param bcount new buffers count.
-		 * @return SUCCESS or FAILURE.
+		 * @return SUCCESS or FAILURE if bcount is zero or greater
+		 * than the max count given to init().
 		 */
 		int32 resize(uint32 bsize, uint32 bcount);
 
+		/**
+		 * Shrink this pool to the specified count of buffers.
+		 * Free buffers are retired at once and their memory is
+		 * released, buffers in use are retired when freed.
+		 * @param bcount the desired count (at least 1).
+		 */
+		void shrink(uint32 bcount);
+
+		/**
+		 * Give back the memory of every free buffer but one,
+		 * eg. when the stream is paused or stopped. The pool grows
+		 * back on demand.
+		 */
+		void trim(void)
+		{
+			shrink(1);
+		}
+
+		/**
+		 * Check for sustained idle. Call this method periodically:
+		 * when some buffers were never used for a few periods in a
+		 * row the pool shrinks by half of them.
+		 */
+		void housekeep(void);
+
+		/**
+		 * Allocate the memory of every buffer and touch it, so that
+		 * using the buffers does not cause page faults. From now on
+		 * the pool keeps its memory: shrink(), trim() and housekeep()
+		 * do nothing.
+		 * @return SUCCESS or FAILURE if some memory cannot be
+		 * allocated.
+		 */
+		int32 prefault(void);
+
+		/**
+		 * Move the memory of the buffers to a NUMA node, eg. the node
+		 * of the block consuming them (see Memory::bindToNode()).
+		 * Memory allocated later is placed by the system as usual.
+		 * @param node the node.
+		 * @return SUCCESS or FAILURE if some memory cannot be moved.
+		 */
+		int32 bindToNode(uint32 node);
+
 		/**
 		 * Get the next free buffer.
 		 * @return a free buffer id to use with use() method.
@@ -85,6 +210,9 @@ namespace uStreamLib {
 
 		/**
 		 * Free specified buffer.
+		 * If the buffer is shared (see DataBuf::addRef()) this
+		 * method only drops a reference: the buffer goes back to
+		 * the pool when its last reference is released.
 		 * @param bid the buffer id of the buffer to free.
 		 */
 		void freeBuffer(uint32 bid);
@@ -95,7 +223,27 @@ namespace uStreamLib {
 		 * @return a pointer to the DataBuf to use or NULL if bid
 		 * is out of range.
 		 */
-		DataBuf* use(uint32 bid);
+		DataBuf* use(uint32 bid)
+		{
+			return (bid < _bcount) ? _bufs[bid] : NULL;
+		}
+
+		/**
+		 * Ask to be told when a buffer is freed, eg. by a block
+		 * which sleeps because this pool is empty. The callback is
+		 * performed once, with a pointer to this pool, by the thread
+		 * freeing the next buffer.
+		 * @param cb the callback.
+		 * @return SUCCESS or FAILURE if too many callbacks are
+		 * waiting.
+		 */
+		int32 notifyOnFree(CallBack* cb);
+
+		/**
+		 * Cancel a callback registered by notifyOnFree().
+		 * @param cb the callback.
+		 */
+		void cancelNotify(CallBack* cb);
 
 		/**
 		 * Get buffers count.
@@ -103,6 +251,25 @@ namespace uStreamLib {
 		 */
 		int32 getBuffersCount(void);
 
+		/**
+		 * Get the count this pool can grow to.
+		 * @return the max buffers count.
+		 */
+		int32 getMaxBuffersCount(void)
+		{
+			return _maxcount;
+		}
+
+		/**
+		 * Get the size buffers are created with (see init() and
+		 * resize()).
+		 * @return the default buffer size.
+		 */
+		uint32 getDefaultBufferSize(void)
+		{
+			return _bsize;
+		}
+
 		/**
 		 * Get free buffers count.
 		 * @return free buffers count.
@@ -122,6 +289,26 @@ namespace uStreamLib {
 		 */
 		void reset(void);
 
+		/**
+		 * Register another user (eg. a pin) of this buffer pool.
+		 * A new pool has one user.
+		 * @return the count of users.
+		 */
+		int32 attach(void)
+		{
+			return Atomic::increment(&_users);
+		}
+
+		/**
+		 * Unregister a user of this buffer pool.
+		 * @return the count of remaining users: when zero the
+		 * pool can be deleted.
+		 */
+		int32 detach(void)
+		{
+			return Atomic::decrement(&_users);
+		}
+
 		/**
 		 * Get this buffer pool's name.
 		 */
@@ -139,23 +326,137 @@ namespace uStreamLib {
 		// buffer pool's name
 		DataBuf _dbName;
 
+		// sizes of the per-thread caches
+		enum { _MAGAZINES = 8, _MAGAZINE_SIZE = 4, _NIL = 0xffffffff };
+
+		// empty gets before growing beyond the base count
+		enum { _GROW_MISSES = 8 };
+
+		// idle housekeeping periods before shrinking
+		enum { _IDLE_ROUNDS = 4 };
+
+		// callbacks waiting for a free buffer
+		enum { _NOTIFY_SLOTS = 4 };
+
+		// per-thread cache: bid + 1 or 0 for each slot
+		struct Magazine {
+			volatile int32 slots[_MAGAZINE_SIZE];
+			char pad[US_CACHE_LINE_SIZE - _MAGAZINE_SIZE * sizeof(int32)];
+		};
+
+		// take a free buffer: cache, stack, other caches
+		bool _take(uint32* bid);
+
+		// account for a buffer taken from the free ones
+		void _used(void);
+
+		// push a bid into the free stack
+		void _push(uint32 bid);
+
+		// pop a bid from the free stack
+		uint32 _pop(void);
+
+		// add buffers when the pool is found empty
+		bool _grow(bool wait);
+
+		// create or revive a buffer and make it free
+		bool _addBuffer(void);
+
+		// retire a free buffer and release its memory (locked)
+		void _park(uint32 bid);
+
+		// retire a freed buffer if a shrink is pending
+		bool _retire(uint32 bid);
+
+		// shrink with _mutexReset locked
+		void _shrink(uint32 bcount);
+
+		// perform the callbacks waiting for a free buffer
+		void _notifyFree(void);
+
+		// get the cache of the calling thread
+		Magazine* _magazine(void)
+		{
+			return &_mags[Thread::getCurrentSlot() % _MAGAZINES];
+		}
+
 		// buffers array
 		DataBuf** _bufs;
 
-		// count of buffers (locked + unlocked)
-		uint32 _bcount;
+		// count of created buffers (in use, free or parked)
+		volatile uint32 _bcount;
 
-		// free buffer stack
-		PStack _psFree;
+		// count of buffers in circulation (in use or free)
+		volatile int32 _live;
 
-		// semaphore for counting free buffers
-		Semaphore _semFree;
+		// max count of buffers (size of arrays)
+		uint32 _maxcount;
+
+		// count restored at once when growing
+		uint32 _basecount;
+
+		// flags: buffer is retired (indexed by bid)
+		bool* _parked;
+
+		// count of buffers in use to retire when freed
+		volatile int32 _retiring;
+
+		// consecutive empty gets
+		volatile int32 _misses;
+
+		// lowest count of free buffers since last housekeep()
+		volatile int32 _lowfree;
+
+		// consecutive idle periods
+		uint32 _idle;
+
+		// parameters for new buffers
+		uint32 _bsize;
+		uint32 _limit;
+		DataBuf::AllocStrategy _strategy;
 
-		// semaphore for counting used buffers
-		Semaphore _semUsed;
+		// free stack links: next free bid for each bid
+		volatile uint32* _next;
+
+		// free stack head: bid in the low word, ABA tag in the high word
+		volatile uint64 _head;
+
+		// count of free buffers (stack + caches)
+		volatile int32 _free;
+
+		// count of threads waiting for a free buffer
+		volatile int32 _waiters;
+
+		// per-thread caches
+		Magazine _mags[_MAGAZINES];
+
+		// semaphore to wait for free buffers
+		Semaphore _semFree;
 
 		// mutex to allow thread safe reset
 		Mutex _mutexReset;
+
+		// count of users sharing this pool
+		volatile int32 _users;
+
+		// contiguous memory region holding buffers (or NULL)
+		char* _region;
+
+		// size of the contiguous memory region (0 if not owned)
+		size_t _regionSize;
+
+		// distance between buffers in the region
+		uint32 _stride;
+
+		// callback for freed buffers of a view (or NULL)
+		CallBack* _freecb;
+
+		// callbacks waiting for a free buffer and their count
+		void* volatile _notify[_NOTIFY_SLOTS];
+		volatile int32 _notifying;
+
+		// flag: memory is never given back (see prefault())
+		bool _pinned;
 	};
 }
 
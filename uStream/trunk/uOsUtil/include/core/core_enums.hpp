@@ -55,7 +55,11 @@ namespace uStreamLib {
 	UOSUTIL_RTTI_MEMORY_MAPPED_FILE, UOSUTIL_RTTI_MEMORY_MAPPED_VIEW,
 	UOSUTIL_RTTI_SCRIPTABLE_COMPONENT, UOSUTIL_RTTI_MACHINE_TASK,
 	UOSUTIL_RTTI_MACHINE_TASK_SCHEDULER, UOSUTIL_RTTI_REPORT_ENGINE,
-	UOSUTIL_RTTI_REPORTABLE, UOSUTIL_RTTI_LAST_ID };
+	UOSUTIL_RTTI_REPORTABLE, UOSUTIL_RTTI_DATA_CHAIN,
+	UOSUTIL_RTTI_SHARED_MEMORY, UOSUTIL_RTTI_SHM_CHANNEL,
+	UOSUTIL_RTTI_WAITSET, UOSUTIL_RTTI_CPU_TOPOLOGY,
+	UOSUTIL_RTTI_TYPED_SPSC_QUEUE, UOSUTIL_RTTI_TYPED_MPSC_QUEUE,
+	UOSUTIL_RTTI_LAST_ID };
 
 	/**
 	 * These are error codes.
@@ -0,0 +1,150 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef CPU_TOPOLOGY_HPP
+#define CPU_TOPOLOGY_HPP
+
+#include "object.hpp"
+
+namespace uStreamLib {
+	/**
+	 * This class describes how the processors of this machine share
+	 * cores, caches, packages (sockets) and NUMA nodes. Processor sets
+	 * are bit masks like the ones taken by Thread::setAffinity(), so
+	 * only the first MAX_CPUS processors are described.
+	 */
+	class US_API_EXPORT CpuTopology : public Object {
+	public:
+		/**
+		 * Max count of processors described.
+		 */
+		enum { MAX_CPUS = 64 };
+
+		/**
+		 * What processors may share (see getMask()).
+		 */
+		enum { SHARE_CORE = 0, SHARE_L2 = 1, SHARE_L3 = 2,
+		SHARE_PACKAGE = 3, SHARE_NODE = 4 };
+
+		/**
+		 * Description of a processor. Caches are identified by the
+		 * lowest processor sharing them.
+		 */
+		struct CpuInfo {
+			uint32 cpu;	// processor number
+			uint32 core;	// core (within the package)
+			uint32 package;	// physical package
+			uint32 node;	// NUMA node
+			uint32 l2;	// L2 cache
+			uint32 l3;	// last level cache
+		};
+
+		/**
+		 * Constructor.
+		 */
+		CpuTopology(void);
+
+		/**
+		 * Destructor.
+		 */
+		virtual ~CpuTopology(void);
+
+		/**
+		 * Read the topology of this machine. Processors the system
+		 * tells nothing about get a core, caches and package of their
+		 * own, on node 0.
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 init(void);
+
+		/**
+		 * Get the count of online processors described.
+		 * @return the count of processors (at least 1).
+		 */
+		uint32 getCpusCount(void)
+		{
+			return _count;
+		}
+
+		/**
+		 * Get the description of a processor.
+		 * @param i index from 0 to getCpusCount() - 1 (not the
+		 * processor number).
+		 * @return the description or NULL if i is out of range.
+		 */
+		CpuInfo* getCpu(uint32 i)
+		{
+			return i < _count ? &_cpus[i] : NULL;
+		}
+
+		/**
+		 * Get the count of NUMA nodes.
+		 * @return the highest node number plus one.
+		 */
+		uint32 getNodesCount(void)
+		{
+			return _nodes;
+		}
+
+		/**
+		 * Get the processors sharing something with a processor.
+		 * @param cpu the processor number.
+		 * @param what one of SHARE_* values.
+		 * @return a bit for each processor, or 0 if cpu is unknown.
+		 */
+		uint64 getMask(uint32 cpu, int32 what);
+
+		/**
+		 * Get the processors of a NUMA node.
+		 * @param node the node number.
+		 * @return a bit for each processor.
+		 */
+		uint64 getNodeMask(uint32 node);
+
+		/**
+		 * Parse a list of processors like "0-3,6".
+		 * @param list the list.
+		 * @param cpus where to store a bit for each processor.
+		 * @return SUCCESS or FAILURE if the list is malformed, empty
+		 * or names processors beyond MAX_CPUS.
+		 */
+		static int32 parseList(char* list, uint64* cpus);
+
+	private:
+		/* copy constructor not available */
+		CpuTopology(CpuTopology&)
+			: Object(UOSUTIL_RTTI_CPU_TOPOLOGY)
+		{
+		}
+
+		/* processors, sorted by number */
+		CpuInfo _cpus[MAX_CPUS];
+
+		/* count of processors */
+		uint32 _count;
+
+		/* count of NUMA nodes */
+		uint32 _nodes;
+	};
+}
+
+#endif
@@ -27,6 +27,7 @@
 #include <string.h>
 
 #include "object.hpp"
+#include "atomic.hpp"
 
 namespace uStreamLib {
 	/*
@@ -55,7 +56,8 @@ namespace uStreamLib {
 		 * Constants that specify the allocation method. Allocation
 		 * methods are useful when DataBuf is used with BufferPool
 		 * class. Memory is allocated on demand or preallocated in
-		 * the constructor.
+		 * the constructor. An alignment flag can be or-ed to one of
+		 * the two methods.
 		 */
 		enum AllocStrategy { 
 		/**
@@ -68,7 +70,16 @@ namespace uStreamLib {
 		 * allocates memory when copy(), xcopy() and merge() methods
 		 * are invoked.
 		 */
-		ALLOC_ONUSE = 2 };
+		ALLOC_ONUSE = 2,
+		/**
+		 * Align memory to a cache line (64 bytes), eg. for SIMD
+		 * loads and non-temporal stores.
+		 */
+		ALLOC_ALIGN_CACHE = 4,
+		/**
+		 * Align memory to a page boundary.
+		 */
+		ALLOC_ALIGN_PAGE = 8 };
 
 		/**
 		 * Constructor.
@@ -134,6 +145,35 @@ namespace uStreamLib {
 			m_bInUse = value;
 		}
 
+		/**
+		 * Add n references to this buffer. A buffer taken from a
+		 * BufferPool starts with one reference: each consumer that
+		 * shares the buffer must hold its own reference and the
+		 * buffer goes back to the pool when the last one is released.
+		 * @param n number of references to add.
+		 */
+		void addRef(int32 n = 1)
+		{
+			Atomic::add(&m_iRefCount, n);
+		}
+
+		/**
+		 * Drop a reference to this buffer.
+		 * @return the number of references still held.
+		 */
+		int32 release(void)
+		{
+			return Atomic::decrement(&m_iRefCount);
+		}
+
+		/**
+		 * Get the number of references held on this buffer.
+		 */
+		int32 getRefCount(void)
+		{
+			return Atomic::load(&m_iRefCount);
+		}
+
 		/**
 		 * Get the buffer id.
 		 */
@@ -397,8 +437,32 @@ namespace uStreamLib {
 		/* flag: in use */
 		bool m_bInUse;
 
+		/* references held by consumers (pooled buffers only) */
+		volatile int32 m_iRefCount;
+
 		/* memory allocation strategy */
 		AllocStrategy m_asStrategy;
+
+		/* flag: memory block is not owned (eg. a BufferPool region) */
+		bool m_bExternal;
+
+		/* get the alignment required by the strategy (0 = none) */
+		size_t _alignment(void);
+
+		/* allocate a memory block of m_uSize bytes */
+		char* _allocBlock(void);
+
+		/* resize the memory block to m_uSize bytes keeping its data */
+		char* _reallocBlock(uint32 old_size);
+
+		/* free the memory block */
+		void _freeBlock(void);
+
+		/* use memory which is not owned (see BufferPool) */
+		void _setExternal(char* block, uint32 size);
+
+		/* release owned memory, it is allocated again on use */
+		void _releaseBlock(void);
 	};
 }
 
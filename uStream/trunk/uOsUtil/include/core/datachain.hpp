@@ -0,0 +1,219 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef DATACHAIN_HPP
+#define DATACHAIN_HPP
+
+#include "databuf.hpp"
+
+namespace uStreamLib {
+	/**
+	 * A segment of a DataChain: a run of contiguous bytes, laid out
+	 * as a struct iovec is.
+	 */
+	struct US_API_EXPORT dsegment_t {
+		/** first byte of the segment */
+		char* addr;
+
+		/** count of bytes in the segment */
+		uint32 size;
+	};
+
+	typedef struct dsegment_t dsegment;
+
+	/**
+	 * This class chains buffers (usually BufferPool buffers) into
+	 * a single logical payload, so that variable size chunks can be
+	 * stitched together without reallocating or linearizing them.
+	 * The chain can be written at once with a gather write (see
+	 * FileOutputStream::write(DataChain*)) or read segment by
+	 * segment like an Enumeration.
+	 * A chained pool buffer holds a reference (see DataBuf::addRef())
+	 * which is dropped by clear() or consume().
+	 */
+	class US_API_EXPORT DataChain : public Object {
+	public:
+		/**
+		 * Constructor.
+		 */
+		DataChain(void);
+
+		/**
+		 * Destructor. Chained buffers are released.
+		 */
+		virtual ~DataChain(void);
+
+		/**
+		 * Create a chain.
+		 * @param maxsegs max count of segments.
+		 * @param bp the buffer pool write() takes buffers from, or
+		 * NULL if only append() is used.
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 init(uint32 maxsegs, BufferPool* bp = NULL);
+
+		/**
+		 * Chain the whole content (getCount() bytes) of a buffer.
+		 * @param db the buffer to chain.
+		 * @return SUCCESS or FAILURE if the chain is full.
+		 */
+		int32 append(DataBuf* db)
+		{
+			return append(db, 0, db->getCount());
+		}
+
+		/**
+		 * Chain part of a buffer. The buffer is not copied: a pool
+		 * buffer gets a new reference, any other buffer must live
+		 * as long as the chain uses it.
+		 * @param db the buffer to chain.
+		 * @param offset first byte to chain.
+		 * @param size count of bytes to chain.
+		 * @return SUCCESS or FAILURE if the chain is full or the
+		 * range is not in the buffer.
+		 */
+		int32 append(DataBuf* db, uint32 offset, uint32 size);
+
+		/**
+		 * Copy data at the end of the chain. Free room in the last
+		 * segment is used first, then buffers are taken from the
+		 * buffer pool: nothing is ever reallocated.
+		 * @param data bytes to copy.
+		 * @param size count of bytes to copy.
+		 * @param wait true to wait for free buffers in the pool.
+		 * @return SUCCESS or FAILURE if there is no pool, the chain
+		 * is full or (not waiting) the pool is empty.
+		 */
+		int32 write(char* data, uint32 size, bool wait = true);
+
+		/**
+		 * Copy bytes out of the chain.
+		 * @param offset offset in the chain of the first byte.
+		 * @param data destination.
+		 * @param size count of bytes to copy.
+		 * @return count of bytes copied.
+		 */
+		uint32 read(uint32 offset, char* data, uint32 size);
+
+		/**
+		 * Drop bytes from the start of the chain, eg. after a
+		 * partial write. Buffers emptied are released.
+		 * @param size count of bytes to drop.
+		 */
+		void consume(uint32 size);
+
+		/**
+		 * Release all buffers. The chain becomes empty.
+		 */
+		void clear(void);
+
+		/**
+		 * Get count of bytes in the chain.
+		 * @return count of bytes.
+		 */
+		uint32 getCount(void)
+		{
+			return _count;
+		}
+
+		/**
+		 * Get count of segments.
+		 * @return count of segments.
+		 */
+		uint32 getSegmentsCount(void)
+		{
+			return _nsegs;
+		}
+
+		/**
+		 * Get all segments, eg. to build an iovec array.
+		 * @return an array of getSegmentsCount() segments.
+		 */
+		dsegment* getSegments(void)
+		{
+			return _segs;
+		}
+
+		/**
+		 * Rewind the segment iterator.
+		 */
+		void rewind(void)
+		{
+			_cur = 0;
+		}
+
+		/**
+		 * Check if the segment iterator has more segments.
+		 * @return true or false.
+		 */
+		bool hasMoreSegments(void)
+		{
+			return _cur < _nsegs;
+		}
+
+		/**
+		 * Get the next segment. Don't call this method if
+		 * hasMoreSegments() has returned false.
+		 * @return a pointer to the next segment.
+		 */
+		dsegment* nextSegment(void)
+		{
+			return &_segs[_cur++];
+		}
+
+	private:
+		/* copy constructor not available */
+		DataChain(DataChain&)
+			: Object(UOSUTIL_RTTI_DATA_CHAIN)
+		{
+		}
+
+		/* release the buffer of a segment */
+		void _release(uint32 i);
+
+		/* segments (iovec view) */
+		dsegment* _segs;
+
+		/* buffers of segments */
+		DataBuf** _bufs;
+
+		/* flags: buffer got by write() (has free room) */
+		bool* _owned;
+
+		/* max count of segments */
+		uint32 _maxsegs;
+
+		/* count of segments */
+		uint32 _nsegs;
+
+		/* count of bytes */
+		uint32 _count;
+
+		/* segment iterator position */
+		uint32 _cur;
+
+		/* buffer pool for write() */
+		BufferPool* _bp;
+	};
+}
+
+#endif
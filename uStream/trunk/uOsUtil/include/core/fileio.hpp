@@ -24,6 +24,7 @@
 
 #include "object.hpp"
 #include "databuf.hpp"
+#include "datachain.hpp"
 
 namespace uStreamLib {
 
@@ -236,6 +237,15 @@ namespace uStreamLib {
 		 */
 		int32 write(DataBuf* buf, uint32 offset, uint32 size);
 
+		/**
+		 * Write all bytes of a chain with a single gather write
+		 * when the system provides it.
+		 * @param chain the chain to get bytes from.
+		 * @return the number of bytes written or FAILURE if an error
+		 * occurs.
+		 */
+		int32 write(DataChain* chain);
+
 		/**
 		 * Method to seek in the stream.
 		 * @param offset the offset position in bytes.
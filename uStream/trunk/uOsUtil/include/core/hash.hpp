@@ -27,6 +27,14 @@
 #include "databuf.hpp"
 
 namespace uStreamLib {
+	/**
+	 * An hash table mapping keys to values. Values are either copied
+	 * into the table (put) or stored as pointers (pput). The table
+	 * uses open addressing with Robin Hood probing: entries live in a
+	 * flat array of slots which keeps the full hash code of each key,
+	 * so probes compare keys only when codes match. The table doubles
+	 * its slots when it gets 3/4 full.
+	 */
 	class US_API_EXPORT Hash : public Object {
 	public:
 		/**
@@ -54,8 +62,8 @@ namespace uStreamLib {
 
 		/**
 		 * Build an hash table.
-		 * @param size hash buckets. Please, specify a number that is
-		 * far from a power of 2 and possible prime.
+		 * @param size initial count of slots, rounded up to a power
+		 * of 2. The table grows as needed.
 		 * @return SUCCESS or FAILURE if out of memory.
 		 */
 		int32 init(uint32 size);
@@ -65,7 +73,8 @@ namespace uStreamLib {
 		 * This method is invoked when an hash code is needed.
 		 * @param key a pointer to the key buffer.
 		 * @param key_size key size in bytes.
-		 * @param hash_size number of buckets in the hash table.
+		 * @param hash_size number of buckets in the hash table or 0
+		 * for the full 32 bit code (the table itself asks for this).
 		 * @return an hash code.
 		 */
 		virtual uint32 hashCode(char* key, uint32 key_size, uint32 hash_size);
@@ -82,7 +91,7 @@ namespace uStreamLib {
 		void statistics(void);
 
 		/**
-		 * Get current hash size.
+		 * Get current count of slots.
 		 */
 		uint32 getSize(void)
 		{
@@ -172,35 +181,32 @@ namespace uStreamLib {
 		{
 		}
 
-		/* hash element */
+		/* hash slot */
 		struct hash_elem_t {
-			/* ptr to the key */
+			/* ptr to the key, followed by the copied value if any */
 			char* key;
 
-			/* key size */
-			uint32 key_size;
-
 			/* related value (memcopied) */
 			char* value;
 
-			/* value size */
-			uint32 value_size;
-
 			/* related value (not memcopied) */
 			char* pvalue;
 
-			/* collision chain */
-			struct hash_elem_t* next;
+			/* key size */
+			uint32 key_size;
 
-			/* empty marker */
-			bool empty;
+			/* value size */
+			uint32 value_size;
 
-			/* collision chain length */
-			uint32 hit_count;
+			/* full hash code of the key */
+			uint32 code;
+
+			/* distance from the home slot plus one, 0 if empty */
+			uint32 dist;
 		}
 		* _hte;
 
-		/* number of buckets */
+		/* number of slots (a power of 2) */
 		uint32 _size;
 
 		/* number of elements */
@@ -220,6 +226,19 @@ namespace uStreamLib {
 
 		/* method to delete a hash_elem */
 		void _htefree(struct hash_elem_t* hte);
+
+		/* find the slot of a key or return -1 */
+		int32 _find(char* key, uint32 key_size, uint32 code);
+
+		/* place an entry, moving richer entries further */
+		void _insert(struct hash_elem_t* hte);
+
+		/* make room for one more entry */
+		int32 _reserve(void);
+
+		/* copy key and value into a new block of an entry */
+		int32 _store(struct hash_elem_t* hte, char* key, uint32 key_size,
+			char* val, uint32 val_size);
 	};
 }
 
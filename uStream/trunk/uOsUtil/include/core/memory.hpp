@@ -66,6 +66,70 @@ namespace uStreamLib {
 
 			return retval;
 		}
+
+		/**
+		 * Allocate memory aligned to the specified boundary.
+		 * @param size count of bytes to allocate.
+		 * @param alignment a power of 2, multiple of sizeof(void*).
+		 * @return a pointer to the memory or NULL. Free it with
+		 * alignedFree().
+		 */
+		static void* alignedAlloc(size_t size, size_t alignment);
+
+		/**
+		 * Free memory got by alignedAlloc().
+		 * @param ptr pointer to the memory.
+		 */
+		static void alignedFree(void* ptr);
+
+		/**
+		 * Get the size of a memory page.
+		 * @return page size in bytes.
+		 */
+		static size_t getPageSize(void);
+
+		/**
+		 * Map a page aligned region of memory. With hugepages the
+		 * region is backed by huge pages if the system reserved some,
+		 * otherwise transparent huge pages are requested.
+		 * @param size count of bytes to map: on return, the count of
+		 * bytes mapped (rounded to the page size).
+		 * @param hugepages if true, use huge pages.
+		 * @return a pointer to the region or NULL.
+		 */
+		static void* mapRegion(size_t* size, bool hugepages = false);
+
+		/**
+		 * Unmap a region got by mapRegion().
+		 * @param ptr pointer to the region.
+		 * @param size count of bytes mapped.
+		 */
+		static void unmapRegion(void* ptr, size_t size);
+
+		/**
+		 * Lock the memory of this process in RAM, memory mapped or
+		 * allocated later included, so that real time threads do
+		 * not get page faults. Needs privileges (eg. CAP_IPC_LOCK
+		 * or a high enough RLIMIT_MEMLOCK).
+		 * @return SUCCESS or FAILURE.
+		 */
+		static int32 lockAll(void);
+
+		/**
+		 * Undo lockAll().
+		 */
+		static void unlockAll(void);
+
+		/**
+		 * Ask the system to keep some memory on a NUMA node, moving
+		 * the pages already there. Whole pages are affected: memory
+		 * sharing a page with ptr moves too.
+		 * @param ptr pointer to the memory.
+		 * @param size count of bytes.
+		 * @param node the node.
+		 * @return SUCCESS or FAILURE if not supported.
+		 */
+		static int32 bindToNode(void* ptr, size_t size, uint32 node);
 	private:
 		/* registered copy function names count */
 		enum { _MEMORY_FNAME_SIZE = 50 };
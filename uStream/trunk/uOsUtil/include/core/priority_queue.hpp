@@ -23,23 +23,30 @@
 #ifndef PRIORITYQUEUE_HPP
 #define PRIORITYQUEUE_HPP
 
-#include "shared_queue.hpp"
+#include "queue.hpp"
 #include "semaphore.hpp"
 #include "mutex.hpp"
+#include "waitset.hpp"
 
 namespace uStreamLib {
 	/**
-	 * This is a priority queue that can be shared between a consumer
-	 * and a producer thread. The queue provides N priority levels and
-	 * and out of band (OOB) level which is the highest priority
-	 * available. There is an anti-starvation mechanism to avoid
-	 * starvation of lowest priority items. The get() is controlled by
-	 * drawing rates (double) which tune the amount of items to retrieve
-	 * for a specific priority.
+	 * This is a priority queue that can be shared between consumer
+	 * and producer threads. The queue provides N priority levels and
+	 * an out of band (OOB) level which is the highest priority
+	 * available: OOB items are always got first. The other levels are
+	 * drained in turn, each one giving up to a quantum of items before
+	 * the next non-empty level is served (deficit round robin), so
+	 * that no level starves. The quanta are set by drawing rates
+	 * (double): the share of a level's capacity drawn in a turn.
 	 * 
-	 * The priority goes from 0 which is the max to N which is the min.
-	 * The constants PRI_MAX and PRI_OOB can be used in put() to specify
-	 * the max priority and the out of band priority respectively.
+	 * All levels live in a single ring memory block. A bitmap of the
+	 * non-empty levels finds the next level to serve in constant
+	 * time, so many levels cost about the same as one.
+	 * 
+	 * The priority goes from 0 which is the max to N - 1 which is the
+	 * min. The constants PRI_MAX and PRI_OOB can be used in put() to
+	 * specify the max priority and the out of band priority
+	 * respectively.
 	 */
 	class US_API_EXPORT PriorityQueue : public Queue {
 	public:
@@ -48,6 +55,11 @@ namespace uStreamLib {
 		 */
 		enum PriorityID { PRI_OOB = -1, PRI_MAX = 0 };
 
+		/**
+		 * Max count of priority levels.
+		 */
+		enum { MAX_LEVELS = 1024 };
+
 		/**
 		 * Constructor.
 		 */
@@ -60,26 +72,75 @@ namespace uStreamLib {
 
 		/**
 		 * Initialize a priority queue.
+		 * @param name queue's name.
+		 * @param max_item_size max item size.
+		 * @param capacity capacity of the priority levels, split
+		 * evenly among them.
+		 * @param priority_levels count of priority levels, from 1 to
+		 * MAX_LEVELS.
+		 * @param oob_capacity capacity of the OOB level.
+		 * @return SUCCESS or FAILURE.
 		 */
 		int32 init(char* name, uint32 max_item_size, int32 capacity,
 			int32 priority_levels, int32 oob_capacity = 10);
 
+		/**
+		 * Get next item from the queue.
+		 * This method blocks until an item is available.
+		 * @param item pointer to a buffer to store the item into.
+		 * @param size size of the buffer.
+		 * @return SUCCESS or FAILURE if an error occurred.
+		 */
 		int32 get(char* item, uint32 size)
 		{
-			return _get(true, item, size);
+			return _get(-1, item, size);
 		}
 
+		/**
+		 * Get next item from the queue.
+		 * @param item pointer to a buffer to store the item into.
+		 * @param size size of the buffer.
+		 * @return SUCCESS or FAILURE if the queue is empty.
+		 */
 		int32 tryGet(char* item, uint32 size)
 		{
-			return _get(false, item, size);
+			return _get(0, item, size);
 		}
 
+		/**
+		 * Get next item waiting at most for the specified time.
+		 * @param ms time to wait for in milliseconds.
+		 * @return SUCCESS or FAILURE if no item came in time.
+		 */
+		int32 timedGet(char* item, uint32 size, uint32 ms)
+		{
+			return _get((int32) ms, item, size);
+		}
+
+		/**
+		 * Put an item in the queue.
+		 * This method blocks while the level of the item is full.
+		 * @param item something to put in the queue.
+		 * @param size size of the item.
+		 * @param priority priority of the item, PRI_OOB or from
+		 * PRI_MAX to getPriorityLevels() - 1.
+		 * @return SUCCESS or FAILURE if the priority is out of range.
+		 */
 		int32 put(char* item, uint32 size, int32 priority);
 		int32 put(char* item, uint32 size)
 		{
 			return put(item, size, 0);
 		}
 
+		/**
+		 * Put an item in the queue.
+		 * @param item something to put in the queue.
+		 * @param size size of the item.
+		 * @param priority priority of the item, PRI_OOB or from
+		 * PRI_MAX to getPriorityLevels() - 1.
+		 * @return SUCCESS or FAILURE if the priority is out of range
+		 * or its level is full.
+		 */
 		int32 tryPut(char* item, uint32 size, int32 priority);
 		int32 tryPut(char* item, uint32 size)
 		{
@@ -93,43 +154,87 @@ namespace uStreamLib {
 
 		int32 getOOBCount(void)
 		{
-			return _oobq.getCount();
+			return getCountPerPriority(PRI_OOB);
+		}
+
+		/**
+		 * Get the count of priority levels (OOB excluded).
+		 */
+		int32 getPriorityLevels(void)
+		{
+			return _priority_levels;
 		}
 
 		int32 getCountPerPriority(int32 priority);
 		int32 setDrawingRate(int32 pri, double rate);
 		double getDrawingRate(int32 pri);
 
+		/**
+		 * Signal a wait set whenever an item is put.
+		 * @param ws the wait set or NULL.
+		 * @param mask the bits to signal.
+		 */
+		void setWaitSet(WaitSet* ws, uint32 mask)
+		{
+			_ws = ws; _wsmask = mask;
+		}
+
 	protected:
-		/* array of shared queues */
-		SharedQueue** _pq;
+		/* a priority level: a ring of slots in _block */
+		struct level {
+			/* first slot */
+			char* slots;
+
+			/* slots count - 1 (slots count is a power of 2) */
+			uint32 mask;
+
+			/* max count of items */
+			uint32 capacity;
+
+			/* count of items put and got */
+			uint32 in;
+			uint32 out;
+
+			/* drawing rate and items drawn in a turn */
+			double rate;
+			uint32 quantum;
+		};
+
+		/* levels: OOB first, then priorities 0 to N - 1 */
+		struct level* _levels;
 
-		/* out of band queue */
-		SharedQueue _oobq;
+		/* memory block of all the slots */
+		char* _block;
+
+		/* size of a slot (size header + item) */
+		uint32 _slot_size;
 
 		/* number of priority levels */
 		int32 _priority_levels;
 
-		/* current queue priority to fetch from */
-		int32 _start;
-
-		/* drawing rates (anti starvation) */
-		double* _drawing_rate;
+		/* bitmap of non-empty priority levels and of non-zero words */
+		uint32* _bitmap;
+		uint32 _summary;
 
-		/* drawing thresholds */
-		int32* _threshold;
+		/* priority level being drained and items it may still give */
+		int32 _cur;
+		uint32 _credit;
 
-		/* fetched elements counters */
-		int32* _items_drawn;
+		/* producers waiting for room */
+		int32 _pwait;
 
-		/* insert semaphore */
+		/* items count (the wait primitive of consumers) */
 		Semaphore _sem_item_count;
 
-		/* fetch semaphore */
-		Semaphore _sem_free_count;
+		/* room for waiting producers */
+		Semaphore _sem_space;
+
+		/* protects levels and bitmaps */
+		Mutex _mutex;
 
-		/* consumer protection mutex */
-		Mutex _cmutex;
+		/* wait set signalled on put (or NULL) and its bits */
+		WaitSet* _ws;
+		uint32 _wsmask;
 
 	private:
 		// copy constructor not available
@@ -137,8 +242,30 @@ namespace uStreamLib {
 		{
 		}
 
-		// method to get data
-		int32 _get(bool blocking, char* data, uint32 size);
+		// method to get data (timeout: -1 forever, 0 no wait, or ms)
+		int32 _get(int32 timeout, char* data, uint32 size);
+
+		// method to put data (wait: block while the level is full)
+		int32 _put(char* item, uint32 size, int32 priority, bool wait);
+
+		// get the level of a priority or NULL if out of range
+		struct level* _level(int32 priority)
+		{
+			if (priority <= PRI_OOB)
+				return _levels;
+			if (priority >= _priority_levels)
+				return NULL;
+			return &_levels[priority + 1];
+		}
+
+		// choose the priority level to get from
+		int32 _draw(void);
+
+		// first non-empty priority level from pri on or -1
+		int32 _next(int32 pri);
+
+		// set or clear the bit of a priority level
+		void _mark(int32 pri, bool full);
 	};
 }
 
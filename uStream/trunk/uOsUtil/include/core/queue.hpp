@@ -95,6 +95,29 @@ namespace uStreamLib {
 		 */
 		virtual int32 getCount(void) = 0;
 
+		/**
+		 * Put some items in the queue without blocking.
+		 * Items are stored one after the other, each one is size
+		 * bytes long. Derived queues may put the whole batch with
+		 * a single synchronization.
+		 * @param items the items to put in the queue.
+		 * @param size size of each item.
+		 * @param n count of items.
+		 * @return the count of items put, from the first one.
+		 */
+		virtual uint32 tryPutMany(char* items, uint32 size, uint32 n);
+
+		/**
+		 * Get some items from the queue without blocking.
+		 * Items are stored one after the other, each one is size
+		 * bytes long.
+		 * @param items pointer to a buffer to store the items into.
+		 * @param size size of each item.
+		 * @param n max count of items to get.
+		 * @return the count of items got.
+		 */
+		virtual uint32 tryGetMany(char* items, uint32 size, uint32 n);
+
 		/**
 		 * Get capacity.
 		 */
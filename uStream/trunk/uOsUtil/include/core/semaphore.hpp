@@ -69,6 +69,26 @@ namespace uStreamLib {
 			return SUCCESS;
 		}
 
+		/**
+		 * Initialize a named semaphore, shared among processes.
+		 * The creator removes the name when the semaphore is
+		 * destroyed; processes which opened it keep using it.
+		 * @param name name of the semaphore.
+		 * @param init_value start value (creator only).
+		 * @param create true to create the semaphore, false to
+		 * open a semaphore created by another process.
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 init(char* name, uint32 init_value, bool create)
+		{
+			int32 ret = _impl->init(name, init_value, create);
+			if (ret == FAILURE)
+				return FAILURE;
+
+			setOk(true);
+			return SUCCESS;
+		}
+
 		/**
 		 * Decrease semaphore.
 		 * This method will block if semaphore's value is lesser
@@ -89,6 +109,18 @@ namespace uStreamLib {
 			return _impl->tryWait();
 		}
 
+		/**
+		 * Decrease semaphore.
+		 * This method blocks at most for the specified time if
+		 * semaphore's value is lesser or equal to 0.
+		 * @param ms time to wait for in milliseconds.
+		 * @return SUCCESS or FAILURE if the time expired.
+		 */
+		int32 timedWait(uint32 ms)
+		{
+			return _impl->timedWait(ms);
+		}
+
 		/**
 		 * Increase semaphore.
 		 */
@@ -0,0 +1,105 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef SHARED_MEMORY_HPP
+#define SHARED_MEMORY_HPP
+
+#include "object.hpp"
+
+/*
+ * Here, we choose the right implementation using
+ * conditional compilation.
+ */
+
+#if defined(_WIN32) || defined(WIN32)
+#include "win32_shared_memory.hpp"
+#else
+#include "linux_shared_memory.hpp"
+#endif
+
+namespace uStreamLib {
+	/**
+	 * This is a named memory region shared among processes.
+	 */
+	class US_API_EXPORT SharedMemory : public Object {
+	public:
+		/**
+		 * Constructor.
+		 */
+		SharedMemory(void);
+
+		/**
+		 * Destructor.
+		 */
+		virtual ~SharedMemory(void);
+
+		/**
+		 * Create or open a named shared memory region.
+		 * The creator removes the name when the region is
+		 * destroyed; processes which opened it keep their mapping.
+		 * @param name name of the region.
+		 * @param size size of the region in bytes (0 when opening
+		 * means the whole region).
+		 * @param create true to create the region, false to open
+		 * a region created by another process.
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 init(char* name, size_t size, bool create)
+		{
+			int32 ret = _impl->init(name, size, create);
+			if (ret == FAILURE)
+				return FAILURE;
+
+			setOk(true);
+			return SUCCESS;
+		}
+
+		/**
+		 * Get the address the region is mapped at.
+		 */
+		void* getAddr(void)
+		{
+			return _impl->getAddr();
+		}
+
+		/**
+		 * Get the size of the mapped region.
+		 */
+		size_t getSize(void)
+		{
+			return _impl->getSize();
+		}
+
+		/**
+		 * Get system specific error string if an error occurred.
+		 */
+		char* getErrorString()
+		{
+			return _impl->getErrorString();
+		}
+
+	private:
+		/* specific implementation */
+		Impl_SharedMemory* _impl;
+	};
+}
+
+#endif
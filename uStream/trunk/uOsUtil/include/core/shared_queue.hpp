@@ -26,6 +26,7 @@
 #include "simple_queue.hpp"
 #include "semaphore.hpp"
 #include "mutex.hpp"
+#include "waitset.hpp"
 
 namespace uStreamLib {
 	/**
@@ -98,6 +99,36 @@ namespace uStreamLib {
 		 * @return current items count.
 		 */
 		int32 getCount(void);
+
+		/**
+		 * Put some items in the queue without blocking.
+		 * The batch is put with a single lock of the producers' mutex.
+		 * @param items the items to put in the queue.
+		 * @param size size of each item.
+		 * @param n count of items.
+		 * @return the count of items put, from the first one.
+		 */
+		uint32 tryPutMany(char* items, uint32 size, uint32 n);
+
+		/**
+		 * Get some items from the queue without blocking.
+		 * The batch is got with a single lock of the consumers' mutex.
+		 * @param items pointer to a buffer to store the items into.
+		 * @param size size of each item.
+		 * @param n max count of items to get.
+		 * @return the count of items got.
+		 */
+		uint32 tryGetMany(char* items, uint32 size, uint32 n);
+
+		/**
+		 * Signal a wait set whenever an item is put.
+		 * @param ws the wait set or NULL.
+		 * @param mask the bits to signal.
+		 */
+		void setWaitSet(WaitSet* ws, uint32 mask)
+		{
+			_ws = ws; _wsmask = mask;
+		}
 	
 	private:
 		// no copy constructors
@@ -116,6 +147,10 @@ namespace uStreamLib {
 
 		// multiple consumer mutex
 		Mutex _cmutex;
+
+		// wait set signalled on put (or NULL) and its bits
+		WaitSet* _ws;
+		uint32 _wsmask;
 	};
 }
 
@@ -0,0 +1,257 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef SHM_CHANNEL_HPP
+#define SHM_CHANNEL_HPP
+
+#include "shared_memory.hpp"
+#include "semaphore.hpp"
+#include "bufferpool.hpp"
+#include "mutex.hpp"
+
+namespace uStreamLib {
+	/*
+	 * Layout of the shared region header.
+	 */
+	struct ShmHeader;
+
+	/**
+	 * This is a one way channel moving buffers between two processes
+	 * without copies. Buffers, a descriptor ring and a free ring live
+	 * in one named shared memory region: the producer fills a buffer
+	 * in place and commits its id with some metadata, the consumer
+	 * receives the id and reads the same memory, then releases it
+	 * back to the producer. Rings are lock-free (one producer, one
+	 * consumer) and a side sleeps on a named semaphore only when its
+	 * ring is empty, so the fast path makes no system calls.
+	 * Each process sees the buffers as a view BufferPool, so
+	 * freeing a received buffer releases it.
+	 */
+	class US_API_EXPORT ShmChannel : public Object {
+	public:
+		/**
+		 * Constructor.
+		 */
+		ShmChannel(void);
+
+		/**
+		 * Destructor.
+		 */
+		virtual ~ShmChannel(void);
+
+		/**
+		 * Create or open a channel.
+		 * @param name name of the channel (the region and the
+		 * semaphores are named after it).
+		 * @param bsize buffer size (creator only).
+		 * @param bcount buffers count (creator only).
+		 * @param meta_size size of the metadata committed with each
+		 * buffer (creator only).
+		 * @param create true to create the channel, false to open
+		 * a channel created by another process.
+		 * @return SUCCESS or FAILURE (eg. the channel to open has
+		 * not been created yet).
+		 */
+		int32 init(char* name, uint32 bsize, uint32 bcount,
+			uint32 meta_size, bool create);
+
+		/**
+		 * Get a free buffer to fill (producer).
+		 * @param wait true to wait for a free buffer.
+		 * @return the buffer, holding the first reference, or NULL if
+		 * there are no free buffers and wait is false or
+		 * wakeProducer() has been called.
+		 */
+		DataBuf* acquire(bool wait = true);
+
+		/**
+		 * Send a buffer got with acquire() to the consumer
+		 * (producer). This method never blocks: the descriptor
+		 * ring holds all the buffers.
+		 * @param buf the buffer; its count is the size of data.
+		 * @param meta metadata to send with the buffer (meta_size
+		 * bytes) or NULL.
+		 * @return SUCCESS or FAILURE if the buffer has been stretched
+		 * beyond the buffer size: then the buffer is aborted.
+		 */
+		int32 commit(DataBuf* buf, char* meta = NULL);
+
+		/**
+		 * Give back a buffer got with acquire() without sending it
+		 * (producer).
+		 * @param buf the buffer.
+		 */
+		void abort(DataBuf* buf);
+
+		/**
+		 * Receive next buffer (consumer).
+		 * @param meta pointer to store metadata into (meta_size bytes)
+		 * or NULL.
+		 * @param wait true to wait for a buffer.
+		 * @return the buffer, holding the first reference, or NULL if
+		 * there are no buffers and wait is false or wakeConsumer()
+		 * has been called. Free it with its pool's freeBuffer() or
+		 * with release().
+		 */
+		DataBuf* receive(char* meta = NULL, bool wait = true);
+
+		/**
+		 * Give a received buffer back to the producer (consumer).
+		 * This method is thread safe.
+		 * @param bid the buffer id.
+		 */
+		void release(uint32 bid);
+
+		/**
+		 * Make a consumer blocked in receive() return NULL.
+		 * If no consumer is blocked, the next blocking receive()
+		 * on an empty channel returns NULL.
+		 */
+		void wakeConsumer(void);
+
+		/**
+		 * Make a producer blocked in acquire() return NULL.
+		 */
+		void wakeProducer(void);
+
+		/**
+		 * Get the view of the buffers of this channel.
+		 */
+		BufferPool* getBufferPool(void)
+		{
+			return &_view;
+		}
+
+		/**
+		 * Get the size of each buffer.
+		 */
+		uint32 getBufferSize(void)
+		{
+			return _bsize;
+		}
+
+		/**
+		 * Get the count of buffers.
+		 */
+		uint32 getBuffersCount(void)
+		{
+			return _bcount;
+		}
+
+		/**
+		 * Get the size of the metadata sent with each buffer.
+		 */
+		uint32 getMetaSize(void)
+		{
+			return _meta_size;
+		}
+
+		/**
+		 * Get system specific error string if an error occurred.
+		 */
+		char* getErrorString(void)
+		{
+			return _shm.getErrorString();
+		}
+	private:
+		/* no copy constructor */
+		ShmChannel(ShmChannel&)
+			: Object(UOSUTIL_RTTI_SHM_CHANNEL)
+		{
+		}
+
+		/* releases buffers freed through the view */
+		class ReleaseCallBack : public CallBack {
+		public:
+			ReleaseCallBack(void)
+				: _channel(NULL)
+			{
+			}
+
+			void setChannel(ShmChannel* channel)
+			{
+				_channel = channel;
+			}
+
+			virtual int32 perform(void* custom_data)
+			{
+				_channel->release(*((uint32 *) custom_data));
+				return SUCCESS;
+			}
+		private:
+			ShmChannel* _channel;
+		};
+
+		/* get a slot of the descriptor ring */
+		char* _entry(uint32 index)
+		{
+			return _dring + (index % _bcount) * _entry_size;
+		}
+
+		/* pop a bid from the free ring */
+		bool _popFree(uint32* bid);
+
+		/* pop a descriptor from the descriptor ring */
+		bool _popEntry(uint32* bid, uint32* count, char* meta);
+
+		/* the shared region */
+		SharedMemory _shm;
+
+		/* header of the shared region */
+		ShmHeader* _hdr;
+
+		/* rings and buffers in the shared region */
+		char* _dring;
+		uint32* _fring;
+		char* _bufs;
+
+		/* sizes read from the header */
+		uint32 _bsize;
+		uint32 _bcount;
+		uint32 _meta_size;
+		uint32 _entry_size;
+
+		/* buffers aborted by the producer, acquired first */
+		uint32* _spares;
+		uint32 _nspares;
+
+		/* flags: wake up requests */
+		volatile int32 _cwakeup;
+		volatile int32 _pwakeup;
+
+		/* semaphore to sleep on when there are no buffers to receive */
+		Semaphore _semData;
+
+		/* semaphore to sleep on when there are no free buffers */
+		Semaphore _semFree;
+
+		/* serializes releases from different threads */
+		Mutex _mutexRelease;
+
+		/* view of the buffers */
+		BufferPool _view;
+
+		/* callback of the view */
+		ReleaseCallBack _cb;
+	};
+}
+
+#endif
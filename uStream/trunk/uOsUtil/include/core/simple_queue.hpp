@@ -24,11 +24,14 @@
 #define SIMPLEQUEUE_HPP
 
 #include "queue.hpp"
+#include "atomic.hpp"
 
 namespace uStreamLib {
 	/**
 	 * This class is a non shared, single threaded queue.
-	 * Only one thread can use this queue.
+	 * Only one thread can use this queue. Items are copied into a
+	 * single ring of fixed size slots, so a queue makes one
+	 * allocation and consecutive items are contiguous in memory.
 	 */
 	class US_API_EXPORT SimpleQueue : public Queue {
 	public:
@@ -103,24 +106,33 @@ namespace uStreamLib {
 		 */
 		int32 getCount(void)
 		{
-			return _items_count;
+			return (int32) (_in - _out);
 		}
 		
 	protected:
-		/* linked list of queue slots */
-		struct queue_item* _item;
+		/* ring of slots, each storing item size and item */
+		char* _ring;
 
-		/* ptr to insert point */
-		struct queue_item* _in;
+		/* memory block holding the ring */
+		char* _block;
 
-		/* ptr to get point */
-		struct queue_item* _out;
+		/* slots count - 1 (slots count is a power of 2) */
+		uint32 _mask;
 
-		/* number of elements in queue */
-		int32 _items_count;
+		/* size of a slot */
+		uint32 _slot_size;
 
-		/* number of free elements */
-		int32 _free_count;
+		/* count of items put, ie next slot to write */
+		uint32 _in;
+
+		/* count of items got, ie next slot to read */
+		uint32 _out;
+
+		/* get the slot for the specified index */
+		char* _slot(uint32 index)
+		{
+			return _ring + (index & _mask) * _slot_size;
+		}
 	private:
 		/* copy disabled */
 		SimpleQueue(SimpleQueue&)
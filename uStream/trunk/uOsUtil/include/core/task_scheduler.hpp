@@ -0,0 +1,302 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef TASK_SCHEDULER_HPP
+#define TASK_SCHEDULER_HPP
+
+#include "thread.hpp"
+#include "mutex.hpp"
+#include "callback.hpp"
+#include "atomic.hpp"
+
+namespace uStreamLib {
+	/* declares the scheduler */
+	class TaskScheduler;
+
+	/* declares the worker threads (see implementation) */
+	class TaskWorker;
+
+	/**
+	 * A piece of work run by a TaskScheduler. A task runs on one
+	 * worker at a time; execute() must do a bounded amount of work
+	 * without sleeping and tell what to do next. A task parked with
+	 * TASK_IDLE runs again when schedule() is called, eg. by a
+	 * WaitSet the task is the callback of: calls made while the
+	 * task runs make it run once more afterwards, so no event is
+	 * lost. Performing a task as a CallBack schedules it.
+	 */
+	class US_API_EXPORT Task : public CallBack {
+	public:
+		/**
+		 * Values returned by execute().
+		 */
+		enum TaskResult { /** run again as soon as possible */
+		TASK_READY = 0, /** park until schedule() is called */
+		TASK_IDLE = 1, /** the task is over */
+		TASK_DONE = 2 };
+
+		/**
+		 * Constructor.
+		 */
+		Task(void);
+
+		/**
+		 * Destructor.
+		 */
+		virtual ~Task(void);
+
+		/**
+		 * Do some work. Called by a worker thread.
+		 * @return one of TASK_READY, TASK_IDLE or TASK_DONE.
+		 */
+		virtual int32 execute(void) = 0;
+
+		/**
+		 * Called by the worker after execute() returned TASK_DONE.
+		 * The scheduler does not touch the task afterwards, so it
+		 * may be deleted from here on.
+		 */
+		virtual void done(void)
+		{
+		}
+
+		/**
+		 * Make this task run. Any thread can call this method.
+		 */
+		void schedule(void);
+
+		/**
+		 * Schedule this task.
+		 */
+		virtual int32 perform(void*)
+		{
+			schedule(); return SUCCESS;
+		}
+
+		/**
+		 * Get the scheduler this task has been added to.
+		 * @return the scheduler or NULL.
+		 */
+		TaskScheduler* getScheduler(void)
+		{
+			return _sched;
+		}
+	private:
+		friend class TaskScheduler;
+
+		/* copy constructor not available */
+		Task(Task&)
+			: CallBack()
+		{
+		}
+
+		/* task states */
+		enum { _IDLE = 0, _QUEUED = 1, _RUNNING = 2, _NOTIFIED = 3,
+		_DONE = 4 };
+
+		/* the scheduler */
+		TaskScheduler* _sched;
+
+		/* current state */
+		volatile int32 _state;
+
+		/* next task in the scheduler's queue */
+		Task* _next;
+
+		/* next task in the scheduler's timers list */
+		Task* _tnext;
+
+		/* monotonic time (us) to run at */
+		uint64 _when;
+
+		/* flag: the task is in the timers list */
+		bool _timed;
+	};
+
+	/**
+	 * The body of a loop run by TaskScheduler::parallelFor().
+	 */
+	class US_API_EXPORT LoopBody {
+	public:
+		/**
+		 * Destructor.
+		 */
+		virtual ~LoopBody(void)
+		{
+		}
+
+		/**
+		 * Process a slice of the range, eg. some rows of a frame.
+		 * Called by several threads at once on disjoint slices.
+		 * @param begin first index of the slice.
+		 * @param end index after the last one of the slice.
+		 */
+		virtual void run(uint32 begin, uint32 end) = 0;
+	};
+
+	/**
+	 * A pool of worker threads running tasks. Each worker keeps
+	 * the tasks it makes runnable in a deque of its own and runs
+	 * them most recent first; idle workers steal the oldest tasks
+	 * of the others. Tasks made runnable by other threads, and
+	 * tasks which yield with TASK_READY, go through a shared queue
+	 * so that busy tasks do not starve the others. Workers with
+	 * nothing to do sleep until a task becomes runnable.
+	 */
+	class US_API_EXPORT TaskScheduler : public Object {
+	public:
+		/**
+		 * Constructor.
+		 */
+		TaskScheduler(void);
+
+		/**
+		 * Destructor. Stops the workers: tasks still queued
+		 * are not run.
+		 */
+		virtual ~TaskScheduler(void);
+
+		/**
+		 * Create the workers.
+		 * @param name the name of the worker threads.
+		 * @param workers number of workers or 0 for one per processor.
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 init(char* name, uint32 workers = 0);
+
+		/**
+		 * Add a task. The task is parked until scheduled.
+		 * @param t the task.
+		 * @return SUCCESS or FAILURE if the task belongs to a scheduler.
+		 */
+		int32 add(Task* t);
+
+		/**
+		 * Schedule a task at a later time. A task has one such
+		 * time at most: a new one replaces the old one. The task
+		 * may run earlier if scheduled in the meantime.
+		 * @param t the task.
+		 * @param when monotonic time in microseconds (see
+		 * Timer::getMonotonicTime()).
+		 */
+		void scheduleAt(Task* t, uint64 when);
+
+		/**
+		 * Run a loop body over a range, in slices of grain indexes,
+		 * on the calling thread and on idle workers. The calling
+		 * thread takes slices too, so the loop goes on even when
+		 * every worker is busy, and no thread is created: callers
+		 * sharing a scheduler never run more threads than its
+		 * workers and themselves. The method returns when all the
+		 * slices are done.
+		 * @param begin first index.
+		 * @param end index after the last one.
+		 * @param grain indexes per slice (0 means one slice per
+		 * thread).
+		 * @param body the loop body.
+		 * @param threads max threads to use, the caller included
+		 * (0 means the workers and the caller, who may be a worker).
+		 * @return SUCCESS or FAILURE if the range is invalid.
+		 */
+		int32 parallelFor(uint32 begin, uint32 end, uint32 grain,
+			LoopBody* body, uint32 threads = 0);
+
+		/**
+		 * Get the number of workers.
+		 * @return the number of workers.
+		 */
+		uint32 getWorkersCount(void)
+		{
+			return _count;
+		}
+	private:
+		friend class Task;
+		friend class TaskWorker;
+
+		/* copy constructor not available */
+		TaskScheduler(TaskScheduler&)
+			: Object(UOSUTIL_RTTI_MACHINE_TASK_SCHEDULER)
+		{
+		}
+
+		/* how often workers look at the shared queue first */
+		enum { _SHARED_PERIOD = 31 };
+
+		/* times an idle worker looks for tasks before sleeping */
+		enum { _SPINS = 64 };
+
+		/* the workers */
+		TaskWorker** _workers;
+
+		/* number of workers */
+		uint32 _count;
+
+		/* shared queue of runnable tasks */
+		Task* _head;
+		Task* _tail;
+		volatile int32 _queued;
+		Mutex _mutexQueue;
+
+		/* timers list, sorted by time */
+		Task* _timers;
+		volatile uint64 _nextTimer;
+		Mutex _mutexTimers;
+
+		/* sleeping workers nobody woke up yet */
+		volatile int32 _idle;
+		Semaphore _semIdle;
+
+		/* flag: workers must quit */
+		volatile int32 _stop;
+
+		/* make a task runnable (yield: it ran already) */
+		void _push(Task* t, bool yield);
+
+		/* the worker of the calling thread or NULL */
+		TaskWorker* _current(void);
+
+		/* shared queue */
+		void _enqueue(Task* t);
+		Task* _dequeue(void);
+
+		/* find something to run */
+		Task* _take(TaskWorker* w, uint32 tick);
+
+		/* run a task and decide what comes next */
+		void _execute(Task* t);
+
+		/* check if anything can run */
+		bool _hasWork(void);
+
+		/* timers */
+		void _fireTimers(void);
+		void _cancelTimer(Task* t);
+
+		/* idle workers */
+		void _sleep(void);
+		void _wake(void);
+
+		/* worker main loop */
+		void _work(TaskWorker* w);
+	};
+}
+
+#endif
@@ -37,6 +37,11 @@ namespace uStreamLib {
 	 */
 	class US_API_EXPORT Thread : public Object {
 	public:
+		/**
+		 * Scheduling policies (see setScheduling()).
+		 */
+		enum { POLICY_DEFAULT = 0, POLICY_FIFO = 1, POLICY_RR = 2 };
+
 		/**
 		 * Constructor.
 		 */
@@ -50,8 +55,11 @@ namespace uStreamLib {
 		/**
 		 * Create a thread with specified name.
 		 * @param name thread's name.
+		 * @param spawn false to set up the object only, without
+		 * creating a system thread: someone else (eg. a TaskScheduler)
+		 * runs the code and calls doTerminate() when done.
 		 */
-		int32 init(char* name);
+		int32 init(char* name, bool spawn = true);
 
 		/**
 		 * Wait for some time.
@@ -59,6 +67,85 @@ namespace uStreamLib {
 		 */
 		static void sleep(int32 ms);
 
+		/**
+		 * Wait until the monotonic clock reaches some time. Unlike
+		 * a relative sleep, deadlines computed by adding periods do
+		 * not drift with the time spent between the waits.
+		 * @param us time to wait for, as got from
+		 * Timer::getMonotonicTime() (microseconds).
+		 */
+		static void sleepUntil(uint64 us);
+
+		/**
+		 * Get a small number identifying the calling thread.
+		 * Numbers are given out on first call, starting from 1,
+		 * and work for threads not created by this class too.
+		 * @return the slot of the calling thread.
+		 */
+		static uint32 getCurrentSlot(void);
+
+		/**
+		 * Get the number of processors available.
+		 * @return the number of processors (at least 1).
+		 */
+		static uint32 getProcessorsCount(void);
+
+		/**
+		 * Set the size of the stack of the system thread. Call this
+		 * method before init().
+		 * @param size stack size in bytes (0 means system default).
+		 */
+		void setStackSize(uint32 size)
+		{
+			_stackSize = size;
+		}
+
+		/**
+		 * Get the size of the stack set by setStackSize().
+		 * @return stack size in bytes (0 means system default).
+		 */
+		uint32 getStackSize(void)
+		{
+			return _stackSize;
+		}
+
+		/**
+		 * Set the processors this thread may run on.
+		 * Like the other thread settings, it is applied by the
+		 * thread itself when it starts, or at once if it is
+		 * already running.
+		 * @param cpus a bit for each processor, from processor 0
+		 * (0 means any processor).
+		 * @return SUCCESS or FAILURE if the setting cannot be applied.
+		 */
+		int32 setAffinity(uint64 cpus);
+
+		/**
+		 * Get the processors set by setAffinity().
+		 * @return a bit for each processor (0 means any processor).
+		 */
+		uint64 getAffinity(void)
+		{
+			return _cpus;
+		}
+
+		/**
+		 * Set the scheduling policy of this thread. Real time
+		 * policies need privileges (eg. CAP_SYS_NICE or RLIMIT_RTPRIO).
+		 * @param policy one of POLICY_DEFAULT, POLICY_FIFO or POLICY_RR.
+		 * @param priority real time priority (1 to 99 on Linux),
+		 * ignored by POLICY_DEFAULT.
+		 * @return SUCCESS or FAILURE if the setting cannot be applied.
+		 */
+		int32 setScheduling(int32 policy, int32 priority);
+
+		/**
+		 * Set the niceness of this thread (POLICY_DEFAULT only).
+		 * @param nice from -20 (favourable) to 19.
+		 * @return SUCCESS or FAILURE if the setting cannot be applied.
+		 */
+		int32 setNice(int32 nice);
+
 		/**
 		 * Get thread's name.
 		 */
@@ -140,6 +227,18 @@ namespace uStreamLib {
 		 * Reserved public method.
 		 */
 		void threadProc(void);
+
+	protected:
+		/**
+		 * Called by the thread right after start(), once its
+		 * settings are applied and before run() is invoked: override
+		 * this method to change settings (eg. setAffinity()) from the
+		 * thread itself.
+		 */
+		virtual void prepare(void)
+		{
+			// nothing to do
+		}
 		
 	private:
 		/* copy constructor not available */
@@ -166,6 +265,23 @@ namespace uStreamLib {
 		// flag: this thread is a dummy SELF thread
 		bool _bIsSelf;
 
+		// flag: a system thread has been created
+		bool _bSpawned;
+
+		// flag: the thread applied its settings
+		bool _bRunning;
+
+		// thread settings
+		uint32 _stackSize;
+		uint64 _cpus;
+		int32 _policy;
+		int32 _priority;
+		int32 _nice;
+		bool _bNice;
+
+		// apply the settings to the running thread
+		int32 _applySettings(void);
+
 		// current thread used by getCurrent()
 		static Thread* _current;
 	};
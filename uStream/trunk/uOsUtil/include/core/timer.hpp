@@ -93,6 +93,16 @@ namespace uStreamLib {
 		{
 			return _impl->getElapsed();
 		}
+
+		/**
+		 * Get the time of a clock which is never set back.
+		 * Use it to measure intervals and compute deadlines.
+		 * @return time in microseconds from an arbitrary origin.
+		 */
+		static uint64 getMonotonicTime(void)
+		{
+			return Impl_Timer::getMonotonicTime();
+		}
 		
 	private:
 		/* pointer to specific implementation */
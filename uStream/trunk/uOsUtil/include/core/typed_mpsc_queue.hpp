@@ -0,0 +1,429 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef TYPEDMPSCQUEUE_HPP
+#define TYPEDMPSCQUEUE_HPP
+
+#include <stdlib.h>
+
+#include "databuf.hpp"
+#include "semaphore.hpp"
+#include "atomic.hpp"
+#include "waitset.hpp"
+
+namespace uStreamLib {
+	/**
+	 * This is a lock-free multi producer - single consumer queue of
+	 * items of type T. Each ring slot holds just a sequence number,
+	 * telling whether it is free or full, and a T, with no size
+	 * header: items are moved by assignment, so the compiler knows
+	 * their size and alignment and no generic copy is made. T must
+	 * be a plain structure (eg. a message): slots are never
+	 * constructed nor destroyed. Producers only race on the index
+	 * they reserve slots with and never take a lock. Only one thread
+	 * may get at the same time. The capacity is rounded up to a
+	 * power of 2.
+	 * A blocked consumer sleeps on a semaphore which is posted only
+	 * when it announced it was going to sleep, and blocked producers
+	 * likewise, so the fast path makes no system calls.
+	 */
+	template <class T>
+	class TypedMPSCQueue : public Object {
+	public:
+		/**
+		 * Constructor.
+		 */
+		TypedMPSCQueue(void)
+			: Object(UOSUTIL_RTTI_TYPED_MPSC_QUEUE), _tail(0), _head(0),
+			_pwait(0), _cwait(0), _ring(NULL), _block(NULL), _mask(0),
+			_ws(NULL), _wsmask(0)
+		{
+		}
+
+		/**
+		 * Destructor.
+		 */
+		virtual ~TypedMPSCQueue(void)
+		{
+			if (_block)
+				free(_block);
+		}
+
+		/**
+		 * Create a multi producer - single consumer queue.
+		 * @param name queue's name.
+		 * @param capacity capacity (rounded up to a power of 2).
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 init(char* name, int32 capacity);
+
+		/**
+		 * Put an item in the queue. Any thread can call this method.
+		 * This method blocks while the queue is full.
+		 * @param item the item to put in the queue.
+		 * @return SUCCESS.
+		 */
+		int32 put(T* item);
+
+		/**
+		 * Put an item in the queue. Any thread can call this method.
+		 * @param item the item to put in the queue.
+		 * @return SUCCESS or FAILURE if the queue is full.
+		 */
+		int32 tryPut(T* item);
+
+		/**
+		 * Get next item from the queue.
+		 * This method blocks while the queue is empty.
+		 * @param item pointer to store the item into.
+		 * @return SUCCESS.
+		 */
+		int32 get(T* item);
+
+		/**
+		 * Get next item from the queue.
+		 * @param item pointer to store the item into.
+		 * @return SUCCESS or FAILURE if the queue is empty.
+		 */
+		int32 tryGet(T* item)
+		{
+			if (!_take(item))
+				return FAILURE;
+
+			_wakeProducers();
+			return SUCCESS;
+		}
+
+		/**
+		 * Get next item waiting at most for the specified time.
+		 * @param item pointer to store the item into.
+		 * @param ms time to wait for in milliseconds.
+		 * @return SUCCESS or FAILURE if no item came in time.
+		 */
+		int32 timedGet(T* item, uint32 ms);
+
+		/**
+		 * Get some items from the queue without blocking.
+		 * The slots are given back to producers with a single
+		 * wakeup.
+		 * @param items array to store the items into.
+		 * @param n max count of items to get.
+		 * @return the count of items got.
+		 */
+		uint32 tryGetMany(T* items, uint32 n)
+		{
+			uint32 i = 0;
+
+			while (i < n && _take(&items[i]))
+				i++;
+
+			if (i)
+				_wakeProducers();
+
+			return i;
+		}
+
+		/**
+		 * Get current items count. Items being put by other
+		 * threads may be counted already.
+		 * @return current items count.
+		 */
+		int32 getCount(void)
+		{
+			return (int32) ((uint32) Atomic::load(&_tail) - _head);
+		}
+
+		/**
+		 * Get capacity.
+		 */
+		int32 getCapacity(void)
+		{
+			return (int32) (_mask + 1);
+		}
+
+		/**
+		 * Get queue's name.
+		 */
+		char* getName(void)
+		{
+			return _name.toString();
+		}
+
+		/**
+		 * Signal a wait set whenever an item is put.
+		 * @param ws the wait set or NULL.
+		 * @param mask the bits to signal.
+		 */
+		void setWaitSet(WaitSet* ws, uint32 mask)
+		{
+			_ws = ws; _wsmask = mask;
+		}
+	private:
+		/* no copy constructor */
+		TypedMPSCQueue(TypedMPSCQueue&)
+			: Object(UOSUTIL_RTTI_TYPED_MPSC_QUEUE)
+		{
+		}
+
+		/* a ring slot */
+		struct slot {
+			/* sequence number: tells if the slot is free or full */
+			volatile int32 seq;
+
+			/* the item */
+			T item;
+		};
+
+		/* padding size */
+		enum { _PAD = US_CACHE_LINE_SIZE };
+
+		/* copy an item out of the next slot, if full */
+		bool _take(T* item)
+		{
+			struct slot* s = &_ring[_head & _mask];
+
+			// the producer of this slot may not have published it yet
+			if (Atomic::load(&s->seq) != (int32) (_head + 1))
+				return false;
+
+			*item = s->item;
+
+			// free the slot for the producers of the next lap
+			Atomic::store(&s->seq, (int32) (_head + _mask + 1));
+			_head++;
+
+			return true;
+		}
+
+		/* give freed slots back to sleeping producers */
+		void _wakeProducers(void)
+		{
+			int32 n = 0;
+
+			// one post for each producer going to sleep
+			Atomic::barrier();
+			n = Atomic::load(&_pwait) - (int32) _semSpace.getValue();
+			while (n-- > 0)
+				_semSpace.post();
+		}
+
+		char _pad0[_PAD];
+
+		/* --- producers' cache line --- */
+
+		/* next index to reserve */
+		volatile int32 _tail;
+
+		char _pad1[_PAD];
+
+		/* --- consumer's cache line --- */
+
+		/* next index to read */
+		uint32 _head;
+
+		char _pad2[_PAD];
+
+		/* --- shared flags --- */
+
+		/* count of producers sleeping on _semSpace */
+		volatile int32 _pwait;
+
+		/* flag: the consumer sleeps on _semItems */
+		volatile int32 _cwait;
+
+		char _pad3[_PAD];
+
+		/* --- read only after init --- */
+
+		/* ring of slots (aligned) and allocated block */
+		struct slot* _ring;
+		char* _block;
+
+		/* ring slots minus one (slots are a power of 2) */
+		uint32 _mask;
+
+		/* queue's name */
+		DataBuf _name;
+
+		/* semaphores to sleep on */
+		Semaphore _semItems;
+		Semaphore _semSpace;
+
+		/* wait set signalled on put (or NULL) and its bits */
+		WaitSet* _ws;
+		uint32 _wsmask;
+	};
+
+	template <class T>
+	int32 TypedMPSCQueue<T>::init(char* name, int32 capacity)
+	{
+		uint32 slots = 1, i = 0;
+		int32 ret = 0;
+
+		// do some checks
+		if (capacity <= 0)
+			capacity = 1;
+
+		ret = _name.init(name);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		// round slots count to the next power of 2
+		while (slots < (uint32) capacity)
+			slots <<= 1;
+
+		_mask = slots - 1;
+
+		// allocate the ring on a cache line boundary
+		_block = (char *) malloc(slots * sizeof(struct slot) +
+			US_CACHE_LINE_SIZE);
+		if (!_block)
+			return FAILURE;
+
+		_ring = (struct slot *) (((size_t) _block + US_CACHE_LINE_SIZE - 1) &
+			~((size_t) US_CACHE_LINE_SIZE - 1));
+
+		// slot i is free for the producer reserving index i
+		for (i = 0; i < slots; i++)
+			_ring[i].seq = (int32) i;
+
+		// initialize semaphores
+		ret = _semItems.init(0);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		ret = _semSpace.init(0);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		// ok
+		setOk(true);
+		return SUCCESS;
+	}
+
+	template <class T>
+	int32 TypedMPSCQueue<T>::tryPut(T* item)
+	{
+		uint32 pos = (uint32) Atomic::load(&_tail);
+		struct slot* s = NULL;
+		int32 dif = 0;
+
+		// reserve a slot
+		for (;;) {
+			s = &_ring[pos & _mask];
+			dif = Atomic::load(&s->seq) - (int32) pos;
+
+			if (!dif) {
+				if (Atomic::compareAndSwap(&_tail, (int32) pos,
+					(int32) (pos + 1)))
+					break;
+			} else if (dif < 0) {
+				// the slot still holds an item a lap behind: full
+				return FAILURE;
+			}
+
+			pos = (uint32) Atomic::load(&_tail);
+		}
+
+		// copy and publish item
+		s->item = *item;
+		Atomic::store(&s->seq, (int32) (pos + 1));
+
+		// wake up the consumer if it is sleeping
+		Atomic::barrier();
+		if (Atomic::load(&_cwait) && Atomic::compareAndSwap(&_cwait, 1, 0))
+			_semItems.post();
+
+		if (_ws)
+			_ws->signal(_wsmask);
+
+		// ok
+		return SUCCESS;
+	}
+
+	template <class T>
+	int32 TypedMPSCQueue<T>::put(T* item)
+	{
+		for (;;) {
+			if (tryPut(item) == SUCCESS)
+				return SUCCESS;
+
+			// announce we are going to sleep, then check again
+			Atomic::increment(&_pwait);
+			Atomic::barrier();
+
+			if (tryPut(item) == SUCCESS) {
+				Atomic::decrement(&_pwait);
+				return SUCCESS;
+			}
+
+			_semSpace.wait();
+			Atomic::decrement(&_pwait);
+		}
+	}
+
+	template <class T>
+	int32 TypedMPSCQueue<T>::get(T* item)
+	{
+		for (;;) {
+			if (tryGet(item) == SUCCESS)
+				return SUCCESS;
+
+			// announce we are going to sleep, then check again
+			Atomic::store(&_cwait, 1);
+			Atomic::barrier();
+
+			if (tryGet(item) == SUCCESS) {
+				Atomic::compareAndSwap(&_cwait, 1, 0);
+				return SUCCESS;
+			}
+
+			_semItems.wait();
+		}
+	}
+
+	template <class T>
+	int32 TypedMPSCQueue<T>::timedGet(T* item, uint32 ms)
+	{
+		if (tryGet(item) == SUCCESS)
+			return SUCCESS;
+
+		// announce we are going to sleep, then check again
+		Atomic::store(&_cwait, 1);
+		Atomic::barrier();
+
+		if (tryGet(item) == SUCCESS) {
+			Atomic::compareAndSwap(&_cwait, 1, 0);
+			return SUCCESS;
+		}
+
+		if (_semItems.timedWait(ms) == FAILURE &&
+			!Atomic::compareAndSwap(&_cwait, 1, 0)) {
+			// a producer posted right after the timeout: take the post
+			_semItems.wait();
+		}
+
+		return tryGet(item);
+	}
+}
+
+#endif
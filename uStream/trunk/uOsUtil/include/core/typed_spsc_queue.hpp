@@ -0,0 +1,417 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef TYPEDSPSCQUEUE_HPP
+#define TYPEDSPSCQUEUE_HPP
+
+#include <stdlib.h>
+
+#include "databuf.hpp"
+#include "semaphore.hpp"
+#include "atomic.hpp"
+#include "waitset.hpp"
+
+namespace uStreamLib {
+	/**
+	 * This is a lock-free single producer - single consumer queue of
+	 * items of type T. Items are copied into a ring of slots which
+	 * are exactly sizeof(T) bytes and carry no size header: items
+	 * are moved by assignment, so the compiler knows their size and
+	 * alignment and no generic copy is made. T must be a plain
+	 * structure (eg. a message): slots are never constructed nor
+	 * destroyed. Producer and consumer indexes live on different
+	 * cache lines, so the two threads never write the same line.
+	 * Only one thread may put and only one thread may get at the
+	 * same time.
+	 * A blocked producer or consumer sleeps on a semaphore which is
+	 * posted only when the ring was full or empty, so the fast path
+	 * makes no system calls.
+	 */
+	template <class T>
+	class TypedSPSCQueue : public Object {
+	public:
+		/**
+		 * Constructor.
+		 */
+		TypedSPSCQueue(void)
+			: Object(UOSUTIL_RTTI_TYPED_SPSC_QUEUE), _tail(0), _head_cache(0),
+			_head(0), _tail_cache(0), _pwait(0), _cwait(0), _cwakeup(0),
+			_ring(NULL), _block(NULL), _mask(0), _capacity(0), _ws(NULL),
+			_wsmask(0)
+		{
+		}
+
+		/**
+		 * Destructor.
+		 */
+		virtual ~TypedSPSCQueue(void)
+		{
+			if (_block)
+				free(_block);
+		}
+
+		/**
+		 * Create a single producer - single consumer queue.
+		 * @param name queue's name.
+		 * @param capacity capacity.
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 init(char* name, int32 capacity);
+
+		/**
+		 * Put an item in the queue.
+		 * This method blocks while the queue is full.
+		 * @param item the item to put in the queue.
+		 * @return SUCCESS.
+		 */
+		int32 put(T* item);
+
+		/**
+		 * Put an item in the queue.
+		 * @param item the item to put in the queue.
+		 * @return SUCCESS or FAILURE if the queue is full.
+		 */
+		int32 tryPut(T* item)
+		{
+			return tryPutMany(item, 1) ? SUCCESS : FAILURE;
+		}
+
+		/**
+		 * Get next item from the queue.
+		 * This method blocks while the queue is empty.
+		 * @param item pointer to store the item into.
+		 * @return SUCCESS or FAILURE if the consumer has been woken
+		 * up by wakeConsumer().
+		 */
+		int32 get(T* item);
+
+		/**
+		 * Get next item from the queue.
+		 * @param item pointer to store the item into.
+		 * @return SUCCESS or FAILURE if the queue is empty.
+		 */
+		int32 tryGet(T* item)
+		{
+			return tryGetMany(item, 1) ? SUCCESS : FAILURE;
+		}
+
+		/**
+		 * Put some items in the queue without blocking.
+		 * The batch is put with a single index update and wakeup.
+		 * @param items the items to put in the queue.
+		 * @param n count of items.
+		 * @return the count of items put, from the first one.
+		 */
+		uint32 tryPutMany(T* items, uint32 n);
+
+		/**
+		 * Get some items from the queue without blocking.
+		 * The batch is got with a single index update and wakeup.
+		 * @param items array to store the items into.
+		 * @param n max count of items to get.
+		 * @return the count of items got.
+		 */
+		uint32 tryGetMany(T* items, uint32 n);
+
+		/**
+		 * Get current items count.
+		 * @return current items count.
+		 */
+		int32 getCount(void)
+		{
+			return (int32) ((uint32) Atomic::load(&_tail) -
+				(uint32) Atomic::load(&_head));
+		}
+
+		/**
+		 * Get capacity.
+		 */
+		int32 getCapacity(void)
+		{
+			return _capacity;
+		}
+
+		/**
+		 * Get queue's name.
+		 */
+		char* getName(void)
+		{
+			return _name.toString();
+		}
+
+		/**
+		 * Make a consumer blocked in get() return FAILURE.
+		 * If no consumer is blocked, the next blocking get() on
+		 * an empty queue returns FAILURE.
+		 */
+		void wakeConsumer(void)
+		{
+			Atomic::store(&_cwakeup, 1);
+			Atomic::barrier();
+
+			if (Atomic::load(&_cwait) && Atomic::compareAndSwap(&_cwait, 1, 0))
+				_semItems.post();
+		}
+
+		/**
+		 * Signal a wait set whenever an item is put.
+		 * @param ws the wait set or NULL.
+		 * @param mask the bits to signal.
+		 */
+		void setWaitSet(WaitSet* ws, uint32 mask)
+		{
+			_ws = ws; _wsmask = mask;
+		}
+	private:
+		/* no copy constructor */
+		TypedSPSCQueue(TypedSPSCQueue&)
+			: Object(UOSUTIL_RTTI_TYPED_SPSC_QUEUE)
+		{
+		}
+
+		/* padding size */
+		enum { _PAD = US_CACHE_LINE_SIZE };
+
+		char _pad0[_PAD];
+
+		/* --- producer's cache line --- */
+
+		/* next index to write */
+		volatile int32 _tail;
+
+		/* last consumer index seen by the producer */
+		uint32 _head_cache;
+
+		char _pad1[_PAD];
+
+		/* --- consumer's cache line --- */
+
+		/* next index to read */
+		volatile int32 _head;
+
+		/* last producer index seen by the consumer */
+		uint32 _tail_cache;
+
+		char _pad2[_PAD];
+
+		/* --- shared flags --- */
+
+		/* flag: the producer sleeps on _semSpace */
+		volatile int32 _pwait;
+
+		/* flag: the consumer sleeps on _semItems */
+		volatile int32 _cwait;
+
+		/* flag: consumer wake up request */
+		volatile int32 _cwakeup;
+
+		char _pad3[_PAD];
+
+		/* --- read only after init --- */
+
+		/* ring of items (aligned) and allocated block */
+		T* _ring;
+		char* _block;
+
+		/* ring slots minus one (slots are a power of 2) */
+		uint32 _mask;
+
+		/* queue capacity */
+		int32 _capacity;
+
+		/* queue's name */
+		DataBuf _name;
+
+		/* wait set signalled on put (or NULL) and its bits */
+		WaitSet* _ws;
+		uint32 _wsmask;
+
+		/* semaphore to sleep on when the queue is empty */
+		Semaphore _semItems;
+
+		/* semaphore to sleep on when the queue is full */
+		Semaphore _semSpace;
+	};
+
+	template <class T>
+	int32 TypedSPSCQueue<T>::init(char* name, int32 capacity)
+	{
+		uint32 slots = 1;
+		int32 ret = 0;
+
+		// do some checks
+		if (capacity <= 0)
+			capacity = 1;
+
+		ret = _name.init(name);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		_capacity = capacity;
+
+		// round slots count to the next power of 2
+		while (slots < (uint32) capacity)
+			slots <<= 1;
+
+		_mask = slots - 1;
+
+		// allocate the ring on a cache line boundary
+		_block = (char *) malloc(slots * sizeof(T) + US_CACHE_LINE_SIZE);
+		if (!_block)
+			return FAILURE;
+
+		_ring = (T *) (((size_t) _block + US_CACHE_LINE_SIZE - 1) &
+			~((size_t) US_CACHE_LINE_SIZE - 1));
+
+		// initialize semaphores
+		ret = _semItems.init(0);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		ret = _semSpace.init(0);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		// ok
+		setOk(true);
+		return SUCCESS;
+	}
+
+	template <class T>
+	uint32 TypedSPSCQueue<T>::tryPutMany(T* items, uint32 n)
+	{
+		uint32 tail = (uint32) _tail;
+		uint32 room = 0, i = 0;
+
+		// check for space using the cached consumer index first
+		room = (uint32) _capacity - (tail - _head_cache);
+		if (room < n) {
+			_head_cache = (uint32) Atomic::load(&_head);
+			room = (uint32) _capacity - (tail - _head_cache);
+		}
+
+		if (n > room)
+			n = room;
+		if (!n)
+			return 0;
+
+		// copy items
+		for (i = 0; i < n; i++)
+			_ring[(tail + i) & _mask] = items[i];
+
+		// publish all items at once
+		Atomic::store(&_tail, (int32) (tail + n));
+
+		// wake up the consumer if it is sleeping
+		Atomic::barrier();
+		if (Atomic::load(&_cwait) && Atomic::compareAndSwap(&_cwait, 1, 0))
+			_semItems.post();
+
+		if (_ws)
+			_ws->signal(_wsmask);
+
+		return n;
+	}
+
+	template <class T>
+	uint32 TypedSPSCQueue<T>::tryGetMany(T* items, uint32 n)
+	{
+		uint32 head = (uint32) _head;
+		uint32 avail = 0, i = 0;
+
+		// check for items using the cached producer index first
+		avail = _tail_cache - head;
+		if (avail < n) {
+			_tail_cache = (uint32) Atomic::load(&_tail);
+			avail = _tail_cache - head;
+		}
+
+		if (n > avail)
+			n = avail;
+		if (!n)
+			return 0;
+
+		// copy items
+		for (i = 0; i < n; i++)
+			items[i] = _ring[(head + i) & _mask];
+
+		// release all slots at once
+		Atomic::store(&_head, (int32) (head + n));
+
+		// wake up the producer if it is sleeping
+		Atomic::barrier();
+		if (Atomic::load(&_pwait) && Atomic::compareAndSwap(&_pwait, 1, 0))
+			_semSpace.post();
+
+		return n;
+	}
+
+	template <class T>
+	int32 TypedSPSCQueue<T>::put(T* item)
+	{
+		for (;;) {
+			if (tryPut(item) == SUCCESS)
+				return SUCCESS;
+
+			// announce we are going to sleep, then check again
+			Atomic::store(&_pwait, 1);
+			Atomic::barrier();
+
+			if (tryPut(item) == SUCCESS) {
+				Atomic::compareAndSwap(&_pwait, 1, 0);
+				return SUCCESS;
+			}
+
+			_semSpace.wait();
+		}
+	}
+
+	template <class T>
+	int32 TypedSPSCQueue<T>::get(T* item)
+	{
+		for (;;) {
+			if (tryGet(item) == SUCCESS)
+				return SUCCESS;
+
+			// announce we are going to sleep, then check again
+			Atomic::store(&_cwait, 1);
+			Atomic::barrier();
+
+			if (tryGet(item) == SUCCESS) {
+				Atomic::compareAndSwap(&_cwait, 1, 0);
+				return SUCCESS;
+			}
+
+			if (Atomic::exchange(&_cwakeup, 0)) {
+				Atomic::compareAndSwap(&_cwait, 1, 0);
+				return FAILURE;
+			}
+
+			_semItems.wait();
+
+			if (Atomic::exchange(&_cwakeup, 0))
+				return FAILURE;
+		}
+	}
+}
+
+#endif
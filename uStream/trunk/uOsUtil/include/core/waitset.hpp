@@ -0,0 +1,143 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef WAITSET_HPP
+#define WAITSET_HPP
+
+#include "semaphore.hpp"
+#include "callback.hpp"
+#include "atomic.hpp"
+
+namespace uStreamLib {
+	/**
+	 * A set of readiness bits one thread can wait on. Queues, buffer
+	 * pools and other threads signal the bits assigned to them; the
+	 * waiting thread sleeps until at least one bit is set and gets
+	 * all the bits set since its last wait. Bits are edge triggered:
+	 * a bit tells that something happened, the waiter must then look
+	 * at the source (eg. drain a queue) before waiting again.
+	 * The waiter sleeps on a semaphore which is posted only when
+	 * it is sleeping, so signalling a busy waiter makes no system
+	 * calls. Only one thread may wait at the same time.
+	 */
+	class US_API_EXPORT WaitSet : public Object {
+	public:
+		/**
+		 * A callback which signals some bits of a wait set when
+		 * performed, eg. by BufferPool::notifyOnFree().
+		 */
+		class US_API_EXPORT Trigger : public CallBack {
+		public:
+			/**
+			 * Constructor.
+			 * @param ws the wait set to signal.
+			 * @param mask the bits to signal.
+			 */
+			Trigger(WaitSet* ws, uint32 mask)
+				: _ws(ws), _mask(mask)
+			{
+			}
+
+			/**
+			 * Signal the bits.
+			 */
+			virtual int32 perform(void*)
+			{
+				_ws->signal(_mask); return SUCCESS;
+			}
+		private:
+			WaitSet* _ws;
+			uint32 _mask;
+		};
+
+		/**
+		 * Constructor.
+		 */
+		WaitSet(void);
+
+		/**
+		 * Destructor.
+		 */
+		virtual ~WaitSet(void);
+
+		/**
+		 * Create a wait set with no bits set.
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 init(void);
+
+		/**
+		 * Set some bits and wake up the waiting thread.
+		 * @param mask the bits to set.
+		 */
+		void signal(uint32 mask);
+
+		/**
+		 * Wait for some bits to be set, then clear them.
+		 * @param timeout time to wait for in milliseconds, 0 not to
+		 * wait or -1 to wait forever.
+		 * @return the bits set since the last wait or 0 if the time
+		 * expired.
+		 */
+		uint32 wait(int32 timeout = -1);
+
+		/**
+		 * Set a callback performed whenever some bits get set. A
+		 * scheduler can use it to run the owner of the wait set
+		 * (eg. a Task) instead of having a thread wait.
+		 * @param cb the callback or NULL.
+		 */
+		void setCallBack(CallBack* cb)
+		{
+			_cb = cb;
+		}
+
+		/**
+		 * Get the bits set since the last wait, without clearing them.
+		 * @return the bits set.
+		 */
+		uint32 peek(void)
+		{
+			return (uint32) Atomic::load(&_ready);
+		}
+	private:
+		/* no copy constructor */
+		WaitSet(WaitSet&)
+			: Object(UOSUTIL_RTTI_WAITSET)
+		{
+		}
+
+		/* bits set since the last wait */
+		volatile int32 _ready;
+
+		/* flag: the waiter sleeps on _sem */
+		volatile int32 _waiting;
+
+		/* semaphore to sleep on */
+		Semaphore _sem;
+
+		/* callback performed when bits get set */
+		CallBack* _cb;
+	};
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef IMPL_ATOMIC_HPP
+#define IMPL_ATOMIC_HPP
+
+#include "typedefs.hpp"
+
+namespace uStreamLib {
+	class Impl_Atomic {
+	public:
+		/* arithmetic (return the new value) */
+		static int32 add(volatile int32* v, int32 n)
+		{
+			return __atomic_add_fetch(v, n, __ATOMIC_ACQ_REL);
+		}
+
+		/* exchange (return the old value) */
+		static int32 exchange(volatile int32* v, int32 n)
+		{
+			return __atomic_exchange_n(v, n, __ATOMIC_ACQ_REL);
+		}
+
+		static void* exchangePtr(void* volatile* v, void* n)
+		{
+			return __atomic_exchange_n(v, n, __ATOMIC_ACQ_REL);
+		}
+
+		/* compare and swap */
+		static bool cas(volatile int32* v, int32 oldval, int32 newval)
+		{
+			return __atomic_compare_exchange_n(v, &oldval, newval, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+		}
+
+		static bool cas64(volatile uint64* v, uint64 oldval, uint64 newval)
+		{
+			return __atomic_compare_exchange_n(v, &oldval, newval, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+		}
+
+		static bool casPtr(void* volatile* v, void* oldval, void* newval)
+		{
+			return __atomic_compare_exchange_n(v, &oldval, newval, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+		}
+
+		/* loads and stores */
+		static int32 load(volatile int32* v)
+		{
+			return __atomic_load_n(v, __ATOMIC_ACQUIRE);
+		}
+
+		static uint64 load64(volatile uint64* v)
+		{
+			return __atomic_load_n(v, __ATOMIC_ACQUIRE);
+		}
+
+		static void* loadPtr(void* volatile* v)
+		{
+			return __atomic_load_n(v, __ATOMIC_ACQUIRE);
+		}
+
+		static void store(volatile int32* v, int32 n)
+		{
+			__atomic_store_n(v, n, __ATOMIC_RELEASE);
+		}
+
+		static void store64(volatile uint64* v, uint64 n)
+		{
+			__atomic_store_n(v, n, __ATOMIC_RELEASE);
+		}
+
+		static void storePtr(void* volatile* v, void* n)
+		{
+			__atomic_store_n(v, n, __ATOMIC_RELEASE);
+		}
+
+		/* full memory barrier */
+		static void barrier(void)
+		{
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		}
+
+		/* spin-wait hint */
+		static void pause(void)
+		{
+#if defined(__i386__) || defined(__x86_64__)
+			__builtin_ia32_pause();
+#endif
+		}
+	};
+}
+
+#endif
@@ -50,11 +50,15 @@ namespace uStreamLib {
 		/* read/write api */
 		int32 readFile(void* data, size_t size);
 		int32 writeFile(void* data, size_t size);
+		int32 writeFileV(dsegment* segs, uint32 count);
 
 		/* movement api */
 		int32 seek(int32 offset, int32 origin);
 		int32 skip(int32 bytes);
 	private:
+		/* segments written by a single writev() */
+		enum { _IOV_CHUNK = 64 };
+
 		/* file descriptor */
 		int32 _fd;
 	};
@@ -0,0 +1,51 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef IMPL_MEMORY_HPP
+#define IMPL_MEMORY_HPP
+
+#include "typedefs.hpp"
+
+namespace uStreamLib {
+	class Impl_Memory {
+	public:
+		/* aligned heap memory */
+		static void* alignedAlloc(size_t size, size_t alignment);
+		static void alignedFree(void* ptr);
+
+		/* page size */
+		static size_t getPageSize(void);
+
+		/* page mapped regions */
+		static void* mapRegion(size_t* size, bool hugepages);
+		static void unmapRegion(void* ptr, size_t size);
+
+		/* memory locking */
+		static int32 lockAll(void);
+		static void unlockAll(void);
+
+		/* NUMA placement */
+		static int32 bindToNode(void* ptr, size_t size, uint32 node);
+	};
+}
+
+#endif
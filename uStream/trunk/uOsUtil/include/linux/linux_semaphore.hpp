@@ -37,10 +37,12 @@ namespace uStreamLib {
 
 		/* initialization */
 		int32 init(uint32 init_value, bool process_shared);
+		int32 init(char* name, uint32 init_value, bool create);
 
 		/* public interface */
 		int32 wait(void);
 		int32 tryWait(void);
+		int32 timedWait(uint32 ms);
 		int32 post(void);
 		uint32 getValue(void);
 
@@ -49,6 +51,15 @@ namespace uStreamLib {
 	private:
 		/* semaphore descriptor (posix threads) */
 		sem_t _sem;
+
+		/* semaphore in use: &_sem or a named semaphore */
+		sem_t* _psem;
+
+		/* name of a named semaphore (or NULL) */
+		char* _name;
+
+		/* flag: this process created the named semaphore */
+		bool _owner;
 	};
 }
 
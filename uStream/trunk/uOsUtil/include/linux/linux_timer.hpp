@@ -40,6 +40,7 @@ namespace uStreamLib {
 		void start(void);
 		void stop(TimeDesc* td);
 		uint32 getElapsed(void);
+		static uint64 getMonotonicTime(void);
 	private:
 		// starting time
 		struct timeval _tv1;
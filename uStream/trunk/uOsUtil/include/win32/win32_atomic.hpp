@@ -0,0 +1,118 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef IMPL_ATOMIC_HPP
+#define IMPL_ATOMIC_HPP
+
+#include "typedefs.hpp"
+
+namespace uStreamLib {
+	class Impl_Atomic {
+	public:
+		/* arithmetic (return the new value) */
+		static int32 add(volatile int32* v, int32 n)
+		{
+			return InterlockedExchangeAdd((volatile LONG *) v, n) + n;
+		}
+
+		/* exchange (return the old value) */
+		static int32 exchange(volatile int32* v, int32 n)
+		{
+			return InterlockedExchange((volatile LONG *) v, n);
+		}
+
+		static void* exchangePtr(void* volatile* v, void* n)
+		{
+			return InterlockedExchangePointer(v, n);
+		}
+
+		/* compare and swap */
+		static bool cas(volatile int32* v, int32 oldval, int32 newval)
+		{
+			return InterlockedCompareExchange((volatile LONG *) v, newval,
+					oldval) == oldval;
+		}
+
+		static bool cas64(volatile uint64* v, uint64 oldval, uint64 newval)
+		{
+			return (uint64) InterlockedCompareExchange64((volatile LONGLONG *) v,
+					(LONGLONG) newval, (LONGLONG) oldval) == oldval;
+		}
+
+		static bool casPtr(void* volatile* v, void* oldval, void* newval)
+		{
+			return InterlockedCompareExchangePointer(v, newval, oldval) == oldval;
+		}
+
+		/* loads and stores (x86 has acquire/release semantics on plain moves) */
+		static int32 load(volatile int32* v)
+		{
+			int32 n = *v;
+			MemoryBarrier();
+			return n;
+		}
+
+		static uint64 load64(volatile uint64* v)
+		{
+			return (uint64) InterlockedCompareExchange64((volatile LONGLONG *) v,
+					0, 0);
+		}
+
+		static void* loadPtr(void* volatile* v)
+		{
+			void* p = *v;
+			MemoryBarrier();
+			return p;
+		}
+
+		static void store(volatile int32* v, int32 n)
+		{
+			MemoryBarrier();
+			*v = n;
+		}
+
+		static void store64(volatile uint64* v, uint64 n)
+		{
+			InterlockedExchange64((volatile LONGLONG *) v, (LONGLONG) n);
+		}
+
+		static void storePtr(void* volatile* v, void* n)
+		{
+			MemoryBarrier();
+			*v = n;
+		}
+
+		/* full memory barrier */
+		static void barrier(void)
+		{
+			MemoryBarrier();
+		}
+
+		/* spin-wait hint */
+		static void pause(void)
+		{
+			YieldProcessor();
+		}
+	};
+}
+
+#endif
@@ -40,6 +40,7 @@ namespace uStreamLib {
 		/* read/write api */
 		int32 readFile(void* data, uint32 size);
 		int32 writeFile(void* data, uint32 size);
+		int32 writeFileV(dsegment* segs, uint32 count);
 
 		/* movement api */
 		int32 seek(int32 offset, int32 origin);
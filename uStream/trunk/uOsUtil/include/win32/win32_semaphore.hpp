@@ -36,10 +36,12 @@ namespace uStreamLib {
 
 		/* initialization */
 		int32 init(uint32 init_value, bool process_shared);
+		int32 init(char* name, uint32 init_value, bool create);
 
 		/* public interface */
 		int32 wait(void);
 		int32 tryWait(void);
+		int32 timedWait(uint32 ms);
 		int32 post(void);
 		uint32 getValue(void);
 
@@ -36,15 +36,24 @@ namespace uStreamLib {
 		~Impl_Thread(void);
 
 		/* initialization */
-		int32 init(Thread* t);
+		int32 init(Thread* t, uint32 stack_size);
 
 		/* static public interface */
 		static void sleep(int32 milliseconds);
+		static void sleepUntil(uint64 us);
+		static uint32 getCurrentSlot(void);
+		static uint32 getProcessorsCount(void);
 
 		/* public interface */
 		void detach(void);
 		void join(void** ret_data);
 		void cancel(void);
+
+		/* settings (started() is called by the running thread) */
+		void started(void);
+		int32 setAffinity(uint64 cpus);
+		int32 setScheduling(int32 policy, int32 priority);
+		int32 setNice(int32 nice);
 	private:
 		// win32 thread handle
 		HANDLE _tid;
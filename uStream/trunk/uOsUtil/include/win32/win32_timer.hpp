@@ -38,6 +38,7 @@ namespace uStreamLib {
 		void start(void);
 		void stop(TimeDesc* td);
 		uint32 getElapsed(void);
+		static uint64 getMonotonicTime(void);
 	private:
 		// start instant
 		LARGE_INTEGER _tstart;
@@ -21,45 +21,39 @@
 
 #include "bufferpool.hpp"
 #include "thread.hpp"
+#include "memory.hpp"
 
 namespace uStreamLib {
 	BufferPool::BufferPool(void)
-		: Object(UOSUTIL_RTTI_BUFFER_POOL), _bufs(NULL), _bcount(0)
+		: Object(UOSUTIL_RTTI_BUFFER_POOL), _bufs(NULL), _bcount(0),
+		_live(0), _maxcount(0), _basecount(0), _parked(NULL),
+		_retiring(0), _misses(0), _lowfree(0), _idle(0), _bsize(0),
+		_limit(0), _strategy(DataBuf::ALLOC_ONUSE), _next(NULL),
+		_head(_NIL), _free(0), _waiters(0), _users(0), _region(NULL),
+		_regionSize(0), _stride(0), _freecb(NULL), _notifying(0),
+		_pinned(false)
 	{
-		// nothing to do
+		memset(_mags, 0, sizeof(_mags));
+		memset((void *) _notify, 0, sizeof(_notify));
 	}
 
 	BufferPool::~BufferPool(void)
 	{
-		uint32 bid = 0, i = 0;
-		uint32 wait = 10, bc = 0;
+		uint32 i = 0, wait = 10;
+		bool leaked = false;
 
 		MutexLocker ml(&_mutexReset);
 
+		// buffers freed from now on must not wait for the mutex
+		Atomic::store(&_retiring, 0);
+
 		/*
-		 * Here we must free the unlocked buffers first,
-		 * then wait some time for further buffers that will
-		 * be freed by worker threads.
+		 * Wait some time for buffers that will be freed by
+		 * worker threads.
 		 */
-		while (bc < _bcount && i++ < wait) {
-			DataBuf* buf = (DataBuf*) _psFree.pop();
-			if (buf) {
-				// get buffer id
-				bid = buf->getBID();
-
-				// free selected buffer
-				delete _bufs[bid];
-
-				// reset pointer
-				_bufs[bid] = NULL;
-
-				// count freed buffers
-				bc++;
-			} else {
-				// wait some time
-				Thread::sleep(50);
-			}
-		}
+		while (!_freecb && Atomic::load(&_free) < Atomic::load(&_live) &&
+			i++ < wait)
+			Thread::sleep(50);
 
 		/*
 		 * Timeout expired, so check which buffers are not
@@ -67,20 +61,13 @@ namespace uStreamLib {
 		 */
 		for (i = 0; i < _bcount; i++) {
 			if (_bufs[i]) {
-				// DEBUG
-				UOSUTIL_DOUT(("BufferPool: Buffer %d is NOT NULL\n", i));
 				if (!_bufs[i]->isInUse()) {
-					// DEBUG
-					UOSUTIL_DOUT(("BufferPool: Buffer %d is NOT IN USE\n", i));
-					UOSUTIL_DOUT(("BufferPool: Buffer %d will be DELETED\n", i));
 					delete _bufs[i];
 				} else {
-				        // DEBUG
+					// DEBUG
 					UOSUTIL_DOUT(("BufferPool: Buffer %d is IN USE: leaked\n", i));
+					leaked = true;
 				}
-			} else {
-				// DEBUG
-				UOSUTIL_DOUT(("BufferPool: Buffer %d is NULL, ignored\n", i));
 			}
 		}
 
@@ -89,12 +76,20 @@ namespace uStreamLib {
 		 */
 
 		delete[] _bufs;
+		delete[] _next;
+		delete[] _parked;
+
+		// leaked buffers may still point into the region
+		if (_region && _regionSize && !leaked)
+			Memory::unmapRegion(_region, _regionSize);
 	}
 
 	int32 BufferPool::init(char* name, uint32 bsize, uint32 bcount,
-		uint32 limit)
+		uint32 limit, DataBuf::AllocStrategy strategy, uint32 flags,
+		uint32 maxcount)
 	{
 		int32 ret = 0;
+		size_t stride = 0, align = US_CACHE_LINE_SIZE;
 
 		// do some checks
 		if (!bsize)
@@ -104,28 +99,38 @@ namespace uStreamLib {
 
 		// initialize buffers count
 		_bcount = bcount;
+		_live = bcount;
+		_basecount = bcount;
+		_maxcount = maxcount > bcount ? maxcount : bcount;
+		_lowfree = bcount;
+
+		// the creator is the first user
+		_users = 1;
 
 		// initialize buffer pool's name buffer
 		ret = _dbName.init(name);
 		if (ret == FAILURE)
 			return FAILURE;
 
-		// create buffers array
-		_bufs = new DataBuf * [bcount];
+		// create buffers array (room to grow to max count)
+		_bufs = new DataBuf * [_maxcount];
 		if (!_bufs)
 			return FAILURE;
+		memset(_bufs, 0, _maxcount * sizeof(DataBuf *));
 
-		// initialize buffer ids stack
-		ret = _psFree.init(bcount);
-		if (ret == FAILURE)
+		// create free stack links
+		_next = new uint32[_maxcount];
+		if (!_next)
 			return FAILURE;
 
-		// initialize semaphores
-		ret = _semFree.init(bcount);
-		if (ret == FAILURE)
+		// create retired flags
+		_parked = new bool[_maxcount];
+		if (!_parked)
 			return FAILURE;
+		memset(_parked, 0, _maxcount * sizeof(bool));
 
-		ret = _semUsed.init(0);
+		// initialize semaphore
+		ret = _semFree.init(0);
 		if (ret == FAILURE)
 			return FAILURE;
 
@@ -134,18 +139,50 @@ namespace uStreamLib {
 		if (ret == FAILURE)
 			return FAILURE;
 
+		// align buffer size to 64 bit boundaries
+		if (bsize % 8)
+			bsize = ((bsize >> 3) + 1) << 3;
+
+		// buffers added later are allocated on the heap
+		_bsize = bsize;
+		_limit = limit;
+		_strategy = strategy;
+
+		// map one region for all buffers
+		if (flags & (POOL_CONTIGUOUS | POOL_HUGEPAGES)) {
+			if (strategy & DataBuf::ALLOC_ALIGN_PAGE)
+				align = Memory::getPageSize();
+
+			// each buffer starts on an aligned boundary
+			stride = ((bsize + align - 1) / align) * align;
+			_regionSize = stride * bcount;
+			_stride = (uint32) stride;
+			_region = (char *) Memory::mapRegion(&_regionSize,
+				(flags & POOL_HUGEPAGES) != 0);
+			if (!_region)
+				return FAILURE;
+		}
+
 		// allocate each buffer
 		for (uint32 i = 0; i < bcount; i++) {
 			// create databuf
 			_bufs[i] = new DataBuf();
 
 			// initialize databuf
-			ret = _bufs[i]->init(bsize, i, limit, DataBuf::ALLOC_ONUSE, this);
+			ret = _bufs[i]->init(bsize, i, limit, _region ?
+				(DataBuf::AllocStrategy) ((strategy &
+				~DataBuf::ALLOC_ONCREATE) | DataBuf::ALLOC_ONUSE) :
+				strategy, this);
 			if (ret == FAILURE)
 				return FAILURE;
 
-			// push buffer pointer into the "free buffers" stack
-			_psFree.push(_bufs[i]);
+			// give it its slice of the region
+			if (_region)
+				_bufs[i]->_setExternal(&_region[i * stride], bsize);
+
+			// push buffer id into the free stack
+			_push(i);
+			_free++;
 		}
 
 		// ok
@@ -153,131 +190,406 @@ namespace uStreamLib {
 		return SUCCESS;
 	}
 
+	int32 BufferPool::initView(char* name, char* region, uint32 stride,
+		uint32 bsize, uint32 bcount, CallBack* freecb)
+	{
+		int32 ret = 0;
+
+		// do some checks
+		if (!region || !freecb || !bsize || !bcount || stride < bsize)
+			return FAILURE;
+
+		// a view has a fixed count of buffers
+		_bcount = bcount;
+		_live = bcount;
+		_basecount = bcount;
+		_maxcount = bcount;
+		_users = 1;
+
+		// buffers are not freed into this pool
+		_region = region;
+		_regionSize = 0;
+		_stride = stride;
+		_freecb = freecb;
+
+		_bsize = bsize;
+		_limit = bsize;
+		_strategy = DataBuf::ALLOC_ONUSE;
+
+		// initialize buffer pool's name buffer
+		ret = _dbName.init(name);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		_bufs = new DataBuf * [bcount];
+		_next = new uint32[bcount];
+		_parked = new bool[bcount];
+		if (!_bufs || !_next || !_parked)
+			return FAILURE;
+		memset(_bufs, 0, bcount * sizeof(DataBuf *));
+		memset(_parked, 0, bcount * sizeof(bool));
+
+		// getBuffer() may be called by mistake: it just waits
+		ret = _semFree.init(0);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		ret = _mutexReset.init();
+		if (ret == FAILURE)
+			return FAILURE;
+
+		// each buffer is its slice of the region
+		for (uint32 i = 0; i < bcount; i++) {
+			_bufs[i] = new DataBuf();
+
+			ret = _bufs[i]->init(bsize, i, bsize, _strategy, this);
+			if (ret == FAILURE)
+				return FAILURE;
+
+			_bufs[i]->_setExternal(&region[i * stride], bsize);
+		}
+
+		// ok
+		setOk(true);
+		return SUCCESS;
+	}
+
+	DataBuf* BufferPool::claimBuffer(uint32 bid)
+	{
+		if (!_freecb || bid >= _bcount)
+			return NULL;
+
+		// the buffer may have been stretched to the heap
+		if (!isInRegion(bid))
+			_bufs[bid]->_setExternal(&_region[bid * _stride], _bsize);
+
+		// the caller holds the first reference
+		_bufs[bid]->m_iRefCount = 1;
+		_bufs[bid]->setCount(0);
+		_bufs[bid]->setInUse(true);
+
+		return _bufs[bid];
+	}
+
 	int32 BufferPool::resize(uint32 bsize, uint32 bcount)
 	{
+		int32 r = 0;
+
 		// lock mutex for reset
 		MutexLocker ml(&_mutexReset);
 
-		// output
-		fprintf(stderr, "BufferPool::resize(%u,%u)", bsize, bcount);
+		// arrays cannot grow beyond max count
+		if (!bcount || bcount > _maxcount)
+			return FAILURE;
 
-		// resize is not implemented
-		return FAILURE;
+		// new size for buffers added from now on
+		if (bsize % 8)
+			bsize = ((bsize >> 3) + 1) << 3;
+		if (bsize)
+			_bsize = bsize;
+
+		// this is the count to restore after a shrink
+		_basecount = bcount;
+
+		// grow: cancel pending retirements, then add buffers
+		while ((uint32) (Atomic::load(&_live) -
+			Atomic::load(&_retiring)) < bcount) {
+			r = Atomic::load(&_retiring);
+			if (r > 0) {
+				Atomic::compareAndSwap(&_retiring, r, r - 1);
+				continue;
+			}
+
+			if (!_addBuffer())
+				return FAILURE;
+		}
+
+		// shrink (does nothing if there are no more buffers)
+		_shrink(bcount);
+
+		// ok
+		return SUCCESS;
 	}
 
-	uint32 BufferPool::getBuffer(void)
+	void BufferPool::shrink(uint32 bcount)
 	{
-		DataBuf* buf = NULL;
+		// prefaulted memory stays
+		if (_pinned)
+			return;
 
-		// lock mutex for reset
 		MutexLocker ml(&_mutexReset);
 
-		// decrement free buffers counter
-		_semFree.wait();
+		_shrink(bcount);
+	}
+
+	void BufferPool::housekeep(void)
+	{
+		int32 low = 0, target = 0;
+
+		// start a new period
+		low = Atomic::exchange(&_lowfree, Atomic::load(&_free));
+		Atomic::store(&_misses, 0);
 
-		// get bid from stack
-		buf = (DataBuf *) _psFree.pop();
+		// prefaulted memory stays
+		if (_pinned)
+			return;
 
-		// check if there are no more free buffers
-		if (!buf) {
-			fprintf(stderr, "BufferPool: NO MORE FREE BUFFERS...\n");
-			return 0;
+		// some buffers have not been used during the whole period
+		if (low <= 0 || Atomic::load(&_waiters) > 0) {
+			_idle = 0;
+			return;
 		}
 
-		// increment used buffers counter
-		_semUsed.post();
+		if (++_idle < _IDLE_ROUNDS)
+			return;
+		_idle = 0;
 
-		// return this bid
-		return buf->getBID();
+		// never wait here for a thread growing the pool
+		if (_mutexReset.tryLock() == FAILURE)
+			return;
+
+		// shrink by half of the unused buffers
+		target = Atomic::load(&_live) - Atomic::load(&_retiring) -
+			(low + 1) / 2;
+		_shrink(target > 0 ? (uint32) target : 1);
+
+		_mutexReset.unlock();
 	}
 
-	int32 BufferPool::tryGetBuffer(uint32* bid)
+	int32 BufferPool::prefault(void)
 	{
-		int32 ret = 0;
+		uint32* bids = NULL;
+		uint32 count = 0, i = 0;
+		int32 ret = SUCCESS;
 
 		// lock mutex for reset
 		MutexLocker ml(&_mutexReset);
 
-		// decrement free buffers counter
-		ret = _semFree.tryWait();
-		if (ret == FAILURE)
+		_pinned = true;
+
+		// views use memory owned by someone else
+		if (_freecb)
+			return SUCCESS;
+
+		bids = new uint32[_maxcount];
+		if (!bids)
 			return FAILURE;
 
-		DataBuf* buf = (DataBuf*) _psFree.pop();
-		if (!buf) {
-			puts("Critical: null buffer in pool"); return FAILURE;
+		// buffers in use are touched by their users: take the free ones
+		while (count < _maxcount && _take(&bids[count]))
+			count++;
+
+		for (i = 0; i < count; i++) {
+			DataBuf* db = _bufs[bids[i]];
+
+			// buffers allocated on use get their memory now
+			if (!db->getAddr() && db->realloc(_bsize) == FAILURE) {
+				ret = FAILURE;
+				continue;
+			}
+
+			db->set(0, 0);
 		}
 
-		*bid = buf->getBID();
+		// give them back
+		for (i = 0; i < count; i++) {
+			Atomic::increment(&_free);
+			_push(bids[i]);
+		}
 
-		// increment used buffers counter
-		_semUsed.post();
+		delete [] bids;
 
-		// ok
-		return SUCCESS;
+		// a thread may have started waiting in the meantime
+		Atomic::barrier();
+		if (count && Atomic::load(&_waiters) > 0)
+			_semFree.post();
+
+		return ret;
 	}
 
-	void BufferPool::freeBuffer(uint32 bid)
+	int32 BufferPool::bindToNode(uint32 node)
 	{
-		int32 ret = 0;
+		uint32 i = 0;
+		int32 ret = SUCCESS;
 
 		// lock mutex for reset
 		MutexLocker ml(&_mutexReset);
 
-		if (bid < _bcount) {
-			// decrement used buffers counter
-			_semUsed.wait();
+		// contiguous buffers move at once
+		if (_region && _regionSize)
+			return Memory::bindToNode(_region, _regionSize, node);
 
-			_bufs[bid]->setCount(0);
-			_bufs[bid]->setInUse(false);
+		// views use memory owned by someone else
+		if (_freecb)
+			return SUCCESS;
+
+		for (i = 0; i < _bcount; i++) {
+			DataBuf* db = _bufs[i];
 
-			ret = _psFree.push(_bufs[bid]);
-			if (ret == FAILURE) {
-				fprintf(stderr, "BufferPool: STACK IS FULL.\n");
+			if (_parked[i] || !db->getAddr())
+				continue;
+
+			if (Memory::bindToNode(db->getAddr(), db->getSize(),
+				node) == FAILURE)
+				ret = FAILURE;
+		}
+
+		return ret;
+	}
+
+	uint32 BufferPool::getBuffer(void)
+	{
+		uint32 bid = 0;
+
+		while (!_take(&bid)) {
+			// try to grow before waiting
+			if (_grow(true))
+				continue;
+
+			/*
+			 * Announce we are going to wait, then check again:
+			 * a buffer freed before the announcement is found
+			 * here, a buffer freed after it posts the semaphore.
+			 */
+			Atomic::increment(&_waiters);
+			Atomic::barrier();
+
+			if (_take(&bid)) {
+				Atomic::decrement(&_waiters);
+				break;
 			}
 
-			// increment free buffers counter
+			_semFree.wait();
+			Atomic::decrement(&_waiters);
+		}
+
+		// the caller holds the first reference
+		_bufs[bid]->m_iRefCount = 1;
+		_bufs[bid]->setInUse(true);
+
+		// return this bid
+		return bid;
+	}
+
+	int32 BufferPool::tryGetBuffer(uint32* bid)
+	{
+		if (!_take(bid) && !(_grow(false) && _take(bid)))
+			return FAILURE;
+
+		// the caller holds the first reference
+		_bufs[*bid]->m_iRefCount = 1;
+		_bufs[*bid]->setInUse(true);
+
+		// ok
+		return SUCCESS;
+	}
+
+	void BufferPool::freeBuffer(uint32 bid)
+	{
+		Magazine* mag = NULL;
+		bool cached = false;
+		int32 refs = 0;
+
+		if (bid >= _bcount)
+			return;
+
+		// a shared buffer is recycled by its last consumer only
+		refs = _bufs[bid]->release();
+		if (refs > 0)
+			return;
+
+		// the buffer is free already: recycling it again would hand it
+		// out twice
+		if (refs < 0) {
+			_bufs[bid]->addRef();
+			UOSUTIL_DOUT(("BufferPool: Buffer %u freed twice\n", bid));
+			return;
+		}
+
+		_bufs[bid]->m_iRefCount = 0;
+		_bufs[bid]->setCount(0);
+		_bufs[bid]->setInUse(false);
+
+		// buffers of a view go back to the owner of the region
+		if (_freecb) {
+			_freecb->perform(&bid);
+			return;
+		}
+
+		// the pool is shrinking
+		if (_retire(bid))
+			return;
+
+		Atomic::increment(&_free);
+
+		// waiting threads take buffers from the stack
+		if (Atomic::load(&_waiters) > 0) {
+			_push(bid);
 			_semFree.post();
+		} else {
+			// keep the buffer in the cache of this thread if possible
+			mag = _magazine();
+			for (uint32 i = 0; i < _MAGAZINE_SIZE && !cached; i++) {
+				if (!mag->slots[i])
+					cached = Atomic::compareAndSwap(&mag->slots[i], 0,
+						(int32) bid + 1);
+			}
+
+			if (!cached)
+				_push(bid);
+
+			// a thread may have started waiting in the meantime
+			Atomic::barrier();
+			if (Atomic::load(&_waiters) > 0)
+				_semFree.post();
 		}
+
+		// sleeping blocks want to know
+		if (Atomic::load(&_notifying) > 0)
+			_notifyFree();
 	}
 
-	DataBuf* BufferPool::use(uint32 bid)
+	int32 BufferPool::notifyOnFree(CallBack* cb)
 	{
-		DataBuf* buf = NULL;
+		uint32 i = 0;
 
-		// lock mutex for reset
-		MutexLocker ml(&_mutexReset);
+		for (i = 0; i < _NOTIFY_SLOTS; i++) {
+			if (Atomic::loadPtr(&_notify[i]) == cb)
+				return SUCCESS;
+		}
 
-		if (bid < _bcount) {
-			buf = _bufs[bid];
-			buf->setInUse(true);
+		for (i = 0; i < _NOTIFY_SLOTS; i++) {
+			if (Atomic::compareAndSwapPtr(&_notify[i], NULL, cb)) {
+				Atomic::increment(&_notifying);
+				return SUCCESS;
+			}
 		}
 
-		// ok
-		return buf;
+		return FAILURE;
+	}
+
+	void BufferPool::cancelNotify(CallBack* cb)
+	{
+		for (uint32 i = 0; i < _NOTIFY_SLOTS; i++) {
+			if (Atomic::compareAndSwapPtr(&_notify[i], cb, NULL))
+				Atomic::decrement(&_notifying);
+		}
 	}
 
 	int32 BufferPool::getBuffersCount(void)
 	{
-		// lock mutex for reset
-		MutexLocker ml(&_mutexReset);
-		return _bcount;
+		return Atomic::load(&_live);
 	}
 
 	int32 BufferPool::getFreeBuffersCount(void)
 	{
-		// lock mutex for reset
-		MutexLocker ml(&_mutexReset);
-		return _psFree.getStackPointer();
+		return Atomic::load(&_free);
 	}
 
 	uint32 BufferPool::getBufferSize(uint32 bid)
 	{
 		uint32 ret = 0;
 
-		// lock mutex for reset
-		MutexLocker ml(&_mutexReset);
-
 		if (bid < _bcount)
 			ret = _bufs[bid]->getSize();
 
@@ -287,46 +599,292 @@ namespace uStreamLib {
 
 	void BufferPool::reset(void)
 	{
-		DataBuf* buf = NULL;
-		int32 ret = 0;
+		int32 waiters = 0;
+
+		// buffers of a view belong to the owner of the region
+		if (_freecb)
+			return;
 
 		// lock mutex for reset
 		MutexLocker ml(&_mutexReset);
 
-		// empty buffers stack
-		for (uint32 j = 0; j < _bcount; j++) {
-			buf = (DataBuf *) _psFree.pop();
-			if (!buf)
-				break;
-
-			UOSUTIL_DOUT(("Get buffer from the stack: %u\n", buf->getBID()));
-		}
+		// empty caches and free stack
+		memset(_mags, 0, sizeof(_mags));
+		Atomic::store64(&_head, (uint64) _NIL);
 
-		// reset "used" semaphore
-		while ((ret = _semUsed.tryWait()) != FAILURE)
-			UOSUTIL_DOUT(("Waiting on semaphore \"used\"\n"));
+		// in use buffers are freed here: nothing left to retire
+		Atomic::store(&_retiring, 0);
 
-		// reset "free" semaphore    
-		while ((ret = _semFree.tryWait()) != FAILURE)
-			UOSUTIL_DOUT(("Waiting on semaphore \"free\"\n"));
-
-		// put all buffers in the buffers stack
+		// put all buffers in the free stack
 		for (uint32 i = 0; i < _bcount; i++) {
+			// retired buffers stay out
+			if (_parked[i])
+				continue;
+
 			// reset buffer
 			_bufs[i]->setInUse(false);
 			_bufs[i]->setCount(0);
+			_bufs[i]->m_iRefCount = 0;
 
-			// push buffer pointer into the "free buffers" stack
-			_psFree.push(_bufs[i]);
+			_push(i);
 
 			// DEBUG
-			UOSUTIL_DOUT(("Buffer %u pushed.\n", _bufs[i]->getBID()));
+			UOSUTIL_DOUT(("Buffer %u pushed.\n", i));
 		}
 
-		// reset "free" semaphore    
-		for (uint32 k = 0; k < _bcount; k++) {
-			UOSUTIL_DOUT(("Posting semaphore \"free\" (%u)\n", k));
+		Atomic::store(&_free, Atomic::load(&_live));
+
+		// wake up waiting threads
+		waiters = Atomic::load(&_waiters);
+		while (waiters-- > 0)
 			_semFree.post();
+	}
+
+	bool BufferPool::_take(uint32* bid)
+	{
+		Magazine* mag = _magazine();
+		uint32 i = 0, m = 0;
+		int32 v = 0;
+
+		// cache of this thread first
+		for (i = 0; i < _MAGAZINE_SIZE; i++) {
+			if (mag->slots[i]) {
+				v = Atomic::exchange(&mag->slots[i], 0);
+				if (v) {
+					*bid = (uint32) v - 1;
+					_used();
+					return true;
+				}
+			}
+		}
+
+		// then the shared stack
+		*bid = _pop();
+		if (*bid != _NIL) {
+			_used();
+			return true;
+		}
+
+		// finally steal from the other caches
+		if (Atomic::load(&_free) <= 0)
+			return false;
+
+		for (m = 1; m < _MAGAZINES; m++) {
+			Magazine* other = &_mags[(mag - _mags + m) % _MAGAZINES];
+
+			for (i = 0; i < _MAGAZINE_SIZE; i++) {
+				if (other->slots[i]) {
+					v = Atomic::exchange(&other->slots[i], 0);
+					if (v) {
+						*bid = (uint32) v - 1;
+						_used();
+						return true;
+					}
+				}
+			}
 		}
+
+		return false;
+	}
+
+	void BufferPool::_push(uint32 bid)
+	{
+		uint64 head = 0, nhead = 0;
+
+		do {
+			head = Atomic::load64(&_head);
+			_next[bid] = (uint32) head;
+			nhead = (((head >> 32) + 1) << 32) | bid;
+		} while (!Atomic::compareAndSwap64(&_head, head, nhead));
+	}
+
+	uint32 BufferPool::_pop(void)
+	{
+		uint64 head = 0, nhead = 0;
+		uint32 bid = 0;
+
+		do {
+			head = Atomic::load64(&_head);
+			bid = (uint32) head;
+			if (bid == _NIL)
+				return _NIL;
+
+			/*
+			 * _next[bid] may be stale if another thread pops bid
+			 * meanwhile: the tag makes the swap fail in that case.
+			 */
+			nhead = (((head >> 32) + 1) << 32) | _next[bid];
+		} while (!Atomic::compareAndSwap64(&_head, head, nhead));
+
+		return bid;
+	}
+
+	void BufferPool::_used(void)
+	{
+		int32 f = Atomic::decrement(&_free);
+
+		// track the low water mark for housekeep()
+		if (f < Atomic::load(&_lowfree))
+			Atomic::store(&_lowfree, f);
+	}
+
+	bool BufferPool::_grow(bool wait)
+	{
+		int32 r = 0;
+		uint32 n = 0;
+		bool grown = false;
+
+		if ((uint32) Atomic::load(&_live) >= _maxcount)
+			return false;
+
+		// restore the base count at once, go beyond it on misses only
+		if ((uint32) Atomic::load(&_live) >= _basecount &&
+			Atomic::increment(&_misses) < _GROW_MISSES)
+			return false;
+
+		if (wait)
+			_mutexReset.lock();
+		else if (_mutexReset.tryLock() == FAILURE)
+			return false;
+
+		// grow by half of the pool
+		n = (uint32) Atomic::load(&_live) / 2;
+		if (!n)
+			n = 1;
+
+		// buffers about to be retired are kept first
+		while (n && (r = Atomic::load(&_retiring)) > 0) {
+			if (Atomic::compareAndSwap(&_retiring, r, r - 1)) {
+				n--; grown = true;
+			}
+		}
+
+		while (n-- && _addBuffer())
+			grown = true;
+
+		Atomic::store(&_misses, 0);
+
+		_mutexReset.unlock();
+		return grown;
+	}
+
+	bool BufferPool::_addBuffer(void)
+	{
+		uint32 bid = _NIL, i = 0;
+		DataBuf* db = NULL;
+
+		if ((uint32) Atomic::load(&_live) >= _maxcount)
+			return false;
+
+		// revive a retired buffer first
+		for (i = 0; i < _bcount; i++) {
+			if (_parked[i]) {
+				bid = i; break;
+			}
+		}
+
+		if (bid != _NIL) {
+			// memory is allocated again if needed
+			if (!(_strategy & DataBuf::ALLOC_ONUSE) &&
+				_bufs[bid]->realloc(_bsize) == FAILURE)
+				return false;
+
+			_parked[bid] = false;
+		} else {
+			if (_bcount >= _maxcount)
+				return false;
+
+			// create a new buffer
+			bid = _bcount;
+			db = new DataBuf();
+			if (!db)
+				return false;
+
+			if (db->init(_bsize, bid, _limit, _strategy, this) == FAILURE) {
+				delete db; return false;
+			}
+
+			// publish the buffer before its bid
+			_bufs[bid] = db;
+			Atomic::barrier();
+			_bcount = bid + 1;
+		}
+
+		Atomic::increment(&_live);
+		Atomic::increment(&_free);
+		_push(bid);
+
+		// wake up a waiting thread
+		Atomic::barrier();
+		if (Atomic::load(&_waiters) > 0)
+			_semFree.post();
+
+		return true;
+	}
+
+	void BufferPool::_park(uint32 bid)
+	{
+		_bufs[bid]->_releaseBlock();
+		_parked[bid] = true;
+		Atomic::decrement(&_live);
+	}
+
+	bool BufferPool::_retire(uint32 bid)
+	{
+		int32 r = 0;
+
+		// waiting threads need every buffer
+		if (Atomic::load(&_waiters) > 0)
+			return false;
+
+		while ((r = Atomic::load(&_retiring)) > 0) {
+			if (Atomic::compareAndSwap(&_retiring, r, r - 1)) {
+				MutexLocker ml(&_mutexReset);
+
+				_park(bid);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void BufferPool::_notifyFree(void)
+	{
+		CallBack* cb = NULL;
+
+		for (uint32 i = 0; i < _NOTIFY_SLOTS; i++) {
+			cb = (CallBack *) Atomic::exchangePtr(&_notify[i], NULL);
+			if (cb) {
+				Atomic::decrement(&_notifying);
+				cb->perform(this);
+			}
+		}
+	}
+
+	void BufferPool::_shrink(uint32 bcount)
+	{
+		int32 excess = 0;
+		uint32 bid = 0;
+
+		// a view never shrinks
+		if (_freecb)
+			return;
+
+		if (!bcount)
+			bcount = 1;
+
+		excess = Atomic::load(&_live) - Atomic::load(&_retiring) -
+			(int32) bcount;
+
+		// free buffers are retired at once
+		while (excess > 0 && _take(&bid)) {
+			_park(bid);
+			excess--;
+		}
+
+		// buffers in use when they are freed
+		if (excess > 0)
+			Atomic::add(&_retiring, excess);
 	}
 }
@@ -0,0 +1,173 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include <stdlib.h>
+
+#include "cpu_topology.hpp"
+#include "thread.hpp"
+
+/*
+ * Here, we choose the right implementation using
+ * conditional compilation.
+ */
+
+#if defined(_WIN32) || defined(WIN32)
+#include "win32_cpu_topology.hpp"
+#else
+#include "linux_cpu_topology.hpp"
+#endif
+
+namespace uStreamLib {
+	CpuTopology::CpuTopology(void)
+		: Object(UOSUTIL_RTTI_CPU_TOPOLOGY), _count(0), _nodes(0)
+	{
+		// nothing to do
+	}
+
+	CpuTopology::~CpuTopology(void)
+	{
+		// nothing to do
+	}
+
+	int32 CpuTopology::init(void)
+	{
+		uint32 i = 0, n = 0;
+
+		_count = Impl_CpuTopology::read(_cpus, MAX_CPUS);
+
+		// nothing known: one processor per core and package
+		if (!_count) {
+			n = Thread::getProcessorsCount();
+			for (i = 0; i < n && i < MAX_CPUS; i++) {
+				_cpus[i].cpu = i;
+				_cpus[i].core = i;
+				_cpus[i].package = i;
+				_cpus[i].node = 0;
+				_cpus[i].l2 = i;
+				_cpus[i].l3 = i;
+			}
+
+			_count = i;
+		}
+
+		_nodes = 0;
+		for (i = 0; i < _count; i++) {
+			if (_cpus[i].node >= _nodes)
+				_nodes = _cpus[i].node + 1;
+		}
+
+		// ok
+		setOk(true);
+		return SUCCESS;
+	}
+
+	uint64 CpuTopology::getMask(uint32 cpu, int32 what)
+	{
+		CpuInfo* c = NULL;
+		uint64 mask = 0;
+		uint32 i = 0;
+
+		for (i = 0; i < _count; i++) {
+			if (_cpus[i].cpu == cpu)
+				c = &_cpus[i];
+		}
+
+		if (!c)
+			return 0;
+
+		for (i = 0; i < _count; i++) {
+			CpuInfo* o = &_cpus[i];
+			bool same = false;
+
+			switch (what) {
+			case SHARE_CORE:
+				same = o->package == c->package && o->core == c->core;
+				break;
+			case SHARE_L2:
+				same = o->l2 == c->l2;
+				break;
+			case SHARE_L3:
+				same = o->l3 == c->l3;
+				break;
+			case SHARE_PACKAGE:
+				same = o->package == c->package;
+				break;
+			case SHARE_NODE:
+				same = o->node == c->node;
+				break;
+			}
+
+			if (same)
+				mask |= (uint64) 1 << o->cpu;
+		}
+
+		return mask;
+	}
+
+	uint64 CpuTopology::getNodeMask(uint32 node)
+	{
+		uint64 mask = 0;
+		uint32 i = 0;
+
+		for (i = 0; i < _count; i++) {
+			if (_cpus[i].node == node)
+				mask |= (uint64) 1 << _cpus[i].cpu;
+		}
+
+		return mask;
+	}
+
+	int32 CpuTopology::parseList(char* s, uint64* cpus)
+	{
+		uint32 first = 0, last = 0;
+		char* end = NULL;
+
+		*cpus = 0;
+
+		while (*s && *s != '\n') {
+			first = last = (uint32) strtoul(s, &end, 10);
+			if (end == s)
+				return FAILURE;
+			s = end;
+
+			if (*s == '-') {
+				last = (uint32) strtoul(++s, &end, 10);
+				if (end == s || last < first)
+					return FAILURE;
+				s = end;
+			}
+
+			if (last >= MAX_CPUS)
+				return FAILURE;
+
+			while (first <= last)
+				*cpus |= (uint64) 1 << first++;
+
+			if (*s == ',')
+				s++;
+			else if (*s && *s != '\n')
+				return FAILURE;
+		}
+
+		return *cpus ? SUCCESS : FAILURE;
+	}
+}
@@ -32,15 +32,15 @@ namespace uStreamLib {
 	DataBuf::DataBuf(void)
 		: Object(UOSUTIL_RTTI_DATABUF), m_pbpParent(NULL), m_uBID(0),
 		m_strBlock(NULL), m_uSize(0), m_uCount(0), m_uLimit(65536),
-		m_bInUse(false), m_asStrategy(ALLOC_ONUSE)
+		m_bInUse(false), m_iRefCount(0), m_asStrategy(ALLOC_ONUSE),
+		m_bExternal(false)
 	{
 		// nothing to do
 	}
 
 	DataBuf::~DataBuf(void)
 	{
-		if (m_strBlock)
-			::free(m_strBlock);
+		_freeBlock();
 	}
 
 	int32 DataBuf::init(uint32 size, uint32 bid, uint32 limit,
@@ -60,8 +60,8 @@ namespace uStreamLib {
 			m_uSize = size;
 
 		// allocate memory only if alloc on create
-		if (strategy == ALLOC_ONCREATE) {
-			m_strBlock = (char *) malloc(m_uSize);
+		if (!(strategy & ALLOC_ONUSE)) {
+			m_strBlock = _allocBlock();
 			if (!m_strBlock)
 				return FAILURE;
 		} else {
@@ -101,7 +101,8 @@ namespace uStreamLib {
 			m_uSize = ((m_uSize >> 3) + 1) << 3;
 
 		// allocate memory
-		m_strBlock = (char *) malloc(m_uSize);
+		m_asStrategy = ALLOC_ONCREATE;
+		m_strBlock = _allocBlock();
 		if (!m_strBlock)
 			return FAILURE;
 
@@ -109,7 +110,6 @@ namespace uStreamLib {
 		m_uBID = 0;
 		m_uCount = uStrLen;
 		m_uLimit = m_uSize << 1;
-		m_asStrategy = ALLOC_ONCREATE;
 		m_bInUse = false;
 		m_pbpParent = NULL;
 
@@ -145,7 +145,7 @@ namespace uStreamLib {
 			return;
 
 		// allocate memory if strategy is alloc on use
-		if (m_asStrategy == ALLOC_ONUSE && !m_strBlock) {
+		if ((m_asStrategy & ALLOC_ONUSE) && !m_strBlock) {
 			// align memory size to 64 bit boundaries
 			if (size % 8)
 				m_uSize = ((size >> 3) + 1) << 3;
@@ -153,7 +153,7 @@ namespace uStreamLib {
 				m_uSize = size;
 
 			// allocate memory
-			m_strBlock = (char *) malloc(m_uSize);
+			m_strBlock = _allocBlock();
 			if (!m_strBlock)
 				return;
 		}
@@ -175,7 +175,7 @@ namespace uStreamLib {
 			return FAILURE;
 
 		// allocate memory if strategy is alloc on use
-		if (m_asStrategy == ALLOC_ONUSE && !m_strBlock) {
+		if ((m_asStrategy & ALLOC_ONUSE) && !m_strBlock) {
 			// align memory size to 64 bit boundaries
 			if (size % 8)
 				m_uSize = ((size >> 3) + 1) << 3;
@@ -183,13 +183,15 @@ namespace uStreamLib {
 				m_uSize = size;
 
 			// allocate memory
-			m_strBlock = (char *) malloc(m_uSize);
+			m_strBlock = _allocBlock();
 			if (!m_strBlock)
 				return FAILURE;
 		}
 
 		// perform reallocation if needed
 		if (m_uSize < size) {
+			uint32 uOldSize = m_uSize;
+
 			// align memory size to 64 bit boundaries
 			if (size % 8)
 				m_uSize = ((size >> 3) + 1) << 3;
@@ -197,7 +199,7 @@ namespace uStreamLib {
 				m_uSize = size;
 
 			// allocate memory
-			m_strBlock = (char *) ::realloc(m_strBlock, m_uSize);
+			m_strBlock = _reallocBlock(uOldSize);
 			if (!m_strBlock)
 				return FAILURE;
 		}
@@ -219,7 +221,7 @@ namespace uStreamLib {
 			return FAILURE;
 
 		// allocate memory if strategy is alloc on use
-		if (m_asStrategy == ALLOC_ONUSE && !m_strBlock) {
+		if ((m_asStrategy & ALLOC_ONUSE) && !m_strBlock) {
 			// align memory size to 64 bit boundaries
 			if (size % 8)
 				m_uSize = ((size >> 3) + 1) << 3;
@@ -227,7 +229,7 @@ namespace uStreamLib {
 				m_uSize = size;
 
 			// allocate memory
-			m_strBlock = (char *) malloc(m_uSize);
+			m_strBlock = _allocBlock();
 			if (!m_strBlock)
 				return FAILURE;
 		}
@@ -237,6 +239,8 @@ namespace uStreamLib {
 
 		// stretch buffer if necessary
 		if (m_uSize < uRequiredSize) {
+			uint32 uOldSize = m_uSize;
+
 			// align memory size to 64 bit boundaries
 			if (size % 8)
 				m_uSize = ((uRequiredSize >> 3) + 1) << 3;
@@ -244,7 +248,7 @@ namespace uStreamLib {
 				m_uSize = uRequiredSize;
 
 			// allocate memory
-			m_strBlock = (char *) ::realloc(m_strBlock, m_uSize);
+			m_strBlock = _reallocBlock(uOldSize);
 			if (!m_strBlock)
 				return FAILURE;
 		}
@@ -264,7 +268,7 @@ namespace uStreamLib {
 			return FAILURE;
 
 		// allocate memory if strategy is alloc on use
-		if (m_asStrategy == ALLOC_ONUSE && !m_strBlock) {
+		if ((m_asStrategy & ALLOC_ONUSE) && !m_strBlock) {
 			// align memory size to 64 bit boundaries
 			if (size % 8)
 				m_uSize = ((size >> 3) + 1) << 3;
@@ -272,7 +276,7 @@ namespace uStreamLib {
 				m_uSize = size;
 
 			// allocate memory
-			m_strBlock = (char *) ::malloc(m_uSize);
+			m_strBlock = _allocBlock();
 			if (!m_strBlock)
 				return FAILURE;
 		}
@@ -281,6 +285,8 @@ namespace uStreamLib {
 		if (size == m_uSize)
 			return SUCCESS;
 
+		uint32 uOldSize = m_uSize;
+
 		// align memory size to 64 bit boundaries
 		if (size % 8)
 			m_uSize = ((size >> 3) + 1) << 3;
@@ -288,7 +294,7 @@ namespace uStreamLib {
 			m_uSize = size;
 
 		// allocate memory
-		m_strBlock = (char *) ::realloc(m_strBlock, m_uSize);
+		m_strBlock = _reallocBlock(uOldSize);
 		if (!m_strBlock)
 			return FAILURE;
 
@@ -395,4 +401,84 @@ namespace uStreamLib {
 				printf("%02X ", m_strBlock[i]);
 		}
 	}
+
+	size_t DataBuf::_alignment(void)
+	{
+		if (m_asStrategy & ALLOC_ALIGN_PAGE)
+			return Memory::getPageSize();
+		if (m_asStrategy & ALLOC_ALIGN_CACHE)
+			return US_CACHE_LINE_SIZE;
+		return 0;
+	}
+
+	char* DataBuf::_allocBlock(void)
+	{
+		size_t align = _alignment();
+
+		// memory got here is always owned
+		m_bExternal = false;
+
+		if (align)
+			return (char *) Memory::alignedAlloc(m_uSize, align);
+		return (char *) ::malloc(m_uSize);
+	}
+
+	char* DataBuf::_reallocBlock(uint32 old_size)
+	{
+		char* block = NULL;
+
+		// plain heap memory can be resized in place
+		if (!m_bExternal && !_alignment())
+			return (char *) ::realloc(m_strBlock, m_uSize);
+
+		// external memory is never moved when shrinking
+		if (m_bExternal && m_uSize <= old_size)
+			return m_strBlock;
+
+		// allocate a new block and copy data
+		block = (char *) (_alignment() ?
+			Memory::alignedAlloc(m_uSize, _alignment()) :
+			::malloc(m_uSize));
+		if (!block)
+			return NULL;
+		if (m_strBlock)
+			Memory::memCopy(block, m_strBlock,
+				old_size < m_uSize ? old_size : m_uSize);
+
+		// free old block
+		_freeBlock();
+		return block;
+	}
+
+	void DataBuf::_freeBlock(void)
+	{
+		// external memory belongs to someone else
+		if (m_strBlock && !m_bExternal) {
+			if (_alignment())
+				Memory::alignedFree(m_strBlock);
+			else
+				::free(m_strBlock);
+		}
+
+		m_strBlock = NULL;
+		m_bExternal = false;
+	}
+
+	void DataBuf::_setExternal(char* block, uint32 size)
+	{
+		_freeBlock();
+		m_strBlock = block;
+		m_uSize = size;
+		m_bExternal = true;
+	}
+
+	void DataBuf::_releaseBlock(void)
+	{
+		if (m_bExternal)
+			return;
+
+		_freeBlock();
+		m_uSize = 0;
+		m_uCount = 0;
+	}
 }
@@ -0,0 +1,228 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "datachain.hpp"
+#include "bufferpool.hpp"
+#include "memory.hpp"
+
+namespace uStreamLib {
+	DataChain::DataChain(void)
+		: Object(UOSUTIL_RTTI_DATA_CHAIN), _segs(NULL), _bufs(NULL),
+		_owned(NULL), _maxsegs(0), _nsegs(0), _count(0), _cur(0),
+		_bp(NULL)
+	{
+		// nothing to do
+	}
+
+	DataChain::~DataChain(void)
+	{
+		if (_segs)
+			clear();
+
+		delete[] _segs;
+		delete[] _bufs;
+		delete[] _owned;
+	}
+
+	int32 DataChain::init(uint32 maxsegs, BufferPool* bp)
+	{
+		// do some checks
+		if (!maxsegs)
+			return FAILURE;
+
+		// create segments arrays
+		_segs = new dsegment[maxsegs];
+		if (!_segs)
+			return FAILURE;
+
+		_bufs = new DataBuf * [maxsegs];
+		if (!_bufs)
+			return FAILURE;
+
+		_owned = new bool[maxsegs];
+		if (!_owned)
+			return FAILURE;
+
+		// initialize members
+		_maxsegs = maxsegs;
+		_nsegs = 0;
+		_count = 0;
+		_cur = 0;
+		_bp = bp;
+
+		// ok
+		setOk(true);
+		return SUCCESS;
+	}
+
+	int32 DataChain::append(DataBuf* db, uint32 offset, uint32 size)
+	{
+		// check room and range
+		if (_nsegs >= _maxsegs || !size)
+			return FAILURE;
+		if (!db->getAddr() || offset + size > db->getSize())
+			return FAILURE;
+
+		// the chain holds its own reference on pool buffers
+		if (db->getBufferPool())
+			db->addRef();
+
+		_segs[_nsegs].addr = (char *) db->getAddr() + offset;
+		_segs[_nsegs].size = size;
+		_bufs[_nsegs] = db;
+		_owned[_nsegs] = false;
+
+		_nsegs++;
+		_count += size;
+
+		// ok
+		return SUCCESS;
+	}
+
+	int32 DataChain::write(char* data, uint32 size, bool wait)
+	{
+		DataBuf* db = NULL;
+		dsegment* s = NULL;
+		uint32 bid = 0, room = 0, n = 0;
+
+		while (size) {
+			// fill the last buffer taken from the pool
+			if (_nsegs && _owned[_nsegs - 1]) {
+				db = _bufs[_nsegs - 1];
+				s = &_segs[_nsegs - 1];
+
+				room = (uint32) ((char *) db->getAddr() + db->getSize() -
+					(s->addr + s->size));
+				if (room) {
+					n = size < room ? size : room;
+					Memory::memCopy(s->addr + s->size, data, n);
+
+					s->size += n;
+					db->setCount((uint32) (s->addr + s->size -
+						(char *) db->getAddr()));
+
+					_count += n;
+					data += n;
+					size -= n;
+					continue;
+				}
+			}
+
+			// then take a new buffer
+			if (!_bp || _nsegs >= _maxsegs)
+				return FAILURE;
+
+			if (wait)
+				bid = _bp->getBuffer();
+			else if (_bp->tryGetBuffer(&bid) == FAILURE)
+				return FAILURE;
+
+			// buffers may be allocated on use
+			db = _bp->use(bid);
+			if (!db->getSize() &&
+				db->realloc(_bp->getDefaultBufferSize()) == FAILURE) {
+				_bp->freeBuffer(bid);
+				return FAILURE;
+			}
+
+			_segs[_nsegs].addr = (char *) db->getAddr();
+			_segs[_nsegs].size = 0;
+			_bufs[_nsegs] = db;
+			_owned[_nsegs] = true;
+			_nsegs++;
+		}
+
+		// ok
+		return SUCCESS;
+	}
+
+	uint32 DataChain::read(uint32 offset, char* data, uint32 size)
+	{
+		uint32 i = 0, n = 0, done = 0;
+
+		for (i = 0; i < _nsegs && done < size; i++) {
+			// skip segments before offset
+			if (offset >= _segs[i].size) {
+				offset -= _segs[i].size;
+				continue;
+			}
+
+			n = _segs[i].size - offset;
+			if (n > size - done)
+				n = size - done;
+
+			Memory::memCopy(&data[done], _segs[i].addr + offset, n);
+			done += n;
+			offset = 0;
+		}
+
+		return done;
+	}
+
+	void DataChain::consume(uint32 size)
+	{
+		uint32 i = 0;
+
+		while (size && _nsegs) {
+			// first segment partially consumed
+			if (size < _segs[0].size) {
+				_segs[0].addr += size;
+				_segs[0].size -= size;
+				_count -= size;
+				return;
+			}
+
+			// first segment consumed: release it
+			size -= _segs[0].size;
+			_count -= _segs[0].size;
+			_release(0);
+
+			for (i = 1; i < _nsegs; i++) {
+				_segs[i - 1] = _segs[i];
+				_bufs[i - 1] = _bufs[i];
+				_owned[i - 1] = _owned[i];
+			}
+
+			_nsegs--;
+			if (_cur)
+				_cur--;
+		}
+	}
+
+	void DataChain::clear(void)
+	{
+		for (uint32 i = 0; i < _nsegs; i++)
+			_release(i);
+
+		_nsegs = 0;
+		_count = 0;
+		_cur = 0;
+	}
+
+	void DataChain::_release(uint32 i)
+	{
+		BufferPool* bp = _bufs[i]->getBufferPool();
+
+		if (bp)
+			bp->freeBuffer(_bufs[i]->getBID());
+	}
+}
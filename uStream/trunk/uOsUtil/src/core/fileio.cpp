@@ -226,4 +226,10 @@ namespace uStreamLib {
 
 		return _impl->writeFile(&addr[offset], towrite);
 	}
+
+	int32 FileOutputStream::write(DataChain* chain)
+	{
+		return _impl->writeFileV(chain->getSegments(),
+			chain->getSegmentsCount());
+	}
 }
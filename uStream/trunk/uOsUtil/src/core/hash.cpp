@@ -38,34 +38,11 @@ namespace uStreamLib {
 
 	Hash::~Hash(void)
 	{
-		struct hash_elem_t* cur = NULL;
-		struct hash_elem_t* base = NULL;
-		struct hash_elem_t* next = NULL;
 		uint32 i = 0;
 
 		for (i = 0; i < _size; i++) {
-			// get a base slot
-			base = &(_hte[i]);
-			cur = base->next;
-
-			// scan its chain
-			while (cur) {
-				// store next element
-				next = cur->next;
-
-				// remove current element
-				if (!cur->empty)
-					_htefree(cur);
-
-				free(cur);
-				_bytes -= sizeof(struct hash_elem_t);
-
-				// update cursor
-				cur = next;
-			}
-
-			if (!base->empty)
-				_htefree(base);
+			if (_hte[i].dist)
+				_htefree(&_hte[i]);
 		}
 
 		if (_hte)
@@ -74,65 +51,86 @@ namespace uStreamLib {
 
 	int32 Hash::init(uint32 size)
 	{
-		uint32 i, chain_depth = 8;
+		uint32 slots = 8;
 		int32 ret = 0;
 
 		ret = _dbErrorString.init(16);
 		if (ret == FAILURE)
 			return FAILURE;
 
+		// round slots count to the next power of 2
+		while (slots < size)
+			slots <<= 1;
+
+		// all slots empty
 		_hte = (struct hash_elem_t *)
-			malloc(sizeof(struct hash_elem_t) * size);
+			calloc(slots, sizeof(struct hash_elem_t));
 		if (!_hte)
 			return FAILURE;
 
 		// DEBUG
-		UOSUTIL_DOUT(("Hash(): init(%u)\n", size));
+		UOSUTIL_DOUT(("Hash(): init(%u), %u slots\n", size, slots));
 
-		_size = size;
+		_size = slots;
 		_elem_count = 0;
 		_bytes = 0;
 
-		ret = _enKeys.init(size * chain_depth);
+		ret = _enKeys.init(slots);
 		if (ret == FAILURE)
 			return FAILURE;
 
-		ret = _enValues.init(size * chain_depth);
+		ret = _enValues.init(slots);
 		if (ret == FAILURE)
 			return FAILURE;
 
-		for (i = 0; i < _size; i++) {
-			_hte[i].empty = true;
-			_hte[i].key = NULL;
-			_hte[i].key_size = 0;
-			_hte[i].value = NULL;
-			_hte[i].pvalue = NULL;
-			_hte[i].value_size = 0;
-			_hte[i].next = NULL;
-			_hte[i].hit_count = 0;
-		}
-
 		setOk(true);
 		return SUCCESS;
 	}
 
 	uint32 Hash::hashCode(char* key, uint32 key_size, uint32 hash_size)
 	{
-		uint32 code = 0, g = 0;
-		char* ptr = key;
+		uint8* ptr = (uint8 *) key;
+		uint32 code = 0, k = 0, i = 0;
 
-		if (!hash_size)
-			return 0;
+		// MurmurHash3 (x86, 32 bit): four bytes at a time
+		for (i = 0; i + 4 <= key_size; i += 4) {
+			memcpy(&k, ptr + i, sizeof(uint32));
 
-		for (uint32 i = 0; i < key_size; i++, ptr++) {
-			code = (code << 4) + *ptr;
-			if ((g = code & 0xf0000000)) {
-				code ^= (g >> 24);
-				code ^= g;
-			}
+			k *= 0xcc9e2d51;
+			k = (k << 15) | (k >> 17);
+			k *= 0x1b873593;
+
+			code ^= k;
+			code = (code << 13) | (code >> 19);
+			code = code * 5 + 0xe6546b64;
 		}
 
-		return (code % hash_size);
+		// remaining bytes
+		k = 0;
+		switch (key_size & 3) {
+		case 3:
+			k ^= (uint32) ptr[i + 2] << 16;
+			/* fall through */
+		case 2:
+			k ^= (uint32) ptr[i + 1] << 8;
+			/* fall through */
+		case 1:
+			k ^= (uint32) ptr[i];
+			k *= 0xcc9e2d51;
+			k = (k << 15) | (k >> 17);
+			k *= 0x1b873593;
+			code ^= k;
+		}
+
+		// mix all the bits
+		code ^= key_size;
+		code ^= code >> 16;
+		code *= 0x85ebca6b;
+		code ^= code >> 13;
+		code *= 0xc2b2ae35;
+		code ^= code >> 16;
+
+		return hash_size ? code % hash_size : code;
 	}
 
 	int32 Hash::compare(char* a, char* b, uint32 a_b_size)
@@ -140,384 +138,291 @@ namespace uStreamLib {
 		return memcmp(a, b, a_b_size);
 	}
 
-	int32 Hash::put(char* key, uint32 keysz, char* val, uint32 valsz,
-		bool replace)
+	int32 Hash::_find(char* key, uint32 key_size, uint32 code)
 	{
-		struct hash_elem_t* cur = NULL;
-		struct hash_elem_t* pre = NULL;
-		uint32 code = 0, do_replace = 0;
-
-		/* compute hash code */
-		if (!_size)
-			return FAILURE;
-		code = hashCode(key, keysz, _size);
+		struct hash_elem_t* hte = NULL;
+		uint32 i = code & (_size - 1), dist = 1;
 
-		/* no collision detected */
-		if (_hte[code].empty) {
-			_hte[code].key = (char *) malloc(keysz);
-			if (!_hte[code].key)
-				return FAILURE;
+		for (;; dist++) {
+			hte = &_hte[i];
 
-			Memory::memCopy(_hte[code].key, key, keysz);
-			_hte[code].key_size = keysz;
-			_bytes += keysz;
+			// an empty slot or an entry closer to home ends the search
+			if (hte->dist < dist)
+				return -1;
 
-			_hte[code].value = (char *) malloc(valsz);
-			if (!_hte[code].value) {
-				free(_hte[code].key);
-				return FAILURE;
-			}
+			// compare keys only if hash codes match
+			if (hte->code == code && hte->key_size == key_size &&
+				!compare(hte->key, key, key_size))
+				return (int32) i;
 
-			Memory::memCopy(_hte[code].value, val, valsz);
-			_hte[code].value_size = valsz;
-			_hte[code].empty = false;
-			_elem_count++;
-			_bytes += valsz;
-
-			return SUCCESS;
+			i = (i + 1) & (_size - 1);
 		}
+	}
 
-		/* collision detected */
-		cur = &_hte[code];
-
-		/* get statistics on collisions */
-		if (!replace)
-			cur->hit_count += 1;
-
-		/* chain scanning */
-		while (!cur->empty) {
-			/* check for key duplicates */
-			if (cur->key_size == keysz) {
-				if (!compare(cur->key, key, keysz)) {
-					if (replace) {
-						do_replace = 1; break;
-					} else
-						return KEY_EXISTS;
-				}
-			}
-
-			// DEBUG
-			UOSUTIL_DOUT(("Hash::put(%s [%u]): collision, code = %u, hit = %u\n",
-				key, keysz, code, cur->hit_count));
-
-			/* update pointers */
-			pre = cur;
-			cur = cur->next;
-
-			if (cur == NULL) {
-				cur = (struct hash_elem_t *)
-					malloc(sizeof(struct hash_elem_t));
-				if (!cur)
-					return FAILURE;
-
-				memset(cur, 0, sizeof(struct hash_elem_t));
-				_bytes += sizeof(struct hash_elem_t);
+	void Hash::_insert(struct hash_elem_t* hte)
+	{
+		struct hash_elem_t cur = *hte, tmp;
+		uint32 i = cur.code & (_size - 1);
 
-				cur->empty = true;
-				pre->next = cur;
+		for (cur.dist = 1;; cur.dist++) {
+			if (!_hte[i].dist) {
+				_hte[i] = cur;
+				return;
+			}
 
-				break;
+			// take the slot of an entry closer to its home
+			if (_hte[i].dist < cur.dist) {
+				tmp = _hte[i];
+				_hte[i] = cur;
+				cur = tmp;
 			}
+
+			i = (i + 1) & (_size - 1);
 		}
+	}
 
-		if (do_replace) {
-			if (valsz > cur->value_size) {
-				cur->value = (char *) realloc(cur->value, valsz);
-				if (!cur->value)
-					return FAILURE;
-			}
+	int32 Hash::_reserve(void)
+	{
+		struct hash_elem_t* old = _hte;
+		uint32 i = 0, size = _size;
 
-			_bytes += (valsz - cur->value_size);
+		// keep the table at most 3/4 full
+		if ((_elem_count + 1) * 4 <= _size * 3)
+			return SUCCESS;
 
-			Memory::memCopy(cur->value, val, valsz);
-			cur->value_size = valsz;
-		} else {
-			cur->key = (char *) malloc(keysz);
-			if (!cur->key)
-				return FAILURE;
+		_hte = (struct hash_elem_t *)
+			calloc(size * 2, sizeof(struct hash_elem_t));
+		if (!_hte) {
+			_hte = old;
+			return FAILURE;
+		}
 
-			Memory::memCopy(cur->key, key, keysz);
-			cur->key_size = keysz;
+		// DEBUG
+		UOSUTIL_DOUT(("Hash::_reserve(): %u -> %u slots\n", size, size * 2));
 
-			_bytes += keysz;
+		// move entries: hash codes are kept, keys are not hashed again
+		_size = size * 2;
+		for (i = 0; i < size; i++) {
+			if (old[i].dist)
+				_insert(&old[i]);
+		}
 
-			cur->value = (char *) malloc(valsz);
-			if (!cur->value) {
-				free(cur->key);
-				return FAILURE;
-			}
+		free(old);
+		return SUCCESS;
+	}
 
-			Memory::memCopy(cur->value, val, valsz);
-			cur->value_size = valsz;
+	int32 Hash::_store(struct hash_elem_t* hte, char* key, uint32 keysz,
+		char* val, uint32 valsz)
+	{
+		uint32 off = (keysz + 7) & ~7U;
+		char* block = NULL;
 
-			_bytes += valsz;
+		// key and copied value share a block, the value 64 bit aligned
+		block = (char *) malloc(val ? off + valsz : keysz);
+		if (!block)
+			return FAILURE;
 
-			cur->empty = false;
-			cur->next = NULL;
+		Memory::memCopy(block, key, keysz);
+		hte->key = block;
+		hte->key_size = keysz;
 
-			_elem_count++;
+		if (val) {
+			Memory::memCopy(block + off, val, valsz);
+			hte->value = block + off;
+			hte->value_size = valsz;
+		} else {
+			hte->value = NULL;
+			hte->value_size = 0;
 		}
 
+		_bytes += keysz + hte->value_size;
 		return SUCCESS;
 	}
 
-	int32 Hash::pput(char* key, uint32 keysz, char* val, bool replace)
+	int32 Hash::put(char* key, uint32 keysz, char* val, uint32 valsz,
+		bool replace)
 	{
-		struct hash_elem_t* cur = NULL;
-		struct hash_elem_t* pre = NULL;
-		uint32 code = 0, do_replace = 0;
+		struct hash_elem_t* hte = NULL;
+		struct hash_elem_t elem;
+		uint32 code = 0;
+		char* old = NULL;
+		int32 i = 0;
 
 		/* compute hash code */
 		if (!_size)
 			return FAILURE;
-		code = hashCode(key, keysz, _size);
+		code = hashCode(key, keysz, 0);
 
-		/* no collision detected */
-		if (_hte[code].empty) {
-			_hte[code].key = (char *) malloc(keysz);
-			if (!_hte[code].key)
-				return FAILURE;
+		/* check for key duplicates */
+		i = _find(key, keysz, code);
+		if (i >= 0) {
+			if (!replace)
+				return KEY_EXISTS;
+
+			hte = &_hte[i];
+
+			/* the new value fits in place */
+			if (hte->value && valsz <= hte->value_size) {
+				_bytes -= (hte->value_size - valsz);
+
+				memmove(hte->value, val, valsz);
+				hte->value_size = valsz;
 
-			Memory::memCopy(_hte[code].key, key, keysz);
-			_hte[code].key_size = keysz;
+				return SUCCESS;
+			}
 
-			_bytes += keysz;
+			/* move key and value to a larger block */
+			elem = *hte;
+			old = hte->key;
+
+			if (_store(&elem, hte->key, keysz, val, valsz) == FAILURE)
+				return FAILURE;
 
-			_hte[code].value = NULL;
-			_hte[code].value_size = 0;
-			_hte[code].pvalue = val;
-			_hte[code].empty = false;
+			_bytes -= (hte->key_size + hte->value_size);
+			*hte = elem;
+			free(old);
 
-			_elem_count++;
 			return SUCCESS;
 		}
 
-		/* collision detected */
-		cur = &(_hte[code]);
-
-		/* get statistics on collisions */
-		if (!replace)
-			cur->hit_count++;
-
-		/* chain scanning */
-		while (!cur->empty) {
-			/* check for key duplicates */
-			if (cur->key_size == keysz) {
-				if (!compare(cur->key, key, keysz)) {
-					if (replace) {
-						do_replace = 1; break;
-					} else
-						return KEY_EXISTS;
-				}
-			}
-
-			// DEBUG
-			UOSUTIL_DOUT(("Hash::pput(%s [%u]): collision, code = %u, hit = %u\n",
-				key, keysz, code, cur->hit_count));
+		/* add a new entry */
+		if (_reserve() == FAILURE)
+			return FAILURE;
 
-			/* update pointers */
-			pre = cur;
-			cur = cur->next;
+		memset(&elem, 0, sizeof(struct hash_elem_t));
+		elem.code = code;
 
-			if (cur == NULL) {
-				cur = (struct hash_elem_t *)
-					malloc(sizeof(struct hash_elem_t));
-				if (!cur)
-					return FAILURE;
+		if (_store(&elem, key, keysz, val, valsz) == FAILURE)
+			return FAILURE;
 
-				memset(cur, 0, sizeof(struct hash_elem_t));
-				_bytes += sizeof(struct hash_elem_t);
+		_insert(&elem);
+		_elem_count++;
 
-				cur->empty = true;
-				pre->next = cur;
+		return SUCCESS;
+	}
 
-				break;
-			}
-		}
+	int32 Hash::pput(char* key, uint32 keysz, char* val, bool replace)
+	{
+		struct hash_elem_t* hte = NULL;
+		struct hash_elem_t elem;
+		uint32 code = 0;
+		int32 i = 0;
 
-		if (do_replace) {
-			cur->pvalue = val;
-		} else {
-			cur->key = (char *) malloc(keysz);
-			if (!cur->key)
-				return FAILURE;
+		/* compute hash code */
+		if (!_size)
+			return FAILURE;
+		code = hashCode(key, keysz, 0);
 
-			Memory::memCopy(cur->key, key, keysz);
-			cur->key_size = keysz;
+		/* check for key duplicates */
+		i = _find(key, keysz, code);
+		if (i >= 0) {
+			if (!replace)
+				return KEY_EXISTS;
 
-			_bytes += keysz;
+			/* a copied value would hide the new pointer: drop it */
+			hte = &_hte[i];
+			_bytes -= hte->value_size;
 
-			cur->value = NULL;
-			cur->value_size = 0;
-			cur->pvalue = val;
-			cur->empty = false;
-			cur->next = NULL;
+			hte->value = NULL;
+			hte->value_size = 0;
+			hte->pvalue = val;
 
-			_elem_count++;
+			return SUCCESS;
 		}
 
+		/* add a new entry */
+		if (_reserve() == FAILURE)
+			return FAILURE;
+
+		memset(&elem, 0, sizeof(struct hash_elem_t));
+		elem.code = code;
+		elem.pvalue = val;
+
+		if (_store(&elem, key, keysz, NULL, 0) == FAILURE)
+			return FAILURE;
+
+		_insert(&elem);
+		_elem_count++;
+
 		return SUCCESS;
 	}
 
 	char* Hash::get(char* key, uint32 key_size)
 	{
-		struct hash_elem_t* cur = NULL;
-		uint32 code = 0, depth = 0;
+		int32 i = 0;
 
 		if (!_size)
 			return NULL;
-		code = hashCode(key, key_size, _size);
-
-		/* direct access */
-		if (_hte[code].key_size == key_size) {
-			if (!compare(_hte[code].key, key, key_size)) {
-				if (_hte[code].value)
-					return _hte[code].value;
-				else
-					return _hte[code].pvalue;
-			}
-		}
-
-		/* chain scanning */
-		cur = &(_hte[code]);
-
-		while (cur->next) {
-			cur = cur->next;
-
-			if (cur->key_size == key_size) {
-				if (!compare(cur->key, key, key_size)) {
-					if (cur->value) {
-						UOSUTIL_DOUT(("Hash::get(%s [%u]): depth = %u\n", key,
-							key_size, depth));
-						return cur->value;
-					} else {
-						UOSUTIL_DOUT(("Hash::get(%s [%u]): depth = %u\n", key,
-							key_size, depth));
-						return cur->pvalue;
-					}
-				}
-			}
 
-			depth += 1;
-		}
+		i = _find(key, key_size, hashCode(key, key_size, 0));
+		if (i < 0)
+			return NULL;
 
-		/* key not found */
-		return NULL;
+		if (_hte[i].value)
+			return _hte[i].value;
+		else
+			return _hte[i].pvalue;
 	}
 
 	char* Hash::get(char* key, uint32 key_size, uint32* valsz)
 	{
-		struct hash_elem_t* cur = NULL;
-		uint32 code = 0, depth = 0;
+		int32 i = 0;
 
+		*valsz = 0;
 		if (!_size)
 			return NULL;
-		code = hashCode(key, key_size, _size);
-
-		/* direct access */
-		if (_hte[code].key_size == key_size) {
-			if (!compare(_hte[code].key, key, key_size)) {
-				*valsz = _hte[code].value_size;
-				if (_hte[code].value)
-					return _hte[code].value;
-				else
-					return _hte[code].pvalue;
-			}
-		}
-
-		/* chain scanning */
-		cur = &(_hte[code]);
-
-		while (cur->next) {
-			cur = cur->next;
-
-			if (cur->key_size == key_size) {
-				if (!compare(cur->key, key, key_size)) {
-					*valsz = cur->value_size;
-
-					if (cur->value) {
-						UOSUTIL_DOUT(("Hash::get(%s [%u]): depth = %u\n", key,
-							key_size, depth));
-						return cur->value;
-					} else {
-						UOSUTIL_DOUT(("Hash::get(%s [%u]): depth = %u\n", key,
-							key_size, depth));
-						return cur->pvalue;
-					}
-				}
-			}
 
-			depth += 1;
-		}
+		i = _find(key, key_size, hashCode(key, key_size, 0));
+		if (i < 0)
+			return NULL;
 
-		/* key not found */
-		*valsz = 0;
-		return NULL;
+		*valsz = _hte[i].value_size;
+		if (_hte[i].value)
+			return _hte[i].value;
+		else
+			return _hte[i].pvalue;
 	}
 
 	int32 Hash::del(char* key, uint32 key_size)
 	{
-		struct hash_elem_t* cur = NULL;
-		struct hash_elem_t* base = NULL;
-		uint32 code = 0;
+		uint32 i = 0, next = 0;
+		int32 found = 0;
 
 		if (!_size)
 			return FAILURE;
-		code = hashCode(key, key_size, _size);
-
-		/* direct access */
-		if (_hte[code].key_size == key_size) {
-			if (!compare(_hte[code].key, key, key_size)) {
-				_htefree(&_hte[code]);
-				_elem_count--;
-				return SUCCESS;
-			}
-		}
 
-		/* chain scanning */
-		base = &(_hte[code]);
-		cur = base;
+		found = _find(key, key_size, hashCode(key, key_size, 0));
+		if (found < 0)
+			return FAILURE;
 
-		while (cur->next) {
-			cur = cur->next;
-			if (cur->key_size == key_size) {
-				if (!compare(cur->key, key, key_size)) {
-					_htefree(cur);
+		i = (uint32) found;
+		_htefree(&_hte[i]);
+		_elem_count--;
 
-					_elem_count -= 1;
-					base->hit_count -= 1;
+		/* shift back the following entries which are not at home */
+		for (;;) {
+			next = (i + 1) & (_size - 1);
+			if (_hte[next].dist <= 1)
+				break;
 
-					return SUCCESS;
-				}
-			}
+			_hte[i] = _hte[next];
+			_hte[i].dist--;
+			i = next;
 		}
 
-		/* key not found */
-		return FAILURE;
+		memset(&_hte[i], 0, sizeof(struct hash_elem_t));
+		return SUCCESS;
 	}
 
 	Enumeration* Hash::keys(void)
 	{
-		struct hash_elem_t* cur;
-		struct hash_elem_t* base;
 		uint32 i;
 
 		_enKeys.clear();
 
 		for (i = 0; i < _size; i++) {
-			base = &(_hte[i]);
-			cur = base;
-
-			if (!cur->empty) {
-				_enKeys.addElement(base->key, base->key_size);
-			}
-
-			while (cur->next != NULL) {
-				cur = cur->next;
-				if (!cur->empty) {
-					_enKeys.addElement(cur->key, cur->key_size);
-				}
-			}
+			if (_hte[i].dist)
+				_enKeys.addElement(_hte[i].key, _hte[i].key_size);
 		}
 
 		_enKeys.rewind();
@@ -528,32 +433,20 @@ namespace uStreamLib {
 
 	Enumeration* Hash::values(void)
 	{
-		struct hash_elem_t* cur;
-		struct hash_elem_t* base;
+		struct hash_elem_t* hte;
 		uint32 i;
 
 		_enValues.clear();
 
 		for (i = 0; i < _size; i++) {
-			base = &(_hte[i]);
-			cur = base;
-
-			if (!cur->empty) {
-				if (base->value)
-					_enValues.addElement(base->value, base->value_size);
-				else
-					_enValues.addElement(base->pvalue, base->value_size);
-			}
+			hte = &_hte[i];
+			if (!hte->dist)
+				continue;
 
-			while (cur->next != NULL) {
-				cur = cur->next;
-				if (!cur->empty) {
-					if (cur->value)
-						_enValues.addElement(cur->value, cur->value_size);
-					else
-						_enValues.addElement(cur->pvalue, cur->value_size);
-				}
-			}
+			if (hte->value)
+				_enValues.addElement(hte->value, hte->value_size);
+			else
+				_enValues.addElement(hte->pvalue, hte->value_size);
 		}
 
 		_enValues.rewind();
@@ -564,13 +457,14 @@ namespace uStreamLib {
 
 	void Hash::clear(void)
 	{
-		Enumeration* en = keys();
-		while (en->hasMoreElements()) {
-			char* key = (char*) en->nextElement();
-			UOSUTIL_DOUT(("Hash::clear(): deleting key = \"%s\"\n", key));
+		uint32 i;
 
-			del(key);
+		for (i = 0; i < _size; i++) {
+			if (_hte[i].dist)
+				_htefree(&_hte[i]);
 		}
+
+		_elem_count = 0;
 	}
 
 	void Hash::statistics(void)
@@ -579,8 +473,9 @@ namespace uStreamLib {
 
 		printf("Hash::statistics: TOTAL %u\n", _elem_count);
 		printf("Hash::statistics: TOTAL BYTES %u\n", _bytes);
+		printf("Hash::statistics: SLOTS %u\n", _size);
 		for (i = 0; i < _size; i++)
-			printf("%u %u\n", i, _hte[i].hit_count);
+			printf("%u %u\n", i, _hte[i].dist);
 	}
 
 	int32 Hash::loadKV(char* filename)
@@ -708,19 +603,12 @@ namespace uStreamLib {
 
 	void Hash::_htefree(struct hash_elem_t* hte)
 	{
-		if (hte->value)
-			free(hte->value);
+		// the copied value shares the block of the key
 		if (hte->key)
 			free(hte->key);
 
 		_bytes -= (hte->key_size + hte->value_size);
 
-		hte->key = NULL;
-		hte->value = NULL;
-		hte->pvalue = NULL;
-		hte->key_size = 0;
-		hte->value_size = 0;
-		hte->empty = true;
-		hte->hit_count = 0;
+		memset(hte, 0, sizeof(struct hash_elem_t));
 	}
 }
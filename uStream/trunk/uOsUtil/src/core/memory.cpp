@@ -28,6 +28,17 @@
 #include "memory.hpp"
 #include "timer.hpp"
 
+/*
+ * Here, we choose the right implementation using
+ * conditional compilation.
+ */
+
+#if defined(_WIN32) || defined(WIN32)
+#include "win32_memory.hpp"
+#else
+#include "linux_memory.hpp"
+#endif
+
 namespace uStreamLib {
 	void* sse_memcpy(void* to, const void* from, uint32 len);
 	void* mmx_memcpy(void* to, const void* from, uint32 len);
@@ -43,6 +54,46 @@ namespace uStreamLib {
 
 	char Memory::_bestFuncName[_MEMORY_FNAME_SIZE];
 
+	void* Memory::alignedAlloc(size_t size, size_t alignment)
+	{
+		return Impl_Memory::alignedAlloc(size, alignment);
+	}
+
+	void Memory::alignedFree(void* ptr)
+	{
+		Impl_Memory::alignedFree(ptr);
+	}
+
+	size_t Memory::getPageSize(void)
+	{
+		return Impl_Memory::getPageSize();
+	}
+
+	void* Memory::mapRegion(size_t* size, bool hugepages)
+	{
+		return Impl_Memory::mapRegion(size, hugepages);
+	}
+
+	void Memory::unmapRegion(void* ptr, size_t size)
+	{
+		Impl_Memory::unmapRegion(ptr, size);
+	}
+
+	int32 Memory::lockAll(void)
+	{
+		return Impl_Memory::lockAll();
+	}
+
+	void Memory::unlockAll(void)
+	{
+		Impl_Memory::unlockAll();
+	}
+
+	int32 Memory::bindToNode(void* ptr, size_t size, uint32 node)
+	{
+		return Impl_Memory::bindToNode(ptr, size, node);
+	}
+
 	void Memory::benchmark(uint32 block_size, uint32 i_count)
 	{
 		char* buffer1 = NULL, * buffer2 = NULL;
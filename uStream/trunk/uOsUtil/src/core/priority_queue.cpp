@@ -20,116 +20,118 @@
   
 */
 
-#include <stdio.h>
-#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "priority_queue.hpp"
 
 namespace uStreamLib {
+	/* index of the lowest bit set in v (v != 0) */
+	static uint32 _lowestBit(uint32 v)
+	{
+		static const uint32 debruijn[32] = { 0, 1, 28, 2, 29, 14, 24, 3, 30,
+			22, 20, 15, 25, 17, 4, 8, 31, 27, 13, 23, 21, 19, 16, 7, 26, 12,
+			18, 6, 11, 5, 10, 9 };
+
+		return debruijn[((v & (0 - v)) * 0x077CB531U) >> 27];
+	}
+
 	PriorityQueue::PriorityQueue(void)
-		: _pq(NULL), _priority_levels(0), _start(0), _drawing_rate(NULL),
-		_threshold(NULL), _items_drawn(NULL)
+		: _levels(NULL), _block(NULL), _slot_size(0), _priority_levels(0),
+		_bitmap(NULL), _summary(0), _cur(-1), _credit(0), _pwait(0), _ws(NULL),
+		_wsmask(0)
 	{
 		Queue::setClassID(UOSUTIL_RTTI_PRIORITY_QUEUE);
 	}
 
 	PriorityQueue::~PriorityQueue(void)
 	{
-		int32 i;
-
-		for (i = 0; i < _priority_levels; i++) {
-			if (_pq[i])
-				delete _pq[i];
-		}
-
-		if (_pq)
-			delete[] _pq;
-		if (_drawing_rate)
-			delete[] _drawing_rate;
-		if (_threshold)
-			delete[] _threshold;
-		if (_items_drawn)
-			delete[] _items_drawn;
+		if (_levels)
+			delete[] _levels;
+		if (_bitmap)
+			delete[] _bitmap;
+		if (_block)
+			free(_block);
 	}
 
-	/*
-	 * TODO: improve memory deallocation if malloc fails.
-	 */
 	int32 PriorityQueue::init(char* name, uint32 max_item_size,
 		int32 capacity, int32 priority_levels, int32 oob_capacity)
 	{
 		int32 ret = 0, i = 0, sqcap = 0;
-		char tmp[4096];
+		uint32 slots = 0, total = 0;
+		char* p = NULL;
+
+		if (priority_levels < 1 || priority_levels > MAX_LEVELS)
+			return FAILURE;
+
+		/* each level has 1/priority_levels of capacity */
+		sqcap = capacity / priority_levels;
+		if (sqcap < 1)
+			sqcap = 1;
+		if (oob_capacity < 1)
+			oob_capacity = 1;
 
 		/* initialize parent */
-		ret = Queue::init(name, max_item_size, capacity + oob_capacity);
+		ret = Queue::init(name, max_item_size,
+			sqcap * priority_levels + oob_capacity);
 		if (ret == FAILURE)
 			return FAILURE;
 
-		/* malloc queues array */
-		_pq = new SharedQueue * [priority_levels];
-		if (!_pq)
+		_levels = new level[priority_levels + 1];
+		if (!_levels)
 			return FAILURE;
 
-		/* compute queue aggregate capacity */
-		sqcap = (int32) ((double) capacity / (double) priority_levels);
+		_bitmap = new uint32[(priority_levels + 31) / 32];
+		if (!_bitmap)
+			return FAILURE;
 
-		/* create each queue (each capacity is 1/priority_levels of cap) */
-		for (i = 0; i < priority_levels; i++) {
-			snprintf(tmp, sizeof(tmp), "%s[%d]", getName(), i);
+		memset(_bitmap, 0, ((priority_levels + 31) / 32) * sizeof(uint32));
+		_summary = 0;
 
-			_pq[i] = new SharedQueue();
-			if (_pq[i]) {
-				ret = _pq[i]->init(tmp, max_item_size, sqcap);
-				if (ret == FAILURE) {
-					delete _pq[i]; _pq[i] = NULL; return FAILURE;
-				}
-			}
-		}
+		/* size the levels: rings of a power of 2 slots */
+		for (i = 0; i <= priority_levels; i++) {
+			_levels[i].capacity = (uint32) (i ? sqcap : oob_capacity);
 
-		/* create out of band queue */
-		snprintf(tmp, sizeof(tmp), "%s[OOB]", getName());
-		ret = _oobq.init(tmp, max_item_size, oob_capacity);
-		if (ret == FAILURE)
-			return FAILURE;
+			for (slots = 1; slots < _levels[i].capacity; slots <<= 1)
+				;
 
-		/* create fetch counters array */
-		_items_drawn = new int32[priority_levels];
-		if (!_items_drawn)
-			return FAILURE;
+			_levels[i].mask = slots - 1;
+			_levels[i].in = 0;
+			_levels[i].out = 0;
+			total += slots;
+		}
 
-		/* create fetch coefficents array */
-		_drawing_rate = new double[priority_levels];
-		if (!_drawing_rate)
-			return FAILURE;
+		/* all slots in a single block, 64 bit aligned */
+		_slot_size = ((sizeof(uint32) + max_item_size + 7) >> 3) << 3;
 
-		/* create thresholds array */
-		_threshold = new int32[priority_levels];
-		if (!_threshold)
+		_block = (char *) malloc(total * _slot_size);
+		if (!_block)
 			return FAILURE;
 
-		/* setup status */
+		for (i = 0, p = _block; i <= priority_levels; i++) {
+			_levels[i].slots = p;
+			p += (_levels[i].mask + 1) * _slot_size;
+		}
+
 		_priority_levels = priority_levels;
-		_start = 0;
+		_cur = -1;
+		_credit = 0;
 
 		/* compute drawing rates */
-		for (i = 0; i < priority_levels; i++) {
-			_drawing_rate[i] = .5 / ((double) i + 1.0);
-			_threshold[i] = (int32) (_drawing_rate[i] * (double) sqcap);
-			_items_drawn[i] = 0;
-		}
+		for (i = 0; i < priority_levels; i++)
+			setDrawingRate(i, .5 / ((double) i + 1.0));
 
 		/* setup semaphores */
 		ret = _sem_item_count.init(0);
 		if (ret == FAILURE)
 			return FAILURE;
 
-		ret = _sem_free_count.init(_capacity);
+		ret = _sem_space.init(0);
 		if (ret == FAILURE)
 			return FAILURE;
 
 		/* setup mutexes */
-		ret = _cmutex.init();
+		ret = _mutex.init();
 		if (ret == FAILURE)
 			return FAILURE;
 
@@ -138,136 +140,191 @@ namespace uStreamLib {
 		return SUCCESS;
 	}
 
-	int32 PriorityQueue::_get(bool blocking, char* item, uint32 size)
+	void PriorityQueue::_mark(int32 pri, bool full)
 	{
-		int32 ret = 0;
-		int32 i = 0, j = 0;
+		uint32 w = (uint32) pri >> 5;
 
-		// wait for semaphore or return
-		if (blocking)
-			_sem_item_count.wait();
-		else if (_sem_item_count.tryWait() == FAILURE)
-			return FAILURE;
-
-		// check out of band queue (and post semaphore if ok)
-		ret = _oobq.tryGet(item, size);
-		if (ret == SUCCESS) {
-			_sem_free_count.post(); return SUCCESS;
+		if (full) {
+			_bitmap[w] |= 1U << (pri & 31);
+			_summary |= 1U << w;
+		} else {
+			_bitmap[w] &= ~(1U << (pri & 31));
+			if (!_bitmap[w])
+				_summary &= ~(1U << w);
 		}
+	}
 
-		// lock consumer mutex
-		MutexLocker ml(&_cmutex);
-
-		// check other queues
-		j = _start;
-		i = 0;
-
-		do {
-			// check on queue with priority j
-			if (_pq && _pq[j]) {
-				ret = _pq[j]->tryGet(item, size);
-				if (ret == SUCCESS) {
-					// do anti starvation checking
-					_items_drawn[j] += 1;
-					if (_items_drawn[j] >= _threshold[j]) {
-						_start += 1;
-						if (_start >= _priority_levels)
-							_start = 0;
-
-						_items_drawn[j] = 0;
-					}
-
-					// signal data fetched
-					_sem_free_count.post();
-
-					// return data found
-					return SUCCESS;
-				}
-
-				j += 1;
-				if (j >= _priority_levels)
-					j = 0;
-			}
-		} while (++i < _priority_levels);
+	int32 PriorityQueue::_next(int32 pri)
+	{
+		uint32 w = (uint32) pri >> 5, bits = 0;
+
+		if (pri >= _priority_levels)
+			return -1;
+
+		// the word of pri, from pri on
+		bits = _bitmap[w] & (0xffffffffU << (pri & 31));
+		if (bits)
+			return (int32) ((w << 5) + _lowestBit(bits));
 
-		return FAILURE;
+		// the next non-empty word
+		bits = w < 31 ? _summary & (0xffffffffU << (w + 1)) : 0;
+		if (!bits)
+			return -1;
+
+		w = _lowestBit(bits);
+		return (int32) ((w << 5) + _lowestBit(_bitmap[w]));
 	}
 
-	int32 PriorityQueue::put(char* item, uint32 size, int32 priority)
+	int32 PriorityQueue::_draw(void)
+	{
+		int32 pri = 0;
+
+		// go on with the current level until its quantum is spent
+		if (_credit && (_bitmap[_cur >> 5] & (1U << (_cur & 31))))
+			return _cur;
+
+		// then serve the next non-empty level, in turn
+		pri = _next(_cur + 1);
+		if (pri < 0)
+			pri = _next(0);
+
+		_cur = pri;
+		_credit = _levels[pri + 1].quantum;
+		return pri;
+	}
+
+	int32 PriorityQueue::_get(int32 timeout, char* item, uint32 size)
 	{
-		if (priority > _priority_levels)
+		struct level* l = NULL;
+		uint32 isize = 0;
+		char* slot = NULL;
+		int32 pri = PRI_OOB;
+
+		// wait for semaphore or return
+		if (timeout < 0)
+			_sem_item_count.wait();
+		else if (!timeout && _sem_item_count.tryWait() == FAILURE)
+			return FAILURE;
+		else if (timeout > 0 &&
+			_sem_item_count.timedWait((uint32) timeout) == FAILURE)
 			return FAILURE;
 
-		_sem_free_count.wait();
+		MutexLocker ml(&_mutex);
 
-		if (priority <= PRI_OOB) {
-			_oobq.put(item, size);
-		} else {
-			if (_pq && _pq[priority]) {
-				_pq[priority]->put(item, size);
-			}
+		// out of band items first
+		l = _levels;
+		if (l->in == l->out) {
+			pri = _draw();
+			l = &_levels[pri + 1];
+			_credit--;
+		}
+
+		// copy item
+		slot = l->slots + (l->out & l->mask) * _slot_size;
+		isize = *((uint32 *) slot);
+		memcpy(item, slot + sizeof(uint32), size < isize ? size : isize);
+
+		l->out++;
+		if (pri != PRI_OOB && l->in == l->out)
+			_mark(pri, false);
+
+		// let the producers waiting for room try again
+		while (_pwait > 0) {
+			_pwait--;
+			_sem_space.post();
 		}
 
-		_sem_item_count.post();
 		return SUCCESS;
 	}
 
-	int32 PriorityQueue::tryPut(char* item, uint32 size, int32 priority)
+	int32 PriorityQueue::_put(char* item, uint32 size, int32 priority,
+		bool wait)
 	{
-		if (priority > _priority_levels)
-			return FAILURE;
+		struct level* l = _level(priority);
+		char* slot = NULL;
 
-		if (_sem_free_count.tryWait() == FAILURE)
+		if (!l)
 			return FAILURE;
 
-		if (priority <= PRI_OOB) {
-			_oobq.put(item, size);
-		} else {
-			if (_pq && _pq[priority]) {
-				int32 ret = _pq[priority]->tryPut(item, size);
-				if (ret == FAILURE)
-					return FAILURE;
+		_mutex.lock();
+
+		while (l->in - l->out >= l->capacity) {
+			if (!wait) {
+				_mutex.unlock(); return FAILURE;
 			}
+
+			_pwait++;
+			_mutex.unlock();
+			_sem_space.wait();
+			_mutex.lock();
 		}
 
+		// copy item
+		if (size > _item_size)
+			size = _item_size;
+
+		slot = l->slots + (l->in & l->mask) * _slot_size;
+		*((uint32 *) slot) = size;
+		memcpy(slot + sizeof(uint32), item, size);
+
+		if (l != _levels && l->in == l->out)
+			_mark(priority, true);
+		l->in++;
+
+		_mutex.unlock();
+
 		_sem_item_count.post();
+
+		if (_ws)
+			_ws->signal(_wsmask);
+
 		return SUCCESS;
 	}
 
+	int32 PriorityQueue::put(char* item, uint32 size, int32 priority)
+	{
+		return _put(item, size, priority, true);
+	}
+
+	int32 PriorityQueue::tryPut(char* item, uint32 size, int32 priority)
+	{
+		return _put(item, size, priority, false);
+	}
+
 	int32 PriorityQueue::getCountPerPriority(int32 priority)
 	{
-		if (priority >= 0 && priority < _priority_levels) {
-			if (_pq && _pq[priority]) {
-				return _pq[priority]->getCount();
-			}
-		}
+		struct level* l = _level(priority);
 
-		return FAILURE;
+		if (!l)
+			return FAILURE;
+
+		MutexLocker ml(&_mutex);
+		return (int32) (l->in - l->out);
 	}
 
 	int32 PriorityQueue::setDrawingRate(int32 pri, double rate)
 	{
-		if (pri >= 0 && pri < _priority_levels) {
-			if (_drawing_rate && _threshold) {
-				_drawing_rate[pri] = rate;
-				_threshold[pri] = (int32)
-					(_drawing_rate[pri] * (double) _capacity);
+		struct level* l = NULL;
 
-				return SUCCESS;
-			}
-		}
+		if (pri < 0 || !(l = _level(pri)))
+			return FAILURE;
 
-		return FAILURE;
+		// a level gives at least one item in a turn
+		l->rate = rate;
+		l->quantum = (uint32) (rate * (double) l->capacity);
+		if (!l->quantum)
+			l->quantum = 1;
+
+		return SUCCESS;
 	}
 
 	double PriorityQueue::getDrawingRate(int32 pri)
 	{
-		if (pri >= 0 && pri < _priority_levels) {
-			if (_drawing_rate) {
-				return _drawing_rate[pri];
-			}
-		}
+		struct level* l = NULL;
+
+		if (pri < 0 || !(l = _level(pri)))
+			return 0.0;
 
-		return 0.0;
+		return l->rate;
 	}
 }
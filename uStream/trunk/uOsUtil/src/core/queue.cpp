@@ -48,4 +48,24 @@ namespace uStreamLib {
 	{
 		// nothing to do
 	}
+
+	uint32 Queue::tryPutMany(char* items, uint32 size, uint32 n)
+	{
+		uint32 i = 0;
+
+		while (i < n && tryPut(items + i * size, size) == SUCCESS)
+			i++;
+
+		return i;
+	}
+
+	uint32 Queue::tryGetMany(char* items, uint32 size, uint32 n)
+	{
+		uint32 i = 0;
+
+		while (i < n && tryGet(items + i * size, size) == SUCCESS)
+			i++;
+
+		return i;
+	}
 }
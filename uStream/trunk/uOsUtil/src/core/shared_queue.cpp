@@ -24,6 +24,7 @@
 
 namespace uStreamLib {
 	SharedQueue::SharedQueue(void)
+		: _ws(NULL), _wsmask(0)
 	{
 		setClassID(UOSUTIL_RTTI_SHARED_QUEUE);
 	}
@@ -77,6 +78,9 @@ namespace uStreamLib {
 
 		_sem_item_count.post();
 
+		if (_ws)
+			_ws->signal(_wsmask);
+
 		return ret;
 	}
 
@@ -87,16 +91,16 @@ namespace uStreamLib {
 		if (_sem_free_count.tryWait() == FAILURE)
 			return FAILURE;
 
-		ret = _pmutex.tryLock();
-		if (ret == FAILURE) {
-			_sem_free_count.post(); return FAILURE;
-		}
-
+		// the slot is ours: the lock is only held to copy the item
+		_pmutex.lock();
 		ret = SimpleQueue::put(item, size);
 		_pmutex.unlock();
 
 		_sem_item_count.post();
 
+		if (_ws)
+			_ws->signal(_wsmask);
+
 		return ret;
 	}
 
@@ -122,11 +126,8 @@ namespace uStreamLib {
 		if (_sem_item_count.tryWait() == FAILURE)
 			return FAILURE;
 
-		ret = _cmutex.tryLock();
-		if (ret == FAILURE) {
-			_sem_item_count.post(); return FAILURE;
-		}
-
+		// the item is ours: the lock is only held to copy it
+		_cmutex.lock();
 		ret = SimpleQueue::get(item, size);
 		_cmutex.unlock();
 
@@ -139,4 +140,51 @@ namespace uStreamLib {
 	{
 		return _sem_item_count.getValue();
 	}
+
+	uint32 SharedQueue::tryPutMany(char* items, uint32 size, uint32 n)
+	{
+		uint32 count = 0, i = 0;
+
+		// reserve free slots
+		while (count < n && _sem_free_count.tryWait() == SUCCESS)
+			count++;
+
+		if (!count)
+			return 0;
+
+		_pmutex.lock();
+		for (i = 0; i < count; i++)
+			SimpleQueue::put(items + i * size, size);
+		_pmutex.unlock();
+
+		for (i = 0; i < count; i++)
+			_sem_item_count.post();
+
+		if (_ws)
+			_ws->signal(_wsmask);
+
+		return count;
+	}
+
+	uint32 SharedQueue::tryGetMany(char* items, uint32 size, uint32 n)
+	{
+		uint32 count = 0, i = 0;
+
+		// reserve items
+		while (count < n && _sem_item_count.tryWait() == SUCCESS)
+			count++;
+
+		if (!count)
+			return 0;
+
+		_cmutex.lock();
+		for (i = 0; i < count; i++)
+			SimpleQueue::get(items + i * size, size);
+		_cmutex.unlock();
+
+		for (i = 0; i < count; i++)
+			_sem_free_count.post();
+
+		return count;
+	}
 }
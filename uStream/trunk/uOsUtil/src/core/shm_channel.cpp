@@ -0,0 +1,394 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "shm_channel.hpp"
+#include "memory.hpp"
+
+namespace uStreamLib {
+	/*
+	 * Header at the start of the shared region. Ring indexes
+	 * written by different processes live on different cache lines.
+	 */
+	struct ShmHeader {
+		/* set last by the creator, when the channel is ready */
+		volatile int32 magic;
+
+		/* sizes */
+		uint32 bsize;
+		uint32 stride;
+		uint32 bcount;
+		uint32 meta_size;
+		uint32 entry_size;
+
+		/* offsets of rings and buffers from the region start */
+		uint32 dring_off;
+		uint32 fring_off;
+		uint32 bufs_off;
+
+		char pad0[US_CACHE_LINE_SIZE];
+
+		/* next descriptor to write (producer) */
+		volatile int32 dtail;
+		char pad1[US_CACHE_LINE_SIZE];
+
+		/* next descriptor to read (consumer) */
+		volatile int32 dhead;
+		char pad2[US_CACHE_LINE_SIZE];
+
+		/* next free buffer slot to write (consumer) */
+		volatile int32 ftail;
+		char pad3[US_CACHE_LINE_SIZE];
+
+		/* next free buffer slot to read (producer) */
+		volatile int32 fhead;
+		char pad4[US_CACHE_LINE_SIZE];
+
+		/* flags: the consumer / the producer sleeps */
+		volatile int32 dwait;
+		volatile int32 fwait;
+	};
+
+	/* "USMC" */
+	static const int32 _SHM_MAGIC = 0x55534d43;
+
+	/* round v up to a multiple of a (a power of 2) */
+	static uint32 _roundUp(uint32 v, uint32 a)
+	{
+		return (v + a - 1) & ~(a - 1);
+	}
+
+	ShmChannel::ShmChannel(void)
+		: Object(UOSUTIL_RTTI_SHM_CHANNEL), _hdr(NULL), _dring(NULL),
+		_fring(NULL), _bufs(NULL), _bsize(0), _bcount(0), _meta_size(0),
+		_entry_size(0), _spares(NULL), _nspares(0), _cwakeup(0),
+		_pwakeup(0)
+	{
+		_cb.setChannel(this);
+	}
+
+	ShmChannel::~ShmChannel(void)
+	{
+		delete[] _spares;
+	}
+
+	int32 ShmChannel::init(char* name, uint32 bsize, uint32 bcount,
+		uint32 meta_size, bool create)
+	{
+		char sname[256];
+		uint32 size = 0, i = 0;
+		int32 ret = 0;
+
+		if (create) {
+			// do some checks
+			if (!bsize || !bcount)
+				return FAILURE;
+
+			_bsize = _roundUp(bsize, 8);
+			_bcount = bcount;
+			_meta_size = meta_size;
+			_entry_size = _roundUp(2 * sizeof(uint32) + meta_size, 8);
+
+			// header, descriptor ring, free ring, page aligned buffers
+			ShmHeader h;
+			memset(&h, 0, sizeof(ShmHeader));
+			h.bsize = _bsize;
+			h.stride = _roundUp(_bsize, US_CACHE_LINE_SIZE);
+			h.bcount = _bcount;
+			h.meta_size = _meta_size;
+			h.entry_size = _entry_size;
+			h.dring_off = _roundUp(sizeof(ShmHeader), US_CACHE_LINE_SIZE);
+			h.fring_off = _roundUp(h.dring_off + _bcount * _entry_size,
+				US_CACHE_LINE_SIZE);
+			h.bufs_off = _roundUp(h.fring_off + _bcount * sizeof(uint32),
+				(uint32) Memory::getPageSize());
+			size = h.bufs_off + h.stride * _bcount;
+
+			ret = _shm.init(name, size, true);
+			if (ret == FAILURE)
+				return FAILURE;
+
+			_hdr = (ShmHeader *) _shm.getAddr();
+			memcpy(_hdr, &h, sizeof(ShmHeader));
+
+			// every buffer is free
+			_fring = (uint32 *) ((char *) _hdr + _hdr->fring_off);
+			for (i = 0; i < _bcount; i++)
+				_fring[i] = i;
+			_hdr->ftail = (int32) _bcount;
+		} else {
+			ret = _shm.init(name, 0, false);
+			if (ret == FAILURE)
+				return FAILURE;
+
+			// the creator may not have finished yet
+			_hdr = (ShmHeader *) _shm.getAddr();
+			if (_shm.getSize() < sizeof(ShmHeader) ||
+				Atomic::load(&_hdr->magic) != _SHM_MAGIC)
+				return FAILURE;
+
+			_bsize = _hdr->bsize;
+			_bcount = _hdr->bcount;
+			_meta_size = _hdr->meta_size;
+			_entry_size = _hdr->entry_size;
+
+			if (_shm.getSize() < _hdr->bufs_off + _hdr->stride * _bcount)
+				return FAILURE;
+		}
+
+		_dring = (char *) _hdr + _hdr->dring_off;
+		_fring = (uint32 *) ((char *) _hdr + _hdr->fring_off);
+		_bufs = (char *) _hdr + _hdr->bufs_off;
+
+		// room for every buffer
+		_spares = new uint32[_bcount];
+		if (!_spares)
+			return FAILURE;
+
+		// initialize semaphores
+		snprintf(sname, sizeof(sname), "%s.data", name);
+		ret = _semData.init(sname, 0, create);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		snprintf(sname, sizeof(sname), "%s.free", name);
+		ret = _semFree.init(sname, 0, create);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		// initialize mutex for releases
+		ret = _mutexRelease.init();
+		if (ret == FAILURE)
+			return FAILURE;
+
+		// initialize the view of the buffers
+		ret = _view.initView(name, _bufs, _hdr->stride, _bsize, _bcount,
+			&_cb);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		// the channel can be opened now
+		if (create)
+			Atomic::store(&_hdr->magic, _SHM_MAGIC);
+
+		// ok
+		setOk(true);
+		return SUCCESS;
+	}
+
+	DataBuf* ShmChannel::acquire(bool wait)
+	{
+		uint32 bid = 0;
+
+		// aborted buffers first
+		if (_nspares)
+			return _view.claimBuffer(_spares[--_nspares]);
+
+		for (;;) {
+			if (_popFree(&bid))
+				return _view.claimBuffer(bid);
+
+			if (!wait)
+				return NULL;
+
+			// announce we are going to sleep, then check again
+			Atomic::store(&_hdr->fwait, 1);
+			Atomic::barrier();
+
+			if (_popFree(&bid)) {
+				Atomic::compareAndSwap(&_hdr->fwait, 1, 0);
+				return _view.claimBuffer(bid);
+			}
+
+			if (Atomic::exchange(&_pwakeup, 0)) {
+				Atomic::compareAndSwap(&_hdr->fwait, 1, 0);
+				return NULL;
+			}
+
+			_semFree.wait();
+
+			if (Atomic::exchange(&_pwakeup, 0))
+				return NULL;
+		}
+	}
+
+	int32 ShmChannel::commit(DataBuf* buf, char* meta)
+	{
+		uint32 bid = buf->getBID();
+		uint32 tail = 0;
+		char* e = NULL;
+
+		if (_view.use(bid) != buf)
+			return FAILURE;
+
+		// data outside the region cannot be seen by the consumer
+		if (!_view.isInRegion(bid) || buf->getCount() > _bsize) {
+			abort(buf);
+			return FAILURE;
+		}
+
+		// fill the descriptor
+		tail = (uint32) _hdr->dtail;
+		e = _entry(tail);
+		((uint32 *) e)[0] = bid;
+		((uint32 *) e)[1] = buf->getCount();
+		if (_meta_size) {
+			if (meta)
+				memcpy(e + 2 * sizeof(uint32), meta, _meta_size);
+			else
+				memset(e + 2 * sizeof(uint32), 0, _meta_size);
+		}
+
+		// the buffer belongs to the consumer from now on
+		buf->setInUse(false);
+
+		// publish the descriptor
+		Atomic::store(&_hdr->dtail, (int32) (tail + 1));
+
+		// wake up the consumer if it is sleeping
+		Atomic::barrier();
+		if (Atomic::load(&_hdr->dwait) &&
+			Atomic::compareAndSwap(&_hdr->dwait, 1, 0))
+			_semData.post();
+
+		// ok
+		return SUCCESS;
+	}
+
+	void ShmChannel::abort(DataBuf* buf)
+	{
+		if (_view.use(buf->getBID()) != buf || _nspares >= _bcount)
+			return;
+
+		buf->setInUse(false);
+		_spares[_nspares++] = buf->getBID();
+	}
+
+	DataBuf* ShmChannel::receive(char* meta, bool wait)
+	{
+		uint32 bid = 0, count = 0;
+		DataBuf* db = NULL;
+
+		for (;;) {
+			if (_popEntry(&bid, &count, meta))
+				break;
+
+			if (!wait)
+				return NULL;
+
+			// announce we are going to sleep, then check again
+			Atomic::store(&_hdr->dwait, 1);
+			Atomic::barrier();
+
+			if (_popEntry(&bid, &count, meta)) {
+				Atomic::compareAndSwap(&_hdr->dwait, 1, 0);
+				break;
+			}
+
+			if (Atomic::exchange(&_cwakeup, 0)) {
+				Atomic::compareAndSwap(&_hdr->dwait, 1, 0);
+				return NULL;
+			}
+
+			_semData.wait();
+
+			if (Atomic::exchange(&_cwakeup, 0))
+				return NULL;
+		}
+
+		db = _view.claimBuffer(bid);
+		if (db)
+			db->setCount(count);
+
+		return db;
+	}
+
+	void ShmChannel::release(uint32 bid)
+	{
+		uint32 tail = 0;
+
+		if (bid >= _bcount)
+			return;
+
+		_mutexRelease.lock();
+
+		tail = (uint32) _hdr->ftail;
+		_fring[tail % _bcount] = bid;
+		Atomic::store(&_hdr->ftail, (int32) (tail + 1));
+
+		_mutexRelease.unlock();
+
+		// wake up the producer if it is sleeping
+		Atomic::barrier();
+		if (Atomic::load(&_hdr->fwait) &&
+			Atomic::compareAndSwap(&_hdr->fwait, 1, 0))
+			_semFree.post();
+	}
+
+	void ShmChannel::wakeConsumer(void)
+	{
+		Atomic::store(&_cwakeup, 1);
+		_semData.post();
+	}
+
+	void ShmChannel::wakeProducer(void)
+	{
+		Atomic::store(&_pwakeup, 1);
+		_semFree.post();
+	}
+
+	bool ShmChannel::_popFree(uint32* bid)
+	{
+		uint32 head = (uint32) _hdr->fhead;
+
+		if (head == (uint32) Atomic::load(&_hdr->ftail))
+			return false;
+
+		*bid = _fring[head % _bcount];
+		Atomic::store(&_hdr->fhead, (int32) (head + 1));
+
+		// a corrupted ring must not hand out foreign memory
+		return *bid < _bcount;
+	}
+
+	bool ShmChannel::_popEntry(uint32* bid, uint32* count, char* meta)
+	{
+		uint32 head = (uint32) _hdr->dhead;
+		char* e = NULL;
+
+		if (head == (uint32) Atomic::load(&_hdr->dtail))
+			return false;
+
+		e = _entry(head);
+		*bid = ((uint32 *) e)[0];
+		*count = ((uint32 *) e)[1];
+		if (*count > _bsize)
+			*count = _bsize;
+		if (meta && _meta_size)
+			memcpy(meta, e + 2 * sizeof(uint32), _meta_size);
+
+		Atomic::store(&_hdr->dhead, (int32) (head + 1));
+
+		return *bid < _bcount;
+	}
+}
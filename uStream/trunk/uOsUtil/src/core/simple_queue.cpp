@@ -25,72 +25,42 @@
 #include <stdlib.h>
 
 #include "simple_queue.hpp"
-#include "memory.hpp"
 
 namespace uStreamLib {
 	SimpleQueue::SimpleQueue()
-		: _item(NULL), _in(NULL), _out(NULL), _items_count(0), _free_count(0)
+		: _ring(NULL), _block(NULL), _mask(0), _slot_size(0), _in(0), _out(0)
 	{
 		// nothing to do here
 	}
 
-	/*
-	 * TODO: improve memory deallocation if malloc fails.
-	 */
 	int32 SimpleQueue::init(char* name, uint32 max_item_size, int32 capacity)
 	{
-		queue_item* cur = NULL;
-		queue_item* pre = NULL;
-		int32 i = 0, ret = 0;
+		uint32 slots = 1;
+		int32 ret = 0;
 
 		// initialize parent
 		ret = Queue::init(name, max_item_size, capacity);
 		if (ret == FAILURE)
 			return FAILURE;
 
-		// allocate memory for items
-		_item = (queue_item *) malloc(sizeof(queue_item));
-		if (!_item)
-			return FAILURE;
-
-		memset(_item, 0, sizeof(queue_item));
-
-		_item->prev = NULL;
-		_item->next = NULL;
-		_item->data = (char *) malloc(max_item_size);
-		if (!_item->data) {
-			free(_item); return FAILURE;
-		}
-		_item->size = max_item_size;
-
-		cur = _item;
-
-		for (i = 1; i < capacity; i++) {
-			cur->next = (queue_item *) malloc(sizeof(queue_item));
-			if (!cur->next) {
-				free(_item); return FAILURE;
-			}
-
-			pre = cur;
-			cur = cur->next;
-
-			cur->prev = pre;
-			cur->data = (char *) malloc(max_item_size);
-			if (!cur->data) {
-				free(_item); return FAILURE;
-			}
+		// round slots count to the next power of 2
+		while (slots < (uint32) capacity)
+			slots <<= 1;
 
-			memset(_item, 0, sizeof(max_item_size));
+		// each slot stores item size and item, 64 bit aligned
+		_slot_size = ((sizeof(uint32) + max_item_size + 7) >> 3) << 3;
+		_mask = slots - 1;
 
-			cur->size = max_item_size;
-			cur->next = NULL;
-		}
+		// allocate the ring on a cache line boundary
+		_block = (char *) malloc(slots * _slot_size + US_CACHE_LINE_SIZE);
+		if (!_block)
+			return FAILURE;
 
-		_in = _item;
-		_out = _item;
+		_ring = (char *) (((size_t) _block + US_CACHE_LINE_SIZE - 1) &
+			~((size_t) US_CACHE_LINE_SIZE - 1));
 
-		_items_count = 0;
-		_free_count = capacity;
+		_in = 0;
+		_out = 0;
 
 #ifdef UOSUTIL_QUEUE_DEBUG
 		fprintf(stderr, "SimpleQueue: %s (capacity=%d, max_item_size=%d)\n",
@@ -104,64 +74,51 @@ namespace uStreamLib {
 
 	int32 SimpleQueue::put(char* itm, uint32 size)
 	{
-		if (_free_count <= 0)
+		char* slot = NULL;
+
+		if (!_ring || _in - _out >= (uint32) _capacity)
 			return FAILURE;
-		if (!_in)
-			_in = _item;
 
 #ifdef UOSUTIL_QUEUE_DEBUG
-		if (_in)
-			fprintf(stderr, "%s:put(): [isz=%d,msz=%d,ic=%d/%d]\n", getName(),
-				size, _item_size, _items_count + 1, _items_count + _free_count);
+		fprintf(stderr, "%s:put(): [isz=%d,msz=%d,ic=%d/%d]\n", getName(),
+			size, _item_size, getCount() + 1, _capacity);
 #endif
 
-		_in->size = (size > _item_size) ? _item_size : size;
-		Memory::memCopy(_in->data, itm, _in->size);
-		_in = _in->next;
+		if (size > _item_size)
+			size = _item_size;
 
-		_items_count++;
-		_free_count--;
+		slot = _slot(_in);
+		*((uint32 *) slot) = size;
+		memcpy(slot + sizeof(uint32), itm, size);
+
+		_in++;
 		return SUCCESS;
 	}
 
 	int32 SimpleQueue::get(char* itm, uint32 size)
 	{
-		if (_items_count <= 0)
+		uint32 isize = 0;
+		char* slot = NULL;
+
+		if (_in == _out)
 			return FAILURE;
-		if (!_out)
-			_out = _item;
 
 #ifdef UOSUTIL_QUEUE_DEBUG
-		if (_out)
-			fprintf(stderr, "%s:get():  [isz=%d,msz=%d,ic=%d/%d]\n",
-				getName(), size, _item_size, _items_count - 1,
-				_items_count + _free_count);
+		fprintf(stderr, "%s:get():  [isz=%d,msz=%d,ic=%d/%d]\n",
+			getName(), size, _item_size, getCount() - 1, _capacity);
 #endif
 
-		Memory::memCopy(itm, _out->data,
-			(size < _out->size) ? size : _out->size);
-		_out = _out->next;
+		slot = _slot(_out);
+		isize = *((uint32 *) slot);
+		memcpy(itm, slot + sizeof(uint32), size < isize ? size : isize);
 
-		_items_count--;
-		_free_count++;
+		_out++;
 		return SUCCESS;
 	}
 
 	SimpleQueue::~SimpleQueue(void)
 	{
-		queue_item* cur;
-		queue_item* pre;
-
-		if (!_item)
-			return;
-
-		cur = _item;
-		while (cur) {
-			pre = cur;
-			cur = cur->next;
-
-			free(pre->data);
-			free(pre);
-		}
+		if (_block)
+			free(_block);
 	}
 }
@@ -0,0 +1,699 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "task_scheduler.hpp"
+#include "timer.hpp"
+
+namespace uStreamLib {
+	/*
+	 * Worker thread: runs tasks and owns a deque of runnable tasks.
+	 * The owner pushes and pops at the bottom, thieves take from
+	 * the top (Chase-Lev). A full deque overflows into the shared
+	 * queue of the scheduler.
+	 */
+
+	class TaskWorker : public Thread {
+	public:
+		TaskWorker(TaskScheduler* sched, uint32 index)
+			: _sched(sched), _index(index), _slot(0), _top(0), _bottom(0)
+		{
+			// nothing to do
+		}
+
+		virtual ~TaskWorker(void)
+		{
+			// nothing to do
+		}
+
+		void run(void)
+		{
+			Atomic::store(&_slot, (int32) Thread::getCurrentSlot());
+			_sched->_work(this);
+		}
+
+		int32 push(Task* t)
+		{
+			int32 b = _bottom;
+
+			if ((int32) ((uint32) b - (uint32) Atomic::load(&_top)) >=
+				_DEQUE_SIZE)
+				return FAILURE;
+
+			Atomic::storePtr(&_ring[b & (_DEQUE_SIZE - 1)], t);
+			Atomic::store(&_bottom, (int32) ((uint32) b + 1));
+
+			return SUCCESS;
+		}
+
+		Task* pop(void)
+		{
+			int32 b = (int32) ((uint32) _bottom - 1), top = 0;
+			Task* t = NULL;
+
+			Atomic::store(&_bottom, b);
+			Atomic::barrier();
+			top = Atomic::load(&_top);
+
+			// empty
+			if ((int32) ((uint32) b - (uint32) top) < 0) {
+				Atomic::store(&_bottom, (int32) ((uint32) b + 1));
+				return NULL;
+			}
+
+			t = (Task *) Atomic::loadPtr(&_ring[b & (_DEQUE_SIZE - 1)]);
+			if (b != top)
+				return t;
+
+			// last task: thieves may want it too
+			if (!Atomic::compareAndSwap(&_top, top, (int32) ((uint32) top + 1)))
+				t = NULL;
+
+			Atomic::store(&_bottom, (int32) ((uint32) b + 1));
+			return t;
+		}
+
+		Task* steal(void)
+		{
+			int32 top = Atomic::load(&_top), b = 0;
+			Task* t = NULL;
+
+			Atomic::barrier();
+			b = Atomic::load(&_bottom);
+
+			if ((int32) ((uint32) b - (uint32) top) <= 0)
+				return NULL;
+
+			t = (Task *) Atomic::loadPtr(&_ring[top & (_DEQUE_SIZE - 1)]);
+			if (!Atomic::compareAndSwap(&_top, top, (int32) ((uint32) top + 1)))
+				return NULL;
+
+			return t;
+		}
+
+		bool isEmpty(void)
+		{
+			return (int32) ((uint32) Atomic::load(&_bottom) -
+				(uint32) Atomic::load(&_top)) <= 0;
+		}
+
+		uint32 getIndex(void)
+		{
+			return _index;
+		}
+
+		uint32 getSlot(void)
+		{
+			return (uint32) Atomic::load(&_slot);
+		}
+	private:
+		enum { _DEQUE_SIZE = 256 };
+
+		TaskScheduler* _sched;
+		uint32 _index;
+		volatile int32 _slot;
+
+		volatile int32 _top;
+		volatile int32 _bottom;
+		void* volatile _ring[_DEQUE_SIZE];
+	};
+
+	/*
+	 * A loop run by parallelFor(): slices are taken by index, and
+	 * the loop is freed by the last of the caller and its helpers.
+	 */
+
+	class ParallelLoop {
+	public:
+		ParallelLoop(uint32 begin, uint32 end, uint32 grain, LoopBody* body,
+			int32 refs)
+			: _body(body), _next((int32) begin), _end(end), _grain(grain),
+			_left((int32) (end - begin)), _refs(refs)
+		{
+			// nothing to do
+		}
+
+		int32 init(void)
+		{
+			return _semDone.init(0);
+		}
+
+		/* run slices until none is left */
+		void work(void)
+		{
+			uint32 first = 0, last = 0;
+
+			for (;;) {
+				first = (uint32) Atomic::add(&_next, (int32) _grain) - _grain;
+				if (first >= _end)
+					break;
+
+				last = first + _grain < _end ? first + _grain : _end;
+				_body->run(first, last);
+
+				// the last slice done wakes up the caller
+				if (!Atomic::add(&_left, -(int32) (last - first)))
+					_semDone.post();
+			}
+		}
+
+		/* wait for the slices taken by the helpers */
+		void wait(void)
+		{
+			_semDone.wait();
+		}
+
+		void release(void)
+		{
+			if (!Atomic::decrement(&_refs))
+				delete this;
+		}
+	private:
+		LoopBody* _body;
+		volatile int32 _next;
+		uint32 _end;
+		uint32 _grain;
+		volatile int32 _left;
+		volatile int32 _refs;
+		Semaphore _semDone;
+	};
+
+	/*
+	 * A worker helping with a ParallelLoop.
+	 */
+
+	class ParallelTask : public Task {
+	public:
+		ParallelTask(ParallelLoop* loop)
+			: _loop(loop)
+		{
+			// nothing to do
+		}
+
+		int32 execute(void)
+		{
+			_loop->work();
+			return TASK_DONE;
+		}
+
+		void done(void)
+		{
+			_loop->release();
+			delete this;
+		}
+	private:
+		ParallelLoop* _loop;
+	};
+
+	/*
+	 * Task implementation.
+	 */
+
+	Task::Task(void)
+		: _sched(NULL), _state(_IDLE), _next(NULL), _tnext(NULL), _when(0),
+		_timed(false)
+	{
+		setClassID(UOSUTIL_RTTI_MACHINE_TASK);
+	}
+
+	Task::~Task(void)
+	{
+		// nothing to do
+	}
+
+	void Task::schedule(void)
+	{
+		int32 state = 0;
+
+		for (; ;) {
+			state = Atomic::load(&_state);
+			switch (state) {
+			case _IDLE:
+				if (Atomic::compareAndSwap(&_state, _IDLE, _QUEUED)) {
+					_sched->_push(this, false);
+					return;
+				}
+				break;
+			case _RUNNING:
+				// run once more when done
+				if (Atomic::compareAndSwap(&_state, _RUNNING, _NOTIFIED))
+					return;
+				break;
+			default:
+				// queued or notified already, or over
+				return;
+			}
+		}
+	}
+
+	/*
+	 * Scheduler implementation.
+	 */
+
+	TaskScheduler::TaskScheduler(void)
+		: Object(UOSUTIL_RTTI_MACHINE_TASK_SCHEDULER), _workers(NULL),
+		_count(0), _head(NULL), _tail(NULL), _queued(0), _timers(NULL),
+		_nextTimer(0), _idle(0), _stop(0)
+	{
+		// nothing to do
+	}
+
+	TaskScheduler::~TaskScheduler(void)
+	{
+		uint32 i = 0;
+
+		if (!_workers)
+			return;
+
+		// stop and wake up everybody
+		Atomic::store(&_stop, 1);
+		Atomic::barrier();
+		for (i = 0; i < _count; i++)
+			_wake();
+
+		// thread destructors wait for termination
+		for (i = 0; i < _count; i++) {
+			if (_workers[i])
+				delete _workers[i];
+		}
+
+		delete[] _workers;
+	}
+
+	int32 TaskScheduler::init(char* name, uint32 workers)
+	{
+		char tmp[256];
+		uint32 i = 0;
+		int32 ret = 0;
+
+		if (!workers)
+			workers = Thread::getProcessorsCount();
+
+		ret = _mutexQueue.init();
+		if (ret == FAILURE)
+			return FAILURE;
+
+		ret = _mutexTimers.init();
+		if (ret == FAILURE)
+			return FAILURE;
+
+		ret = _semIdle.init(0);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		_workers = new TaskWorker * [workers];
+		if (!_workers)
+			return FAILURE;
+
+		for (i = 0; i < workers; i++)
+			_workers[i] = NULL;
+
+		// create workers, then start them
+		for (i = 0; i < workers; i++) {
+			_workers[i] = new TaskWorker(this, i);
+			if (!_workers[i])
+				return FAILURE;
+
+			snprintf(tmp, sizeof(tmp), "%s[%u]", name, i);
+			ret = _workers[i]->init(tmp);
+			if (ret == FAILURE) {
+				delete _workers[i]; _workers[i] = NULL;
+				return FAILURE;
+			}
+
+			_count++;
+		}
+
+		for (i = 0; i < _count; i++)
+			_workers[i]->start();
+
+		// ok
+		setOk(true);
+		return SUCCESS;
+	}
+
+	int32 TaskScheduler::add(Task* t)
+	{
+		if (t->_sched)
+			return FAILURE;
+
+		t->_sched = this;
+		Atomic::store(&t->_state, Task::_IDLE);
+
+		return SUCCESS;
+	}
+
+	int32 TaskScheduler::parallelFor(uint32 begin, uint32 end, uint32 grain,
+		LoopBody* body, uint32 threads)
+	{
+		ParallelLoop* loop = NULL;
+		ParallelTask* t = NULL;
+		uint32 slices = 0, helpers = 0, max = 0, i = 0;
+
+		if (!body || end < begin || end - begin > 0x7fffffff)
+			return FAILURE;
+
+		if (end == begin)
+			return SUCCESS;
+
+		// a worker calling counts as one of the workers
+		max = _current() ? _count : _count + 1;
+		if (!threads || threads > max)
+			threads = max;
+
+		if (!grain)
+			grain = (end - begin + threads - 1) / threads;
+
+		// helpers beyond the slices would find nothing to do
+		slices = (end - begin + grain - 1) / grain;
+		helpers = threads - 1 < slices - 1 ? threads - 1 : slices - 1;
+
+		if (!helpers) {
+			body->run(begin, end);
+			return SUCCESS;
+		}
+
+		loop = new ParallelLoop(begin, end, grain, body, (int32) helpers + 1);
+		if (!loop || loop->init() == FAILURE) {
+			delete loop;
+			body->run(begin, end);
+			return SUCCESS;
+		}
+
+		for (i = 0; i < helpers; i++) {
+			t = new ParallelTask(loop);
+			add(t);
+			t->schedule();
+		}
+
+		// helpers starting late find the loop done
+		loop->work();
+		loop->wait();
+		loop->release();
+
+		return SUCCESS;
+	}
+
+	void TaskScheduler::scheduleAt(Task* t, uint64 when)
+	{
+		Task** p = NULL;
+
+		MutexLocker ml(&_mutexTimers);
+
+		// one time per task
+		if (t->_timed) {
+			for (p = &_timers; *p != t; p = &(*p)->_tnext)
+				;
+			*p = t->_tnext;
+		}
+
+		// keep the list sorted
+		for (p = &_timers; *p && (*p)->_when <= when; p = &(*p)->_tnext)
+			;
+
+		t->_when = when;
+		t->_tnext = *p;
+		t->_timed = true;
+		*p = t;
+
+		// sleeping workers may have to wake up earlier
+		if (_timers == t) {
+			Atomic::store64(&_nextTimer, when);
+			_wake();
+		}
+	}
+
+	void TaskScheduler::_push(Task* t, bool yield)
+	{
+		TaskWorker* w = NULL;
+
+		// workers keep what they make runnable, unless yielding
+		if (!yield)
+			w = _current();
+
+		if (!w || w->push(t) == FAILURE)
+			_enqueue(t);
+
+		_wake();
+	}
+
+	TaskWorker* TaskScheduler::_current(void)
+	{
+		uint32 slot = Thread::getCurrentSlot(), i = 0;
+
+		for (i = 0; i < _count; i++) {
+			if (_workers[i]->getSlot() == slot)
+				return _workers[i];
+		}
+
+		return NULL;
+	}
+
+	void TaskScheduler::_enqueue(Task* t)
+	{
+		MutexLocker ml(&_mutexQueue);
+
+		t->_next = NULL;
+		if (_tail)
+			_tail->_next = t;
+		else
+			_head = t;
+		_tail = t;
+
+		Atomic::increment(&_queued);
+	}
+
+	Task* TaskScheduler::_dequeue(void)
+	{
+		Task* t = NULL;
+
+		// avoid the lock when empty
+		if (!Atomic::load(&_queued))
+			return NULL;
+
+		MutexLocker ml(&_mutexQueue);
+
+		t = _head;
+		if (!t)
+			return NULL;
+
+		_head = t->_next;
+		if (!_head)
+			_tail = NULL;
+
+		Atomic::decrement(&_queued);
+
+		return t;
+	}
+
+	Task* TaskScheduler::_take(TaskWorker* w, uint32 tick)
+	{
+		Task* t = NULL;
+		uint32 i = 0;
+
+		// now and then, the shared queue comes first
+		if (!(tick % _SHARED_PERIOD)) {
+			t = _dequeue();
+			if (t)
+				return t;
+		}
+
+		t = w->pop();
+		if (t)
+			return t;
+
+		t = _dequeue();
+		if (t)
+			return t;
+
+		// steal from the others, starting from the next worker
+		for (i = 1; i < _count; i++) {
+			t = _workers[(w->getIndex() + i) % _count]->steal();
+			if (t)
+				return t;
+		}
+
+		return NULL;
+	}
+
+	void TaskScheduler::_execute(Task* t)
+	{
+		int32 ret = 0;
+
+		Atomic::store(&t->_state, Task::_RUNNING);
+
+		ret = t->execute();
+		switch (ret) {
+		case Task::TASK_DONE:
+			_cancelTimer(t);
+			Atomic::store(&t->_state, Task::_DONE);
+
+			// the task may go away now
+			t->done();
+			break;
+		case Task::TASK_IDLE:
+			if (Atomic::compareAndSwap(&t->_state, Task::_RUNNING,
+				Task::_IDLE))
+				break;
+
+			// scheduled while running: run again
+			Atomic::store(&t->_state, Task::_QUEUED);
+			_push(t, false);
+			break;
+		default:
+			Atomic::store(&t->_state, Task::_QUEUED);
+			_push(t, true);
+		}
+	}
+
+	bool TaskScheduler::_hasWork(void)
+	{
+		uint64 next = Atomic::load64(&_nextTimer);
+		uint32 i = 0;
+
+		if (Atomic::load(&_stop) || Atomic::load(&_queued))
+			return true;
+
+		if (next && next <= Timer::getMonotonicTime())
+			return true;
+
+		for (i = 0; i < _count; i++) {
+			if (!_workers[i]->isEmpty())
+				return true;
+		}
+
+		return false;
+	}
+
+	void TaskScheduler::_fireTimers(void)
+	{
+		uint64 next = Atomic::load64(&_nextTimer), now = 0;
+		Task* t = NULL;
+
+		if (!next || next > (now = Timer::getMonotonicTime()))
+			return;
+
+		/*
+		 * Tasks are scheduled with the lock held: a task which
+		 * is over leaves the list under the same lock.
+		 */
+		MutexLocker ml(&_mutexTimers);
+
+		while (_timers && _timers->_when <= now) {
+			t = _timers;
+			_timers = t->_tnext;
+			t->_timed = false;
+			t->schedule();
+		}
+
+		Atomic::store64(&_nextTimer, _timers ? _timers->_when : 0);
+	}
+
+	void TaskScheduler::_cancelTimer(Task* t)
+	{
+		Task** p = NULL;
+
+		MutexLocker ml(&_mutexTimers);
+
+		if (!t->_timed)
+			return;
+
+		for (p = &_timers; *p != t; p = &(*p)->_tnext)
+			;
+		*p = t->_tnext;
+		t->_timed = false;
+
+		Atomic::store64(&_nextTimer, _timers ? _timers->_when : 0);
+	}
+
+	void TaskScheduler::_sleep(void)
+	{
+		uint64 next = 0, now = 0;
+		int32 idle = 0, ret = SUCCESS;
+
+		// announce we are going to sleep, then check again
+		Atomic::increment(&_idle);
+		Atomic::barrier();
+
+		if (!_hasWork()) {
+			next = Atomic::load64(&_nextTimer);
+			if (!next) {
+				_semIdle.wait();
+				return;
+			}
+
+			now = Timer::getMonotonicTime();
+			ret = _semIdle.timedWait((uint32) ((next - now + 999) / 1000));
+			if (ret == SUCCESS)
+				return;
+		}
+
+		// leave the idle count, unless somebody is waking us up
+		do {
+			idle = Atomic::load(&_idle);
+			if (idle <= 0) {
+				_semIdle.wait();
+				return;
+			}
+		} while (!Atomic::compareAndSwap(&_idle, idle, idle - 1));
+	}
+
+	void TaskScheduler::_wake(void)
+	{
+		int32 idle = 0;
+
+		Atomic::barrier();
+
+		// take a sleeper out of the idle count and post for it
+		do {
+			idle = Atomic::load(&_idle);
+			if (idle <= 0)
+				return;
+		} while (!Atomic::compareAndSwap(&_idle, idle, idle - 1));
+
+		_semIdle.post();
+	}
+
+	void TaskScheduler::_work(TaskWorker* w)
+	{
+		uint32 tick = 0, spins = 0;
+		Task* t = NULL;
+
+		while (!Atomic::load(&_stop)) {
+			_fireTimers();
+
+			t = _take(w, ++tick);
+			if (t) {
+				_execute(t);
+				spins = 0;
+				continue;
+			}
+
+			// look around for a while before sleeping
+			if (++spins < _SPINS) {
+				Atomic::pause();
+				continue;
+			}
+
+			_sleep();
+			spins = 0;
+		}
+	}
+}
@@ -39,7 +39,9 @@
 
 namespace uStreamLib {
 	Thread::Thread(void)
-		: Object(UOSUTIL_RTTI_THREAD), _bBypassRun(false), _bIsSelf(false)
+		: Object(UOSUTIL_RTTI_THREAD), _bBypassRun(false), _bIsSelf(false),
+		_bSpawned(false), _bRunning(false), _stackSize(0), _cpus(0),
+		_policy(POLICY_DEFAULT), _priority(0), _nice(0), _bNice(false)
 	{
 		_impl = new Impl_Thread();
 	}
@@ -51,7 +53,7 @@ namespace uStreamLib {
 		delete _impl;
 	}
 
-	int32 Thread::init(char* name)
+	int32 Thread::init(char* name, bool spawn)
 	{
 		int32 ret;
 
@@ -75,8 +77,19 @@ namespace uStreamLib {
 		_current = NULL;
 		_bIsSelf = false;
 
+		// the code may run somewhere else
+		if (!spawn)
+			return SUCCESS;
+
 		// invoke implementation
-		return _impl->init(this);
+		ret = _impl->init(this, _stackSize);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		_bSpawned = true;
+
+		// ok
+		return SUCCESS;
 	}
 
 	void Thread::sleep(int32 ms)
@@ -84,19 +97,72 @@ namespace uStreamLib {
 		Impl_Thread::sleep(ms);
 	}
 
+	void Thread::sleepUntil(uint64 us)
+	{
+		Impl_Thread::sleepUntil(us);
+	}
+
+	uint32 Thread::getCurrentSlot(void)
+	{
+		return Impl_Thread::getCurrentSlot();
+	}
+
+	uint32 Thread::getProcessorsCount(void)
+	{
+		return Impl_Thread::getProcessorsCount();
+	}
+
+	int32 Thread::setAffinity(uint64 cpus)
+	{
+		_cpus = cpus;
+
+		if (!_bRunning)
+			return SUCCESS;
+
+		return _impl->setAffinity(cpus);
+	}
+
+	int32 Thread::setScheduling(int32 policy, int32 priority)
+	{
+		if (policy < POLICY_DEFAULT || policy > POLICY_RR)
+			return FAILURE;
+
+		_policy = policy;
+		_priority = priority;
+
+		if (!_bRunning)
+			return SUCCESS;
+
+		return _impl->setScheduling(policy, priority);
+	}
+
+	int32 Thread::setNice(int32 nice)
+	{
+		_nice = nice;
+		_bNice = true;
+
+		if (!_bRunning)
+			return SUCCESS;
+
+		return _impl->setNice(nice);
+	}
+
 	void Thread::detach(void)
 	{
-		_impl->detach();
+		if (_bSpawned)
+			_impl->detach();
 	}
 
 	void Thread::join(void** ret_data)
 	{
-		_impl->join(ret_data);
+		if (_bSpawned)
+			_impl->join(ret_data);
 	}
 
 	void Thread::cancel(void)
 	{
-		_impl->cancel();
+		if (_bSpawned)
+			_impl->cancel();
 	}
 
 	void Thread::run(void)
@@ -112,6 +178,10 @@ namespace uStreamLib {
 		// wait for start signal
 		waitForStart();
 
+		// configure this thread
+		_applySettings();
+		prepare();
+
 		// DEBUG
 		UOSUTIL_DOUT(("%s: Executing run ? %d\n", getName(), getBypassRun()));
 
@@ -129,5 +199,25 @@ namespace uStreamLib {
 		UOSUTIL_DOUT(("%s: exiting\n", getName()));
 	}
 	
+	int32 Thread::_applySettings(void)
+	{
+		int32 ret = SUCCESS;
+
+		_impl->started();
+		_bRunning = true;
+
+		if (_cpus && _impl->setAffinity(_cpus) == FAILURE)
+			ret = FAILURE;
+
+		if (_policy != POLICY_DEFAULT &&
+			_impl->setScheduling(_policy, _priority) == FAILURE)
+			ret = FAILURE;
+
+		if (_bNice && _impl->setNice(_nice) == FAILURE)
+			ret = FAILURE;
+
+		return ret;
+	}
+
 	Thread *Thread::_current = NULL;
 }
@@ -0,0 +1,102 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "waitset.hpp"
+
+namespace uStreamLib {
+	WaitSet::WaitSet(void)
+		: Object(UOSUTIL_RTTI_WAITSET), _ready(0), _waiting(0),
+		_cb(NULL)
+	{
+		// nothing to do
+	}
+
+	WaitSet::~WaitSet(void)
+	{
+		// nothing to do
+	}
+
+	int32 WaitSet::init(void)
+	{
+		int32 ret = 0;
+
+		ret = _sem.init(0);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		// ok
+		setOk(true);
+		return SUCCESS;
+	}
+
+	void WaitSet::signal(uint32 mask)
+	{
+		int32 old = 0;
+
+		// set the bits unless they are set already
+		do {
+			old = Atomic::load(&_ready);
+			if (((uint32) old & mask) == mask)
+				return;
+		} while (!Atomic::compareAndSwap(&_ready, old,
+			(int32) ((uint32) old | mask)));
+
+		if (_cb)
+			_cb->perform(this);
+
+		// wake up the waiter if it is sleeping
+		Atomic::barrier();
+		if (Atomic::load(&_waiting) && Atomic::exchange(&_waiting, 0))
+			_sem.post();
+	}
+
+	uint32 WaitSet::wait(int32 timeout)
+	{
+		uint32 bits = 0;
+		int32 ret = SUCCESS;
+
+		bits = (uint32) Atomic::exchange(&_ready, 0);
+		if (bits || !timeout)
+			return bits;
+
+		// announce we are going to sleep, then check again
+		Atomic::store(&_waiting, 1);
+		Atomic::barrier();
+
+		bits = (uint32) Atomic::exchange(&_ready, 0);
+		if (!bits) {
+			if (timeout < 0)
+				_sem.wait();
+			else
+				ret = _sem.timedWait((uint32) timeout);
+
+			if (ret == SUCCESS)
+				return (uint32) Atomic::exchange(&_ready, 0);
+		}
+
+		// a signal may have posted the semaphore anyway: take it back
+		if (!Atomic::exchange(&_waiting, 0))
+			_sem.wait();
+
+		return bits | (uint32) Atomic::exchange(&_ready, 0);
+	}
+}
@@ -0,0 +1,180 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "linux_cpu_topology.hpp"
+
+/* where the kernel describes processors */
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+namespace uStreamLib {
+	/*
+	 * Read the first line of a sysfs file.
+	 */
+
+	static bool read_line(char* path, char* line, uint32 size)
+	{
+		FILE* f = fopen(path, "r");
+		bool ok = false;
+
+		if (!f)
+			return false;
+
+		ok = fgets(line, size, f) != NULL;
+		fclose(f);
+
+		return ok;
+	}
+
+	/*
+	 * Read a number from a sysfs file.
+	 */
+
+	static bool read_number(char* path, uint32* value)
+	{
+		char line[64];
+
+		if (!read_line(path, line, sizeof(line)))
+			return false;
+
+		*value = (uint32) strtoul(line, NULL, 10);
+		return true;
+	}
+
+	/*
+	 * Find the NUMA node of a processor (a "nodeN" entry).
+	 */
+
+	static uint32 read_node(uint32 cpu)
+	{
+		char path[256];
+		struct dirent* de = NULL;
+		uint32 node = 0;
+		DIR* d = NULL;
+
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%u", cpu);
+
+		d = opendir(path);
+		if (!d)
+			return 0;
+
+		while ((de = readdir(d)) != NULL) {
+			if (!strncmp(de->d_name, "node", 4) &&
+				de->d_name[4] >= '0' && de->d_name[4] <= '9') {
+				node = (uint32) strtoul(de->d_name + 4, NULL, 10);
+				break;
+			}
+		}
+
+		closedir(d);
+		return node;
+	}
+
+	/*
+	 * Read the caches of a processor: each one is identified by
+	 * the lowest processor in its shared_cpu_list.
+	 */
+
+	static void read_caches(CpuTopology::CpuInfo* c)
+	{
+		char path[256], line[1024];
+		uint32 i = 0, level = 0, first = 0;
+
+		c->l2 = c->cpu;
+		c->l3 = (uint32) -1;
+
+		for (i = 0; ; i++) {
+			snprintf(path, sizeof(path),
+				SYSFS_CPU "/cpu%u/cache/index%u/level", c->cpu, i);
+			if (!read_number(path, &level))
+				break;
+
+			snprintf(path, sizeof(path),
+				SYSFS_CPU "/cpu%u/cache/index%u/shared_cpu_list", c->cpu, i);
+			if (!read_line(path, line, sizeof(line)))
+				continue;
+
+			first = (uint32) strtoul(line, NULL, 10);
+
+			if (level == 2)
+				c->l2 = first;
+			else if (level == 3)
+				c->l3 = first;
+		}
+
+		// no L3: the L2 is the last level
+		if (c->l3 == (uint32) -1)
+			c->l3 = c->l2;
+	}
+
+	uint32 Impl_CpuTopology::read(CpuTopology::CpuInfo* cpus, uint32 max)
+	{
+		char line[1024], path[256];
+		uint32 first = 0, last = 0, count = 0;
+		char* s = line, * end = NULL;
+
+		if (!read_line(SYSFS_CPU "/online", line, sizeof(line)))
+			return 0;
+
+		// walk the list of online processors, like "0-3,6"
+		while (*s && *s != '\n' && count < max) {
+			first = last = (uint32) strtoul(s, &end, 10);
+			if (end == s)
+				break;
+			s = end;
+
+			if (*s == '-') {
+				last = (uint32) strtoul(++s, &end, 10);
+				s = end;
+			}
+
+			for (; first <= last && first < max && count < max; first++) {
+				CpuTopology::CpuInfo* c = &cpus[count++];
+
+				c->cpu = first;
+
+				snprintf(path, sizeof(path),
+					SYSFS_CPU "/cpu%u/topology/core_id", first);
+				if (!read_number(path, &c->core))
+					c->core = first;
+
+				snprintf(path, sizeof(path),
+					SYSFS_CPU "/cpu%u/topology/physical_package_id", first);
+				if (!read_number(path, &c->package))
+					c->package = 0;
+
+				c->node = read_node(first);
+
+				read_caches(c);
+			}
+
+			if (*s == ',')
+				s++;
+		}
+
+		return count;
+	}
+}
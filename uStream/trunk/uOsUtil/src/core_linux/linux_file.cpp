@@ -25,6 +25,7 @@
 #include <sys/time.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #include <errno.h>
 
 #include "linux_file.hpp"
@@ -93,6 +94,42 @@ namespace uStreamLib {
 		return ::write(_fd, data, size);
 	}
 
+	int32 Impl_File::writeFileV(dsegment* segs, uint32 count)
+	{
+		struct iovec iov[_IOV_CHUNK];
+		ssize_t ret = 0, size = 0;
+		int32 total = 0;
+		uint32 i = 0, n = 0;
+
+		if (_fd < 0)
+			return FAILURE;
+
+		// write up to _IOV_CHUNK segments at time
+		while (count) {
+			n = count < (uint32) _IOV_CHUNK ? count : (uint32) _IOV_CHUNK;
+			for (i = 0, size = 0; i < n; i++) {
+				iov[i].iov_base = segs[i].addr;
+				iov[i].iov_len = segs[i].size;
+				size += segs[i].size;
+			}
+
+			ret = ::writev(_fd, iov, n);
+			if (ret < 0)
+				return total ? total : (int32) FAILURE;
+
+			total += (int32) ret;
+
+			// stop on a short write
+			if (ret < size)
+				break;
+
+			segs += n;
+			count -= n;
+		}
+
+		return total;
+	}
+
 	int32 Impl_File::seek(int32 offset, int32 origin)
 	{
 		switch (origin) {
@@ -0,0 +1,139 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "linux_memory.hpp"
+
+/* size of a huge page (x86) */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/* from numaif.h (libnuma is not needed for a system call) */
+#define NUMA_MPOL_PREFERRED	1
+#define NUMA_MPOL_MF_MOVE	(1 << 1)
+#define NUMA_MAX_NODES		1024
+
+namespace uStreamLib {
+	void* Impl_Memory::alignedAlloc(size_t size, size_t alignment)
+	{
+		void* ptr = NULL;
+
+		if (posix_memalign(&ptr, alignment, size))
+			return NULL;
+
+		return ptr;
+	}
+
+	void Impl_Memory::alignedFree(void* ptr)
+	{
+		free(ptr);
+	}
+
+	size_t Impl_Memory::getPageSize(void)
+	{
+		return (size_t) sysconf(_SC_PAGESIZE);
+	}
+
+	void* Impl_Memory::mapRegion(size_t* size, bool hugepages)
+	{
+		size_t page = getPageSize();
+		void* ptr = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+		// try explicit huge pages first
+		if (hugepages) {
+			size_t sz = (*size + HUGE_PAGE_SIZE - 1) & ~((size_t) HUGE_PAGE_SIZE - 1);
+
+			ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (ptr != MAP_FAILED) {
+				*size = sz;
+				return ptr;
+			}
+		}
+#endif
+
+		// normal pages
+		*size = (*size + page - 1) & ~(page - 1);
+
+		ptr = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED)
+			return NULL;
+
+#if defined(MADV_HUGEPAGE)
+		// no huge pages reserved: ask for transparent huge pages
+		if (hugepages)
+			madvise(ptr, *size, MADV_HUGEPAGE);
+#endif
+
+		return ptr;
+	}
+
+	void Impl_Memory::unmapRegion(void* ptr, size_t size)
+	{
+		if (ptr)
+			munmap(ptr, size);
+	}
+
+	int32 Impl_Memory::lockAll(void)
+	{
+		if (mlockall(MCL_CURRENT | MCL_FUTURE))
+			return FAILURE;
+
+		return SUCCESS;
+	}
+
+	void Impl_Memory::unlockAll(void)
+	{
+		munlockall();
+	}
+
+	int32 Impl_Memory::bindToNode(void* ptr, size_t size, uint32 node)
+	{
+#if defined(SYS_mbind)
+		unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+		size_t page = getPageSize();
+		size_t start = (size_t) ptr & ~(page - 1);
+		size_t end = ((size_t) ptr + size + page - 1) & ~(page - 1);
+
+		if (!ptr || !size || node >= NUMA_MAX_NODES)
+			return FAILURE;
+
+		memset(mask, 0, sizeof(mask));
+		mask[node / (8 * sizeof(unsigned long))] |=
+			1UL << (node % (8 * sizeof(unsigned long)));
+
+		if (syscall(SYS_mbind, start, end - start, NUMA_MPOL_PREFERRED,
+			mask, NUMA_MAX_NODES + 1, NUMA_MPOL_MF_MOVE))
+			return FAILURE;
+
+		return SUCCESS;
+#else
+		return FAILURE;
+#endif
+	}
+}
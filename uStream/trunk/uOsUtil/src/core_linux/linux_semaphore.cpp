@@ -21,18 +21,30 @@
 
 #include <errno.h>
 #include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <time.h>
 
 #include "linux_semaphore.hpp"
 
 namespace uStreamLib {
 	Impl_Semaphore::Impl_Semaphore(void)
+		: _psem(&_sem), _name(NULL), _owner(false)
 	{
 		// nothing to do
 	}
 
 	Impl_Semaphore::~Impl_Semaphore(void)
 	{
-		sem_destroy(&_sem);
+		if (!_name) {
+			sem_destroy(&_sem);
+			return;
+		}
+
+		sem_close(_psem);
+		if (_owner)
+			sem_unlink(_name);
+		free(_name);
 	}
 
 	int32 Impl_Semaphore::init(uint32 init_value, bool process_shared)
@@ -46,16 +58,70 @@ namespace uStreamLib {
 		return SUCCESS;
 	}
 
+	int32 Impl_Semaphore::init(char* name, uint32 init_value, bool create)
+	{
+		size_t len = strlen(name);
+
+		// posix names start with a slash
+		_name = (char *) malloc(len + 2);
+		if (!_name)
+			return FAILURE;
+		_name[0] = '/';
+		strcpy(&_name[name[0] == '/' ? 0 : 1], name);
+
+		if (create) {
+			// a stale semaphore with the same name is replaced
+			sem_unlink(_name);
+			_psem = sem_open(_name, O_CREAT | O_EXCL, 0600, init_value);
+		} else {
+			_psem = sem_open(_name, 0);
+		}
+
+		if (_psem == SEM_FAILED) {
+			_psem = &_sem;
+			free(_name);
+			_name = NULL;
+			return FAILURE;
+		}
+
+		_owner = create;
+		return SUCCESS;
+	}
+
 	int32 Impl_Semaphore::wait(void)
 	{
-		return sem_wait(&_sem);
+		return sem_wait(_psem);
 	}
 
 	int32 Impl_Semaphore::tryWait(void)
 	{
 		int32 ret;
 
-		ret = sem_trywait(&_sem);
+		ret = sem_trywait(_psem);
+		if (ret < 0)
+			return FAILURE;
+
+		return SUCCESS;
+	}
+
+	int32 Impl_Semaphore::timedWait(uint32 ms)
+	{
+		struct timespec ts;
+		int32 ret;
+
+		// the deadline is absolute, on the realtime clock
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += ms / 1000;
+		ts.tv_nsec += (long) (ms % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec += 1;
+			ts.tv_nsec -= 1000000000;
+		}
+
+		do {
+			ret = sem_timedwait(_psem, &ts);
+		} while (ret < 0 && errno == EINTR);
+
 		if (ret < 0)
 			return FAILURE;
 
@@ -66,7 +132,7 @@ namespace uStreamLib {
 	{
 		int32 ret;
 
-		ret = sem_post(&_sem);
+		ret = sem_post(_psem);
 		if (ret < 0)
 			return FAILURE;
 
@@ -77,7 +143,7 @@ namespace uStreamLib {
 	{
 		int32 val;
 
-		sem_getvalue(&_sem, &val);
+		sem_getvalue(_psem, &val);
 		return (uint32) val;
 	}
 
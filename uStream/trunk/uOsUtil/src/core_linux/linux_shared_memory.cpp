@@ -0,0 +1,108 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "linux_shared_memory.hpp"
+
+namespace uStreamLib {
+	Impl_SharedMemory::Impl_SharedMemory(void)
+		: _addr(NULL), _size(0), _name(NULL), _owner(false)
+	{
+		// nothing to do
+	}
+
+	Impl_SharedMemory::~Impl_SharedMemory(void)
+	{
+		if (_addr)
+			munmap(_addr, _size);
+
+		// mappings of other processes stay valid
+		if (_name && _owner)
+			shm_unlink(_name);
+
+		free(_name);
+	}
+
+	int32 Impl_SharedMemory::init(char* name, size_t size, bool create)
+	{
+		struct stat st;
+		size_t len = strlen(name);
+		int32 fd = -1;
+
+		// posix names start with a slash
+		_name = (char *) malloc(len + 2);
+		if (!_name)
+			return FAILURE;
+		_name[0] = '/';
+		strcpy(&_name[name[0] == '/' ? 0 : 1], name);
+
+		if (create) {
+			// a stale object with the same name is replaced
+			shm_unlink(_name);
+			fd = shm_open(_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (fd < 0)
+				return FAILURE;
+
+			_owner = true;
+			if (ftruncate(fd, size) < 0) {
+				close(fd);
+				return FAILURE;
+			}
+		} else {
+			fd = shm_open(_name, O_RDWR, 0);
+			if (fd < 0)
+				return FAILURE;
+
+			// map the whole object
+			if (!size) {
+				if (fstat(fd, &st) < 0) {
+					close(fd);
+					return FAILURE;
+				}
+				size = (size_t) st.st_size;
+			}
+		}
+
+		_addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (_addr == MAP_FAILED) {
+			_addr = NULL;
+			return FAILURE;
+		}
+
+		_size = size;
+		return SUCCESS;
+	}
+
+	char* Impl_SharedMemory::getErrorString(void)
+	{
+		return strerror(errno);
+	}
+}
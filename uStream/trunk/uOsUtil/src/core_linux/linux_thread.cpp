@@ -19,12 +19,27 @@
   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 #include "thread.hpp"
+#include "atomic.hpp"
 #include "linux_thread.hpp"
 
 namespace uStreamLib {
+	/*
+	 * Thread slots.
+	 */
+
+	static volatile int32 thread_slots = 0;
+	static __thread uint32 thread_slot = 0;
+
 	/*
 	 * Thread procedure.
 	 */
@@ -39,6 +54,7 @@ namespace uStreamLib {
 	}
 
 	Impl_Thread::Impl_Thread(void)
+		: _ktid(0)
 	{
 		// nothing to do
 	}
@@ -48,12 +64,23 @@ namespace uStreamLib {
 		// nothing to do
 	}
 
-	int32 Impl_Thread::init(Thread* t)
+	int32 Impl_Thread::init(Thread* t, uint32 stack_size)
 	{
+		pthread_attr_t attr;
 		int32 ret;
 
+		pthread_attr_init(&attr);
+
+		// stack size (rounded up to the minimum)
+		if (stack_size) {
+			if (stack_size < PTHREAD_STACK_MIN)
+				stack_size = PTHREAD_STACK_MIN;
+			pthread_attr_setstacksize(&attr, stack_size);
+		}
+
 		// create posix thread
-		ret = pthread_create(&_tid, NULL, thread_proc, t);
+		ret = pthread_create(&_tid, &attr, thread_proc, t);
+		pthread_attr_destroy(&attr);
 		if (ret)
 			return FAILURE;
 
@@ -66,12 +93,45 @@ namespace uStreamLib {
 
 	void Impl_Thread::sleep(int32 milliseconds)
 	{
-		struct timeval to;
+		struct timespec ts;
+
+		if (milliseconds <= 0)
+			return;
 
-		to.tv_sec = 0;
-		to.tv_usec = milliseconds * 1000;
+		ts.tv_sec = milliseconds / 1000;
+		ts.tv_nsec = (long) (milliseconds % 1000) * 1000000;
 
-		select(1, NULL, NULL, NULL, &to);
+		// go on sleeping when interrupted by a signal
+		while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+			;
+	}
+
+	void Impl_Thread::sleepUntil(uint64 us)
+	{
+		struct timespec ts;
+
+		ts.tv_sec = (time_t) (us / 1000000);
+		ts.tv_nsec = (long) (us % 1000000) * 1000;
+
+		// the deadline is absolute: retry as is after a signal
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+			NULL) == EINTR)
+			;
+	}
+
+	uint32 Impl_Thread::getCurrentSlot(void)
+	{
+		if (!thread_slot)
+			thread_slot = (uint32) Atomic::increment(&thread_slots);
+
+		return thread_slot;
+	}
+
+	uint32 Impl_Thread::getProcessorsCount(void)
+	{
+		long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+		return count > 0 ? (uint32) count : 1;
 	}
 
 	void Impl_Thread::detach(void)
@@ -88,4 +148,63 @@ namespace uStreamLib {
 	{
 		::pthread_cancel(_tid);
 	}
+
+	void Impl_Thread::started(void)
+	{
+		_tid = pthread_self();
+		_ktid = (pid_t) syscall(SYS_gettid);
+	}
+
+	int32 Impl_Thread::setAffinity(uint64 cpus)
+	{
+		cpu_set_t set;
+		uint32 i = 0;
+
+		CPU_ZERO(&set);
+
+		for (i = 0; i < 64 && i < CPU_SETSIZE; i++) {
+			if (!cpus || (cpus & ((uint64) 1 << i)))
+				CPU_SET(i, &set);
+		}
+
+		if (pthread_setaffinity_np(_tid, sizeof(set), &set))
+			return FAILURE;
+
+		return SUCCESS;
+	}
+
+	int32 Impl_Thread::setScheduling(int32 policy, int32 priority)
+	{
+		struct sched_param param;
+		int p = SCHED_OTHER;
+
+		if (policy == Thread::POLICY_FIFO)
+			p = SCHED_FIFO;
+		else if (policy == Thread::POLICY_RR)
+			p = SCHED_RR;
+
+		// clamp to the range of the policy
+		if (priority < sched_get_priority_min(p))
+			priority = sched_get_priority_min(p);
+		if (priority > sched_get_priority_max(p))
+			priority = sched_get_priority_max(p);
+
+		param.sched_priority = priority;
+
+		if (pthread_setschedparam(_tid, p, &param))
+			return FAILURE;
+
+		return SUCCESS;
+	}
+
+	int32 Impl_Thread::setNice(int32 nice)
+	{
+		if (!_ktid)
+			return FAILURE;
+
+		if (setpriority(PRIO_PROCESS, (id_t) _ktid, nice))
+			return FAILURE;
+
+		return SUCCESS;
+	}
 }
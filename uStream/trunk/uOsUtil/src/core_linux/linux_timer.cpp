@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "linux_timer.hpp"
 
@@ -51,6 +52,14 @@ namespace uStreamLib {
 		return _u_telapsed;
 	}
 
+	uint64 Impl_Timer::getMonotonicTime(void)
+	{
+		struct timespec ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64) ts.tv_sec * 1000000 + (uint64) ts.tv_nsec / 1000;
+	}
+
 	void Impl_Timer::stop(TimeDesc* td)
 	{
 		struct timeval res;
@@ -69,7 +78,7 @@ namespace uStreamLib {
 		_u_telapsed = (_tv2.tv_sec * 1000000 + _tv2.tv_usec) -
 			(_tv1.tv_sec * 1000000 + _tv1.tv_usec);
 
-		val = div(res.tv_sec, 3600);
+		val = div((int) res.tv_sec, 3600);
 		td->hours = val.quot;
 		td->sec = val.rem;
 
@@ -77,7 +86,7 @@ namespace uStreamLib {
 		td->min = val.quot;
 		td->sec = val.rem;
 
-		val = div(res.tv_usec, 1000);
+		val = div((int) res.tv_usec, 1000);
 		td->msec = val.quot;
 		td->usec = val.rem;
 	}
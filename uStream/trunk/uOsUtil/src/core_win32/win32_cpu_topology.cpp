@@ -0,0 +1,132 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include <malloc.h>
+#include <string.h>
+
+#include "win32_cpu_topology.hpp"
+
+namespace uStreamLib {
+	/*
+	 * Lowest processor of a mask.
+	 */
+
+	static uint32 lowest_cpu(ULONG_PTR mask)
+	{
+		uint32 i = 0;
+
+		while (i < 8 * sizeof(mask) && !(mask & ((ULONG_PTR) 1 << i)))
+			i++;
+
+		return i;
+	}
+
+	uint32 Impl_CpuTopology::read(CpuTopology::CpuInfo* cpus, uint32 max)
+	{
+		SYSTEM_LOGICAL_PROCESSOR_INFORMATION* info = NULL;
+		CpuTopology::CpuInfo* map[CpuTopology::MAX_CPUS];
+		DWORD len = 0;
+		uint32 n = 0, i = 0, j = 0, count = 0, cores = 0, packages = 0;
+
+		GetLogicalProcessorInformation(NULL, &len);
+		if (!len)
+			return 0;
+
+		info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION *) malloc(len);
+		if (!info)
+			return 0;
+
+		if (!GetLogicalProcessorInformation(info, &len)) {
+			free(info);
+			return 0;
+		}
+
+		n = len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+
+		// processors come with their cores
+		memset(map, 0, sizeof(map));
+		for (j = 0; j < CpuTopology::MAX_CPUS && j < 8 * sizeof(ULONG_PTR);
+			j++) {
+			for (i = 0; i < n; i++) {
+				if (info[i].Relationship == RelationProcessorCore &&
+					(info[i].ProcessorMask & ((ULONG_PTR) 1 << j)))
+					break;
+			}
+
+			if (i == n || count >= max)
+				continue;
+
+			map[j] = &cpus[count++];
+			map[j]->cpu = j;
+			map[j]->core = j;
+			map[j]->package = 0;
+			map[j]->node = 0;
+			map[j]->l2 = j;
+			map[j]->l3 = (uint32) -1;
+		}
+
+		for (i = 0; i < n; i++) {
+			ULONG_PTR mask = info[i].ProcessorMask;
+			uint32 first = lowest_cpu(mask);
+
+			for (j = 0; j < CpuTopology::MAX_CPUS && j < 8 * sizeof(mask);
+				j++) {
+				if (!map[j] || !(mask & ((ULONG_PTR) 1 << j)))
+					continue;
+
+				switch (info[i].Relationship) {
+				case RelationProcessorCore:
+					map[j]->core = cores;
+					break;
+				case RelationProcessorPackage:
+					map[j]->package = packages;
+					break;
+				case RelationNumaNode:
+					map[j]->node = info[i].NumaNode.NodeNumber;
+					break;
+				case RelationCache:
+					if (info[i].Cache.Level == 2)
+						map[j]->l2 = first;
+					else if (info[i].Cache.Level == 3)
+						map[j]->l3 = first;
+					break;
+				default:
+					break;
+				}
+			}
+
+			if (info[i].Relationship == RelationProcessorCore)
+				cores++;
+			else if (info[i].Relationship == RelationProcessorPackage)
+				packages++;
+		}
+
+		// no L3: the L2 is the last level
+		for (i = 0; i < count; i++) {
+			if (cpus[i].l3 == (uint32) -1)
+				cpus[i].l3 = cpus[i].l2;
+		}
+
+		free(info);
+		return count;
+	}
+}
@@ -131,6 +131,34 @@ namespace uStreamLib {
 		return (int32) wb;
 	}
 
+	int32 Impl_File::writeFileV(dsegment* segs, uint32 count)
+	{
+		BOOL ret = 0;
+		DWORD wb = 0;
+		int32 total = 0;
+
+		if (_fd == INVALID_HANDLE_VALUE)
+			return FAILURE;
+
+		/*
+		 * WriteFileGather() wants unbuffered handles and page
+		 * sized segments: write one segment at time.
+		 */
+		for (uint32 i = 0; i < count; i++) {
+			ret = ::WriteFile(_fd, segs[i].addr, segs[i].size, &wb, NULL);
+			if (!ret)
+				return total ? total : (int32) FAILURE;
+
+			total += (int32) wb;
+
+			// stop on a short write
+			if (wb < segs[i].size)
+				break;
+		}
+
+		return total;
+	}
+
 	int32 Impl_File::seek(int32 offset, int32 origin)
 	{
 		DWORD ret = 0;
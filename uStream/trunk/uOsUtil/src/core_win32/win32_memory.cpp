@@ -0,0 +1,112 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include <malloc.h>
+
+#include "win32_memory.hpp"
+
+namespace uStreamLib {
+	void* Impl_Memory::alignedAlloc(size_t size, size_t alignment)
+	{
+		return _aligned_malloc(size, alignment);
+	}
+
+	void Impl_Memory::alignedFree(void* ptr)
+	{
+		_aligned_free(ptr);
+	}
+
+	size_t Impl_Memory::getPageSize(void)
+	{
+		SYSTEM_INFO si;
+
+		GetSystemInfo(&si);
+		return (size_t) si.dwPageSize;
+	}
+
+	void* Impl_Memory::mapRegion(size_t* size, bool hugepages)
+	{
+		size_t page = getPageSize();
+		size_t large = GetLargePageMinimum();
+		void* ptr = NULL;
+
+		// try large pages first (needs SeLockMemoryPrivilege)
+		if (hugepages && large) {
+			size_t sz = (*size + large - 1) & ~(large - 1);
+
+			ptr = VirtualAlloc(NULL, sz,
+				MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (ptr) {
+				*size = sz;
+				return ptr;
+			}
+		}
+
+		// normal pages
+		*size = (*size + page - 1) & ~(page - 1);
+
+		return VirtualAlloc(NULL, *size, MEM_RESERVE | MEM_COMMIT,
+			PAGE_READWRITE);
+	}
+
+	void Impl_Memory::unmapRegion(void* ptr, size_t)
+	{
+		if (ptr)
+			VirtualFree(ptr, 0, MEM_RELEASE);
+	}
+
+	int32 Impl_Memory::lockAll(void)
+	{
+		SIZE_T wmin = 0, wmax = 0;
+		HANDLE proc = GetCurrentProcess();
+
+		/*
+		 * There is no way to lock the whole process: make the
+		 * working set big enough not to page buffers out.
+		 */
+		if (!GetProcessWorkingSetSize(proc, &wmin, &wmax))
+			return FAILURE;
+
+		if (wmin < 64 * 1024 * 1024)
+			wmin = 64 * 1024 * 1024;
+		if (wmax < 2 * wmin)
+			wmax = 2 * wmin;
+
+		if (!SetProcessWorkingSetSizeEx(proc, wmin, wmax,
+			QUOTA_LIMITS_HARDWS_MIN_ENABLE))
+			return FAILURE;
+
+		return SUCCESS;
+	}
+
+	int32 Impl_Memory::bindToNode(void*, size_t, uint32)
+	{
+		// pages cannot be moved: only VirtualAllocExNuma() places them
+		return FAILURE;
+	}
+
+	void Impl_Memory::unlockAll(void)
+	{
+		SetProcessWorkingSetSizeEx(GetCurrentProcess(), (SIZE_T) -1,
+			(SIZE_T) -1, QUOTA_LIMITS_HARDWS_MIN_DISABLE);
+	}
+}
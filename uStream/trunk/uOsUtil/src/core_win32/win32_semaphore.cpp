@@ -47,6 +47,22 @@ namespace uStreamLib {
 		return SUCCESS;
 	}
 
+	int32 Impl_Semaphore::init(char* name, uint32 init_value, bool create)
+	{
+		int32 max_val = 0x7fffffff;
+
+		// the name goes away with the last handle
+		if (create)
+			_sem = ::CreateSemaphoreA(NULL, init_value, max_val, name);
+		else
+			_sem = ::OpenSemaphoreA(SEMAPHORE_ALL_ACCESS, FALSE, name);
+		if (!_sem)
+			return FAILURE;
+
+		_value = init_value;
+		return SUCCESS;
+	}
+
 	int32 Impl_Semaphore::wait(void)
 	{
 		DWORD ret = WAIT_FAILED;
@@ -69,6 +85,17 @@ namespace uStreamLib {
 		return FAILURE;
 	}
 
+	int32 Impl_Semaphore::timedWait(uint32 ms)
+	{
+		DWORD ret = WAIT_FAILED;
+
+		ret = ::WaitForSingleObject(_sem, ms);
+		if (ret == WAIT_OBJECT_0)
+			return SUCCESS;
+
+		return FAILURE;
+	}
+
 	int32 Impl_Semaphore::post(void)
 	{
 		BOOL ret;
@@ -0,0 +1,74 @@
+/*
+  uSTREAM LIGHT-WEIGHT STREAMING ARCHITECTURE
+  Copyright (C) 2005 Luis Serrano (luis@kontrol-dj.com) 
+  
+  Based on DANUBIO STREAMING ARCHITECTURE by Michele Iacobellis (m.iacobellis@nexotech.it)
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "win32_shared_memory.hpp"
+
+namespace uStreamLib {
+	Impl_SharedMemory::Impl_SharedMemory(void)
+		: _map(NULL), _addr(NULL), _size(0)
+	{
+		// nothing to do
+	}
+
+	Impl_SharedMemory::~Impl_SharedMemory(void)
+	{
+		if (_addr)
+			::UnmapViewOfFile(_addr);
+
+		// the object goes away with the last handle
+		if (_map)
+			::CloseHandle(_map);
+	}
+
+	int32 Impl_SharedMemory::init(char* name, size_t size, bool create)
+	{
+		MEMORY_BASIC_INFORMATION mbi;
+
+		if (create) {
+			_map = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL,
+				PAGE_READWRITE, (DWORD) ((unsigned __int64) size >> 32),
+				(DWORD) size, name);
+		} else {
+			_map = ::OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+		}
+		if (!_map)
+			return FAILURE;
+
+		_addr = ::MapViewOfFile(_map, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (!_addr)
+			return FAILURE;
+
+		// map the whole object
+		if (!size) {
+			::VirtualQuery(_addr, &mbi, sizeof(mbi));
+			size = mbi.RegionSize;
+		}
+
+		_size = size;
+		return SUCCESS;
+	}
+
+	char* Impl_SharedMemory::getErrorString(void)
+	{
+		return "NOT_IMPLEMENTED";
+	}
+}
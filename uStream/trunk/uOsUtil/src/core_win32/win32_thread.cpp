@@ -21,9 +21,18 @@
 */
 
 #include "win32_thread.hpp"
+#include "win32_timer.hpp"
 #include "thread.hpp"
+#include "atomic.hpp"
 
 namespace uStreamLib {
+	/*
+	 * Thread slots.
+	 */
+
+	static volatile int32 thread_slots = 0;
+	static __declspec(thread) uint32 thread_slot = 0;
+
 	/*
 	 * Thread procedure.
 	 */
@@ -47,11 +56,11 @@ namespace uStreamLib {
 		// nothing to do
 	}
 
-	int32 Impl_Thread::init(Thread* t)
+	int32 Impl_Thread::init(Thread* t, uint32 stack_size)
 	{
-		_tid = ::CreateThread(NULL, 0, thread_proc, // thread entry point
+		_tid = ::CreateThread(NULL, stack_size, thread_proc, // entry point
 		t,  		 // thread data (t object)
-		0, &_id);
+		stack_size ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0, &_id);
 		if (_tid == NULL)
 			return FAILURE;
 
@@ -63,6 +72,33 @@ namespace uStreamLib {
 		::Sleep(milliseconds);
 	}
 
+	void Impl_Thread::sleepUntil(uint64 us)
+	{
+		uint64 now = Impl_Timer::getMonotonicTime();
+
+		// Sleep() has millisecond resolution at best
+		if (us > now)
+			::Sleep((DWORD) ((us - now + 999) / 1000));
+	}
+
+	uint32 Impl_Thread::getCurrentSlot(void)
+	{
+		if (!thread_slot)
+			thread_slot = (uint32) Atomic::increment(&thread_slots);
+
+		return thread_slot;
+	}
+
+	uint32 Impl_Thread::getProcessorsCount(void)
+	{
+		SYSTEM_INFO si;
+
+		::GetSystemInfo(&si);
+
+		return si.dwNumberOfProcessors > 0 ?
+			(uint32) si.dwNumberOfProcessors : 1;
+	}
+
 	void Impl_Thread::detach(void)
 	{
 		// not implemented
@@ -80,4 +116,61 @@ namespace uStreamLib {
 	{
 		TerminateThread(_tid, 0);
 	}
+
+	void Impl_Thread::started(void)
+	{
+		// the handle from CreateThread() is fine
+	}
+
+	int32 Impl_Thread::setAffinity(uint64 cpus)
+	{
+		DWORD_PTR mask = (DWORD_PTR) cpus;
+		DWORD_PTR pmask = 0, smask = 0;
+
+		// any processor of this process
+		if (!mask) {
+			if (!GetProcessAffinityMask(GetCurrentProcess(), &pmask, &smask))
+				return FAILURE;
+			mask = pmask;
+		}
+
+		if (!SetThreadAffinityMask(_tid, mask))
+			return FAILURE;
+
+		return SUCCESS;
+	}
+
+	int32 Impl_Thread::setScheduling(int32 policy, int32 priority)
+	{
+		int p = THREAD_PRIORITY_NORMAL;
+
+		// no real time policies: map them on priorities
+		if (policy != Thread::POLICY_DEFAULT)
+			p = priority >= 50 ? THREAD_PRIORITY_TIME_CRITICAL :
+				THREAD_PRIORITY_HIGHEST;
+
+		if (!SetThreadPriority(_tid, p))
+			return FAILURE;
+
+		return SUCCESS;
+	}
+
+	int32 Impl_Thread::setNice(int32 nice)
+	{
+		int p = THREAD_PRIORITY_NORMAL;
+
+		if (nice <= -10)
+			p = THREAD_PRIORITY_HIGHEST;
+		else if (nice < 0)
+			p = THREAD_PRIORITY_ABOVE_NORMAL;
+		else if (nice >= 10)
+			p = THREAD_PRIORITY_LOWEST;
+		else if (nice > 0)
+			p = THREAD_PRIORITY_BELOW_NORMAL;
+
+		if (!SetThreadPriority(_tid, p))
+			return FAILURE;
+
+		return SUCCESS;
+	}
 }
@@ -48,6 +48,19 @@ namespace uStreamLib {
 		return _u_telapsed;
 	}
 
+	uint64 Impl_Timer::getMonotonicTime(void)
+	{
+		LARGE_INTEGER count, freq;
+
+		QueryPerformanceFrequency(&freq);
+		QueryPerformanceCounter(&count);
+
+		// split to avoid overflows of count * 1000000
+		return (uint64) (count.QuadPart / freq.QuadPart) * 1000000 +
+			(uint64) (count.QuadPart % freq.QuadPart) * 1000000 /
+			freq.QuadPart;
+	}
+
 	void Impl_Timer::stop(TimeDesc* td)
 	{
 		DWORD delta = 0, msec = 0;
@@ -23,6 +23,8 @@
 #define BLOCK_HPP
 
 #include "thread.hpp"
+#include "waitset.hpp"
+#include "task_scheduler.hpp"
 #include "shared_hash.hpp"
 #include "sharedvars.hpp"
 #include "configtable.hpp"
@@ -39,7 +41,8 @@ namespace uStreamLib {
 	 * in performing a task such as reading from an audio or video device,
 	 * writing to a video surface or audio output, injecting data into the
 	 * network. A Block can act as a source, sink or filter.
-	 * Each block runs into a separate thread and has a control pin
+	 * Each block runs into a separate thread (or as a task, see
+	 * BlockManager::startScheduler()) and has a control pin
 	 * on which it waits for control commands.
 	 * Each block inherits from ConfigTable so that it can store
 	 * configuration parameters as strings (see ConfigTable for info).
@@ -89,7 +92,9 @@ namespace uStreamLib {
 		EVENT_TERMINATE = 11, /** execute specific command */
 		EVENT_COMMAND = 12, /** last used event id plus 1 */
 		EVENT_LAST_USED_ID = 13, /** maximum id for these indexes */
-		EVENT_MAX_ID = 20 };
+		EVENT_MAX_ID = 20, /** wake up a sleeping block: internal, it
+		has no handler slot and the run loops drop it */
+		EVENT_WAKEUP = EVENT_MAX_ID };
 
 		/**
 		 * Status identifiers.
@@ -124,6 +129,16 @@ namespace uStreamLib {
 		 */
 		enum ExecHandlerReturnValue { HANDLER_UNDEFINED = -1 };
 
+		/**
+		 * Bits returned by waitAny().
+		 */
+		enum WaitID { /** a control message arrived */
+		WAIT_CONTROL = 0x1, /** a peer's pool got a free buffer */
+		WAIT_OUTPUT = 0x2, /** wakeUp() has been called */
+		WAIT_WAKEUP = 0x4, /** data arrived on the first input pin
+		(next input pins use the next bits, see DataPin::getWaitMask()) */
+		WAIT_INPUT = 0x8 };
+
 		/**
 		 * Lock/Unlock constants. Constants to use in lock/unlock.
 		 */
@@ -144,6 +159,8 @@ namespace uStreamLib {
 
 		/**
 		 * Deallocate memory used by pins. Call this to delete all pins.
+		 * Pins still connected are disconnected first, so that peer
+		 * blocks running meanwhile forget them.
 		 */
 		void destroyPins(void);
 
@@ -274,6 +291,116 @@ namespace uStreamLib {
 		 */
 		int32 sendMessageToPeersOf(DataPin* dp, uint32 code);
 
+		/**
+		 * Wake up this block if it is sleeping because its last
+		 * action handler returned BlockHandler::HWOULDBLOCK, or
+		 * in waitAny().
+		 */
+		void wakeUp(void);
+
+		/**
+		 * Wait until a control message arrives, data arrives on an
+		 * input pin, an exhausted buffer pool of a peer of an output
+		 * pin gets a free buffer or wakeUp() is called. Blocks with
+		 * many inputs (eg. mixers) wake up once for all the inputs
+		 * which became ready. Bits tell what happened since the
+		 * last wait: drain the ready sources before waiting again.
+		 * Only the block thread may wait; blocks run as tasks do
+		 * not sleep here but return at once (see idleStep()).
+		 * @param timeout time to wait for in milliseconds, 0 not to
+		 * wait or -1 to wait forever.
+		 * @return WAIT_* bits (and the masks of the input pins) or
+		 * 0 if the time expired.
+		 */
+		uint32 waitAny(int32 timeout = -1);
+
+		/**
+		 * Let the upstream block run the action handlers of this
+		 * filter right after its own, in its thread, instead of
+		 * handing each buffer to another thread. This filter must
+		 * have one input pin with one peer, whose block has one
+		 * output pin connected to this block only (a linear chain,
+		 * see BlockManager::fuseChains()). Pins and wires do not
+		 * change and control messages are still handled by this
+		 * block; the upstream block stops sending it data ready
+		 * events.
+		 * @return SUCCESS or FAILURE if the blocks cannot be fused.
+		 */
+		int32 fuse(void);
+
+		/**
+		 * Undo fuse() on both sides of this block: it runs its own
+		 * action handlers again, and so does the downstream block.
+		 */
+		void unfuse(void);
+
+		/**
+		 * Get the block whose action handlers this block runs.
+		 * @return the downstream fused block or NULL.
+		 */
+		Block* getFusedNext(void)
+		{
+			return (Block *) Atomic::loadPtr(&_fusedNext);
+		}
+
+		/**
+		 * Get the block which runs the action handlers of this block.
+		 * @return the upstream fused block or NULL.
+		 */
+		Block* getFusedPrev(void)
+		{
+			return (Block *) Atomic::loadPtr(&_fusedPrev);
+		}
+
+		/**
+		 * Check if this block runs as a task instead of having a
+		 * thread. Action handlers of such blocks should not sleep:
+		 * they keep a worker busy in the meantime.
+		 * @return true or false.
+		 */
+		bool isTask(void)
+		{
+			return _task.getScheduler() != NULL;
+		}
+
+		/**
+		 * Wake up this block after some time, if it sleeps. To be
+		 * called by action handlers (eg. a source pacing its output)
+		 * before returning BlockHandler::HWOULDBLOCK. The deadline
+		 * is cleared once it has passed.
+		 * @param ms time to sleep for in milliseconds.
+		 */
+		void wakeUpAfter(uint32 ms);
+
+		/**
+		 * Like wakeUpAfter(), with an absolute deadline.
+		 * @param us monotonic time to wake up at, as got from
+		 * Timer::getMonotonicTime() (microseconds).
+		 */
+		void wakeUpAt(uint64 us)
+		{
+			_deadline = us;
+		}
+
+		/**
+		 * Reserved public method. Data pins call it when a buffer
+		 * pool has no free buffer for this block.
+		 * @param bp the exhausted buffer pool.
+		 */
+		void setStarvedPool(BufferPool* bp)
+		{
+			_starved = bp;
+		}
+
+		/**
+		 * Let the buffer pools of the input pins give memory back.
+		 * The block manager calls this method periodically, blocks
+		 * call it when they are paused or stopped.
+		 * @param trim true to release every free buffer at once,
+		 * false to shrink only pools idle for some time.
+		 */
+		void releaseBuffers(bool trim);
+
 		/**
 		 * Attach event handler to a specific event.
 		 * You can create an event handler object and then
@@ -464,6 +591,7 @@ namespace uStreamLib {
 		 * Other constructors protected.
 		 */
 		Block(Block&)
+			: _wsOutput(&_ws, WAIT_OUTPUT), _task(this)
 		{
 		}
 
@@ -486,7 +614,97 @@ namespace uStreamLib {
 			int32 queuesz = US_CP_QUEUESZ  // control pin's queue size
 		);
 
+		/**
+		 * Apply the thread settings found in the properties of this
+		 * block (USBL_CPUSET, USBL_SCHEDPOLICY, USBL_SCHEDPRIORITY
+		 * and USBL_NICE) when the thread starts. Blocks run as tasks
+		 * have no thread of their own and ignore them.
+		 */
+		void prepare(void);
+
+		/**
+		 * Sleep like waitAny() until something happens or the
+		 * deadline set by wakeUpAfter() passes. The block does not
+		 * sleep if something happened while the action handlers
+		 * were running.
+		 * @param cm message structure to store the message into.
+		 * @return SUCCESS if a control message has been received or
+		 * FAILURE if the block has been woken up for something else.
+		 */
+		int32 waitForControlMessage(cmessage* cm);
+
+		/**
+		 * Check if any input pin has queued messages.
+		 * @return true or false.
+		 */
+		bool hasInputData(void);
+
+		/**
+		 * Run the action handlers once on behalf of the upstream
+		 * block this block is fused with (see fuse()).
+		 * @return true if some data has been consumed.
+		 */
+		virtual bool fusedRound(void)
+		{
+			return false;
+		}
+
+		/**
+		 * Run the action handlers of the downstream fused block,
+		 * if any. To be called after a round of action handlers.
+		 * @return true if the downstream blocks consumed some data.
+		 */
+		bool runFusedNext(void)
+		{
+			Block* b = getFusedNext();
+
+			return b ? b->fusedRound() : false;
+		}
+
+		/**
+		 * Wake up the first block of the fused chain this block
+		 * belongs to, eg. when its state changed and it has data
+		 * to process.
+		 */
+		void wakeFusedHead(void);
+
+		/**
+		 * Run a bounded slice of this block's work without sleeping,
+		 * when the block runs as a task. The block runs again
+		 * when a control message or data arrives, or as told by
+		 * the return value. The default implementation calls run(),
+		 * keeping a worker busy until the block quits.
+		 * @return Task::TASK_READY to run again soon, Task::TASK_IDLE
+		 * to wait or Task::TASK_DONE when the block quits.
+		 */
+		virtual int32 step(void);
+
+		/**
+		 * To be returned by step() when the action handlers would
+		 * block: the block runs again when waitAny() would return.
+		 * @return Task::TASK_IDLE or Task::TASK_READY if it needs
+		 * not wait.
+		 */
+		int32 idleStep(void);
+
 	private:
+		/*
+		 * The task running the block on a worker.
+		 */
+		class StepTask : public Task {
+		public:
+			StepTask(Block* b)
+				: _block(b)
+			{
+			}
+
+			int32 execute(void);
+
+			void done(void);
+		private:
+			Block* _block;
+		};
+
 		/* static storage for command strings */
 		static char* _cmdstrings[EVENT_HANDLERS_TABLE_SIZE];
 
@@ -525,6 +743,45 @@ namespace uStreamLib {
 
 		/* error string (fixed size) */
 		SharedString _errorstring;
+
+		/* wait set signalled by the pins' queues */
+		WaitSet _ws;
+
+		/*
+		 * Callback armed on the exhausted buffer pools of the peers
+		 * while waiting: a free buffer wakes the block up.
+		 */
+		WaitSet::Trigger _wsOutput;
+
+		/* monotonic time (us) to wake up at or 0 */
+		uint64 _deadline;
+
+		/* last pool found without free buffers (compared only) */
+		BufferPool* _starved;
+
+		/* task of a block run by the scheduler */
+		StepTask _task;
+
+		/* flag: pools armed by idleStep() */
+		bool _armed;
+
+		/* fused blocks (see fuse()) */
+		void* volatile _fusedNext;
+		void* volatile _fusedPrev;
+
+		/* make the block thread look at its state again */
+		void _kick(void);
+
+		/*
+		 * Arm (or cancel) the wake up callback on the exhausted pools
+		 * of the peers of the output pins, of this block and of the
+		 * downstream fused ones. Returns FAILURE if a pool cannot
+		 * be armed; sets *ready if a pool has free buffers.
+		 */
+		int32 _armPools(bool arm, bool* ready);
+
+		/* delete the wires of a pin */
+		void _unwire(Pin* p);
 	};
 }
 
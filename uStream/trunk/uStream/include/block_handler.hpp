@@ -23,6 +23,7 @@
 #define BLOCK_HANDLER_HPP
 
 #include "callback.hpp"
+#include "task_scheduler.hpp"
 #include "constants.hpp"
 
 namespace uStreamLib {
@@ -47,7 +48,8 @@ namespace uStreamLib {
 		enum HandlerReturnValue { /** the handler did its job correctly */
 		HSUCCESS = 0, /** the handler failed to make its job */
 		HFAILURE = 1, /** the handler encountered a critical failure */
-		HCRITICAL = 2 };
+		HCRITICAL = 2, /** the handler has nothing to do until woken up */
+		HWOULDBLOCK = 3 };
 
 		/**
 		 * Contructor.
@@ -77,13 +79,34 @@ namespace uStreamLib {
 		{
 			return _code;
 		}
+
+		/**
+		 * Run a loop body over a range on several threads, eg. to
+		 * process the rows of a big buffer in an action handler
+		 * (see BlockManager::parallelFor()). The loop uses no more
+		 * threads than the processors the block is bound to (see
+		 * USBL_CPU_SET), the calling thread included.
+		 * @param begin first index.
+		 * @param end index after the last one.
+		 * @param grain indexes per slice (0 means one slice per
+		 * thread).
+		 * @param body the loop body.
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 parallelFor(uint32 begin, uint32 end, uint32 grain,
+			LoopBody* body);
 	protected:
 		/**
 		 * Handler entry point.
 		 * When creating an event handler, this method must be overridden.
 		 * This method must return HSUCCESS for signaling a success
 		 * to the block; HFAILURE to signal that the handler failed
-		 * and HCRITICAL to signal a critical failure.
+		 * and HCRITICAL to signal a critical failure. An action
+		 * handler returns HWOULDBLOCK when it cannot make progress
+		 * (no input data, no free output buffers, too early): the
+		 * block then sleeps until a control message, input data,
+		 * a free output buffer or the deadline set by
+		 * Block::wakeUpAfter() wakes it up.
 		 */
 		virtual int32 perform(void)
 		{
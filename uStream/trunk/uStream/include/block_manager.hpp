@@ -29,6 +29,7 @@
 #include "configtable.hpp"
 #include "loggable.hpp"
 #include "interp.hpp"
+#include "cpu_topology.hpp"
 #include "constants.hpp"
 #include "source.hpp"
 #include "sink.hpp"
@@ -286,6 +287,21 @@ namespace uStreamLib {
 		 */
 		int32 disconnectPins(Wire* wire);
 
+		/**
+		 * Fuse linear chains of blocks: each filter with a single
+		 * upstream peer, which feeds that filter only, gets its action
+		 * handlers run by the upstream block (see Block::fuse()).
+		 * Call this method once the graph is built; connecting or
+		 * disconnecting pins unfuses the blocks involved.
+		 * @return the number of fused filters.
+		 */
+		int32 fuseChains(void);
+
+		/**
+		 * Undo fuseChains(): every block runs its own action handlers.
+		 */
+		void unfuseChains(void);
+
 		/***************** BLOCK MESSAGE METHODS ********************/
 
 		/**
@@ -426,6 +442,70 @@ namespace uStreamLib {
 			_clock.stop(td);
 		}
 
+		/**
+		 * Run the blocks created from now on as tasks, on a pool
+		 * of worker threads, instead of giving each block a thread.
+		 * Usually called by setting the USBM_TASK_WORKERS property
+		 * before creating blocks.
+		 * @param workers number of workers or 0 for one per processor.
+		 * @return SUCCESS or FAILURE (eg. if already called).
+		 */
+		int32 startScheduler(uint32 workers);
+
+		/**
+		 * Get the scheduler running blocks as tasks.
+		 * @return the scheduler or NULL if each block has a thread.
+		 */
+		TaskScheduler* getScheduler(void)
+		{
+			return _sched;
+		}
+
+		/**
+		 * Run a loop body over a range on several threads (see
+		 * TaskScheduler::parallelFor()). Blocks run as tasks share
+		 * the workers of the block scheduler; otherwise all the
+		 * blocks share a pool with a worker less than processors,
+		 * created at the first call. Either way concurrent loops
+		 * do not add threads to the process.
+		 * @param begin first index.
+		 * @param end index after the last one.
+		 * @param grain indexes per slice (0 means one slice per
+		 * thread).
+		 * @param body the loop body.
+		 * @param threads max threads to use, the caller included
+		 * (0 means no limit).
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 parallelFor(uint32 begin, uint32 end, uint32 grain,
+			LoopBody* body, uint32 threads = 0);
+
+		/**
+		 * Lock the memory of the process in RAM and prefault the
+		 * buffer pools of all input pins, so that blocks do not get
+		 * page faults while streaming (see USBM_LOCK_MEMORY). Pools
+		 * of pins connected later are prefaulted when connected.
+		 * Prefaulted pools keep their memory even when unlocking.
+		 * @param lock true to lock, false to unlock.
+		 * @return SUCCESS or FAILURE if memory cannot be locked or
+		 * some pool cannot be prefaulted.
+		 */
+		int32 lockMemory(bool lock);
+
+		/**
+		 * Place block threads on processors following the topology
+		 * of the machine and the wires between blocks: the blocks of
+		 * a connected graph share a last level cache, while graphs
+		 * not connected to each other are spread across caches,
+		 * packages and NUMA nodes. Buffer pools of input pins are
+		 * moved to the node of their block. Blocks with USBL_CPUSET
+		 * and blocks run as tasks are left alone.
+		 * With USBM_AUTO_PLACEMENT set, this runs again whenever pins
+		 * are connected or disconnected.
+		 * @return SUCCESS or FAILURE.
+		 */
+		int32 placeBlocks(void);
+
 		/**
 		 * Block Manager entry point. This method performs all
 		 * the actions needed for controlling the blocks.
@@ -477,8 +557,48 @@ namespace uStreamLib {
 		/* Global unique identifier generator */
 		SharedUint _counter;
 
+		/* Scheduler of blocks run as tasks (or NULL) */
+		TaskScheduler* _sched;
+
+		/* Workers of parallelFor() when blocks have threads (or NULL) */
+		TaskScheduler* volatile _pool;
+
+		/* flag: memory locked (see lockMemory()) */
+		bool _memLocked;
+
+		/* threads putting a message into a block (see _waitSenders()) */
+		volatile int32 _senders;
+
+		/* send a message by name (see sendMessage()) */
+		int32 _sendMessage(char* block_name, char* msg, smessage* sm,
+			bool wait);
+
+		/* wait for the senders which may have found a deleted block */
+		void _waitSenders(void);
+
+		/* processors of this machine (see placeBlocks()) */
+		CpuTopology* _topology;
+
 		/* method to build property descriptors */
 		void _buildPropertyDescriptions(void);
+
+		/* let idle buffer pools of all blocks give memory back */
+		void _releaseBuffers(void);
+
+		/* execute a control message, return its code */
+		int32 _runMessage(cmessage* cm);
+
+		/* prefault the buffer pool of an input pin */
+		int32 _prefault(DataPin* dp);
+
+		/* run placeBlocks() if USBM_AUTO_PLACEMENT is set */
+		void _autoPlace(void);
+
+		/* give a block its processors and its pools a node */
+		void _placeBlock(Block* b, uint64 cpus, uint32 node, bool numa);
+
+		/* unfuse the blocks of pins being connected or disconnected */
+		void _unfusePins(Pin* p1, Pin* p2);
 	};
 }
 
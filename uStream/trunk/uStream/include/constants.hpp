@@ -51,18 +51,33 @@
  * Default parameters.
  */
 
-/* Action scheduler timeout (in milliseconds) */
+/* Termination watchdog period (in milliseconds) */
 #define US_DEFAULT_BM_ASTIMEOUT		 10
 
 /* Plugin check timeout (in seconds) */
 #define US_DEFAULT_BM_PCTIMEOUT		 60
 
+/* Buffer pools housekeeping period (in milliseconds) */
+#define US_DEFAULT_BM_HKPERIOD		1000
+
 /* Logger level (from DEBUG to EMERG) */
 #define US_DEFAULT_BM_LOGLEVEL		 Logger::LEVEL_WARN
 
 /* Logger mode (one of FORCE or DEFER) */
 #define US_DEFAULT_BM_LOGMODE		 Logger::MODE_FORCE
 
+/* Task workers (0 means a thread per block, -1 one per processor) */
+#define US_DEFAULT_BM_TASKWORKERS		  0
+
+/* Stack size of block threads (0 means system default) */
+#define US_DEFAULT_BM_STACKSIZE		  0
+
+/* Lock memory and prefault buffer pools (0 or 1) */
+#define US_DEFAULT_BM_LOCKMEMORY		  0
+
+/* Place block threads on processors by topology (0 or 1) */
+#define US_DEFAULT_BM_AUTOPLACEMENT		  0
+
 /*
  * Numeric constants.
  */
@@ -85,13 +100,28 @@
 /* Block's status messages queue size */
 #define US_STATUS_QSZ				 50
 
-/* Count of hash buckets in I/O datapins tables */
+/* Distinct buffer pools a DataPin can share a buffer with in a send */
+#define US_DP_MAX_SHARED_POOLS			  8
+
+/* Max count of buffers a DataPin moves with a single delivery */
+#define US_DP_MAX_BATCH				 16
+
+/* Max count of control messages the BlockManager gets in one pass */
+#define US_CP_MAX_BATCH				 16
+
+/* Max sleep (ms) of a block which cannot be told about free buffers */
+#define US_BLOCK_POLL_MS			 10
+
+/* Max control messages or action rounds of a block run as a task */
+#define US_BLOCK_TASK_QUANTUM			 16
+
+/* Initial count of hash slots in I/O datapins tables */
 #define US_DPT_HSIZE				 37
 
-/* Count of hash buckets in ConfigTables (very high) */
+/* Initial count of hash slots in ConfigTables */
 #define US_CONFIGTABLE_HSIZE			 67
 
-/* Count of hash buckets in Blocks table */
+/* Initial count of hash slots in Blocks table */
 #define US_BLOCKTABLE_HSIZE 			 67
 
 /* Maximum number of logged lines (each line of 256 bytes)  */
@@ -113,6 +143,10 @@
 
 #define USBM_ACTIONSCHEDULER_TIMEOUT	   "uStream.SchedulerTimeout"
 #define USBM_LOGGER_LEVEL		"uStream.LoggerLevel"
+#define USBM_TASK_WORKERS		"uStream.TaskWorkers"
+#define USBM_STACK_SIZE		"uStream.StackSize"
+#define USBM_LOCK_MEMORY		"uStream.LockMemory"
+#define USBM_AUTO_PLACEMENT		"uStream.AutoPlacement"
 
 /*
  * Predefined for block (common to all blocks).
@@ -126,10 +160,52 @@
 #define USPL_O_PREFBUFCO	"PreferredBuffersCountO"
 #define USPL_O_QUEUESZ		"QueueSizeO"
 
+/*
+ * Predefined for pins (read when a wire allocates buffers).
+ */
+
+/* Buffer alignment: 0 (none), 64 (cache line) or 4096 (page) */
+#define USPN_BUFALIGN		"BufferAlignment"
+
+/* Non zero to carve buffers out of one contiguous region */
+#define USPN_CONTIGUOUS		"ContiguousBuffers"
+
+/* Non zero to back contiguous buffers with huge pages */
+#define USPN_HUGEPAGES		"HugePages"
+
+/* Count of buffers a pool can grow to (default: no growth) */
+#define USPN_MAXBUFCO		"MaxBuffersCount"
+
+/* What a wire does when the peer is full: see Wire::BackPressure */
+#define USPN_BACKPRESSURE	"BackPressure"
+
 /*
  * Predefined for block (common to all blocks).
  */
 
 #define USBL_DGSSKIP		 "_DGSSkip"
 
+/*
+ * Predefined for block threads (read when the thread starts).
+ */
+
+/* Processors the thread runs on, eg. "0-3,6" (default: any) */
+#define USBL_CPUSET		"CpuSet"
+
+/* Scheduling policy: 0 (default), 1 (SCHED_FIFO) or 2 (SCHED_RR) */
+#define USBL_SCHEDPOLICY	"SchedPolicy"
+
+/* Real time priority for SCHED_FIFO and SCHED_RR (1 to 99) */
+#define USBL_SCHEDPRIORITY	"SchedPriority"
+
+/* Niceness for the default policy (-20 to 19) */
+#define USBL_NICE		"Nice"
+
+/*
+ * Predefined for filters (read when the filter starts).
+ */
+
+/* Threads running Filter::transform() (default: 0, use the handlers) */
+#define USBL_REPLICAS		"Replicas"
+
 #endif
@@ -22,7 +22,7 @@
 #ifndef CONTROLPIN_HPP
 #define CONTROLPIN_HPP
 
-#include "priority_queue.hpp"
+#include "typed_mpsc_queue.hpp"
 #include "constants.hpp"
 #include "message.hpp"
 #include "pin.hpp"
@@ -34,8 +34,12 @@ namespace uStreamLib {
 	 * can be used to transmit/receive control messages (of type
 	 * message - which is a struct -) and chunks of data using
 	 * databuffers exchanged by mean of a buffer pool.
-	 * A ControlPin contains one priority queue used to exchange
-	 * control messages. This class is a bidirectional communication
+	 * A ControlPin receives control messages through lock-free lanes
+	 * which any thread can put into: out of band messages (negative
+	 * priority) come first, then the other messages in order, then
+	 * the data ready events of upstream blocks, which are counted
+	 * rather than queued so that they never take the room of control
+	 * messages (see notifyDataReady()). This class is a bidirectional communication
 	 * channel between two Blocks. Remember that you need a Wire to
 	 * connect two Pins. A Wire is used to exchange control data
 	 * chunks (not control messages) between blocks.
@@ -125,6 +129,39 @@ namespace uStreamLib {
 		 */
 		int32 tryRecvMessage(cmessage* m);
 
+		/**
+		 * Receive a message from the peer.
+		 * This method blocks until a message is received or the
+		 * timeout expires.
+		 * @param message structore to store the message into.
+		 * @param ms timeout in milliseconds.
+		 * @return SUCCESS or FAILURE if no message was received in time.
+		 */
+		int32 timedRecvMessage(cmessage* m, uint32 ms);
+
+		/**
+		 * Signal a wait set whenever a message is put into the
+		 * input queue of this control pin.
+		 * @param ws the wait set or NULL.
+		 * @param mask the bits to signal.
+		 */
+		void setWaitSet(WaitSet* ws, uint32 mask)
+		{
+			_ws = ws; _wsmask = mask;
+		}
+
+		/**
+		 * Tell the block of this pin that data is ready on one of
+		 * its inputs. Events are counted, up to the size of the
+		 * control queue, and got as Block::EVENT_DATA_READY messages
+		 * after the queued messages. Since events from several blocks
+		 * are merged, their from field is always NULL: poll every
+		 * input data pin. Any thread can call this method; it never
+		 * blocks.
+		 * @return SUCCESS or FAILURE if too many events are pending.
+		 */
+		int32 notifyDataReady(void);
+
 		/**
 		 * Put a message into the input queue for this control pin.
 		 * This method blocks untils the message is put.
@@ -134,8 +171,8 @@ namespace uStreamLib {
 		 */
 		int32 putMessage(cmessage* m, int32 priority = 0)
 		{
-			m->serial = _cmserial++;
-			return _iq.put((char *) m, sizeof(cmessage), priority);
+			m->serial = (uint32) Atomic::increment(&_cmserial);
+			return _put(m, priority, true);
 		}
 
 		/**
@@ -148,8 +185,8 @@ namespace uStreamLib {
 		 */
 		int32 tryPutMessage(cmessage* m, int32 priority = 0)
 		{
-			m->serial = _cmserial++;
-			return _iq.tryPut((char *) m, sizeof(cmessage), priority);
+			m->serial = (uint32) Atomic::increment(&_cmserial);
+			return _put(m, priority, false);
 		}
 
 		/**
@@ -161,7 +198,7 @@ namespace uStreamLib {
 		 */
 		int32 getMessage(cmessage* m)
 		{
-			return _iq.get((char *) m, sizeof(cmessage));
+			return _get(m, -1);
 		}
 
 		/**
@@ -174,7 +211,31 @@ namespace uStreamLib {
 		 */
 		int32 tryGetMessage(cmessage* m)
 		{
-			return _iq.tryGet((char *) m, sizeof(cmessage));
+			return _get(m, 0);
+		}
+
+		/**
+		 * Get the messages already queued in the input lanes for
+		 * this control pin, up to max, in the order getMessage()
+		 * would return them. This method is unblocking. This method
+		 * does not check if the pin is connected.
+		 * @param m array to store the messages into.
+		 * @param max size of the array.
+		 * @return the count of messages got (0 if none).
+		 */
+		uint32 tryGetMessages(cmessage* m, uint32 max);
+
+		/**
+		 * Get a message from the input queue for this control pin.
+		 * This method blocks until a message is got or the timeout
+		 * expires. This method does not check if the pin is connected.
+		 * @param m structure to store the message into.
+		 * @param ms timeout in milliseconds.
+		 * @return SUCCESS or FAILURE if no message was got in time.
+		 */
+		int32 timedGetMessage(cmessage* m, uint32 ms)
+		{
+			return _get(m, ms > 0x7fffffff ? 0x7fffffff : (int32) ms);
 		}
 	private:
 		/*
@@ -194,11 +255,41 @@ namespace uStreamLib {
 	  		int32 queuesz 	// queue size
 			);
 
-		/* input priority queue used to receive control messages */
-		PriorityQueue _iq;
+		/* input lane of out of band messages */
+		TypedMPSCQueue<cmessage> _oobq;
+
+		/* input lane of the other messages */
+		TypedMPSCQueue<cmessage> _iq;
+
+		/* data ready events pending and their max */
+		volatile int32 _ready;
+		int32 _readyMax;
+
+		/* flag: the consumer sleeps on _semItems */
+		volatile int32 _cwait;
+		Semaphore _semItems;
+
+		/* wait set signalled on put (or NULL) and its bits */
+		WaitSet* _ws;
+		uint32 _wsmask;
 
 		/* control message serial counter */
-		uint32 _cmserial;
+		volatile int32 _cmserial;
+
+		/* create the input lanes */
+		int32 _initLanes(int32 queuesz);
+
+		/* put a message into the lane for its priority */
+		int32 _put(cmessage* m, int32 priority, bool wait);
+
+		/* get a message (timeout: -1 forever, 0 no wait, or ms) */
+		int32 _get(cmessage* m, int32 timeout);
+
+		/* get the next message of the lanes, if any */
+		bool _take(cmessage* m);
+
+		/* wake up the consumer after a put */
+		void _notify(void);
 	};
 }
 
@@ -22,7 +22,9 @@
 #ifndef DATAPIN_HPP
 #define DATAPIN_HPP
 
-#include "priority_queue.hpp"
+#include "shared_queue.hpp"
+#include "typed_spsc_queue.hpp"
+#include "shm_channel.hpp"
 #include "constants.hpp"
 #include "message.hpp"
 #include "pin.hpp"
@@ -33,6 +35,9 @@ namespace uStreamLib {
 	 * to send/receive data messages from other Blocks. 
 	 * A data message transports buffer identifiers that allow
 	 * a block to get data chunks on the connecting wire.
+	 * While a pin has a single peer, data messages travel on a
+	 * lock-free single producer - single consumer ring; with more
+	 * peers the pin switches to a shared (locked) queue.
 	 */
 	class US_EXPORT DataPin : public Pin {
 	public:
@@ -88,11 +93,59 @@ namespace uStreamLib {
 		 * @param pri the priority of this buffer (0 = highest).
 		 * @param md avt_metadata to be filled correctly by source or filter.
 		 * @param di datainfo to be filled correctly by source or filter.
-		 * @return SUCCESS or FAILURE if peers' queue is full.
+		 * @return SUCCESS or FAILURE if the queue of a peer on a
+		 * blocking wire is full (or of every peer, if no wire is
+		 * blocking). On FAILURE, the peers which got the buffer get it
+		 * again if it is sent again.
 		 */
 		int32 trySendBuffer(DataBuf* buf, int32 pri = 0,
 			avt_metadata* md = NULL, datainfo* di = NULL);
 
+		/**
+		 * Send some buffers to all connected peers. Buffers are moved
+		 * in batches: one lock of the peers, one queue reservation
+		 * and one wakeup for each peer and batch.
+		 * This method blocks until each peer got the buffers.
+		 * @param bufs the buffers to send.
+		 * @param n count of buffers.
+		 * @param pri the priority of these buffers (0 = highest).
+		 * @param md avt_metadata for each buffer.
+		 * @param di datainfo for each buffer.
+		 * @return SUCCESS or FAILURE if a buffer is empty.
+		 */
+		int32 sendBuffers(DataBuf** bufs, uint32 n, int32 pri = 0,
+			avt_metadata* md = NULL, datainfo* di = NULL);
+
+		/**
+		 * Get a buffer to fill with output data. The buffer belongs
+		 * to the buffer pool of a peer, so committing it delivers data
+		 * to the peers using that pool without any copy. Other peers
+		 * get a copy. Call commitOutputBuffer() or abortOutputBuffer()
+		 * when done. Only the thread of the owner block should use
+		 * this method.
+		 * @param wait if true, wait for a free buffer.
+		 * @return the buffer to fill or NULL if the pin is unconnected
+		 * or no buffer is available.
+		 */
+		DataBuf* acquireOutputBuffer(bool wait = true);
+
+		/**
+		 * Send the buffer got by acquireOutputBuffer() to all
+		 * connected peers.
+		 * @param md avt_metadata to fill correctly by source or filter.
+		 * @param di datainfo to fill correctly by source or filter.
+		 * @param wait if true, wait for room in peers' queues.
+		 * @return SUCCESS or FAILURE if no peer got the buffer.
+		 */
+		int32 commitOutputBuffer(avt_metadata* md = NULL, datainfo* di = NULL,
+			bool wait = true);
+
+		/**
+		 * Give back the buffer got by acquireOutputBuffer()
+		 * without sending it.
+		 */
+		void abortOutputBuffer(void);
+
 		/**
 		 * Send a message to the peers waiting for delivery.
 		 * This method blocks until the message is delivered.
@@ -128,8 +181,93 @@ namespace uStreamLib {
 		 * @return SUCCESS or FAILURE if no message can be received now.
 		 */
 		int32 tryRecvMessage(dmessage* m);
+
+		/**
+		 * Receive some messages from the peers.
+		 * This method blocks until a message is received, then gets
+		 * the messages already queued, up to max.
+		 * @param m array to store the messages into.
+		 * @param max size of the array.
+		 * @return the count of messages received or FAILURE if the
+		 * pin is unconnected.
+		 */
+		int32 recvMessages(dmessage* m, uint32 max);
+
+		/**
+		 * Receive the messages already queued, up to max.
+		 * It is non blocking.
+		 * @param m array to store the messages into.
+		 * @param max size of the array.
+		 * @return the count of messages received (0 if none) or
+		 * FAILURE if the pin is unconnected.
+		 */
+		int32 tryRecvMessages(dmessage* m, uint32 max);
+
+		/**
+		 * Get the bit set in the result of Block::waitAny() when
+		 * data arrives on this input pin.
+		 * @return the bit or 0 for output pins.
+		 */
+		uint32 getWaitMask(void)
+		{
+			return _wmask;
+		}
+
+		/**
+		 * Get the count of messages waiting in the input queue.
+		 * @return the count of queued messages.
+		 */
+		int32 getQueuedCount(void)
+		{
+			return _rq.getCount() + _iq.getCount();
+		}
+
+		/**
+		 * Move data through a channel shared with another process
+		 * instead of wires. An output pin sends buffers to the
+		 * channel: acquireOutputBuffer() and commitOutputBuffer()
+		 * fill buffers in place without copies, the other send
+		 * methods copy data once. An input pin receives buffers
+		 * from the channel and reads them in place. No event
+		 * reaches the blocks of the other process: the receiving
+		 * block waits for data in recvMessage() (see
+		 * ShmChannel::wakeConsumer() to stop waiting).
+		 * The channel must have been created with the meta size
+		 * returned by getChannelMetaSize() and must live while it is
+		 * attached. Only the thread of the owner block should send
+		 * or receive.
+		 * @param ch the channel or NULL to detach the current one.
+		 * @return SUCCESS or FAILURE if the pin is connected to
+		 * peers, has a pending output buffer or the channel does
+		 * not fit.
+		 */
+		int32 attachChannel(ShmChannel* ch);
+
+		/**
+		 * Get the channel attached to this pin.
+		 * @return the channel or NULL.
+		 */
+		ShmChannel* getChannel(void)
+		{
+			return _shm;
+		}
+
+		/**
+		 * Get the size of the metadata a channel must carry to
+		 * be attached to a data pin.
+		 */
+		static uint32 getChannelMetaSize(void)
+		{
+			return sizeof(avt_metadata) + sizeof(datainfo);
+		}
 	
 	protected:
+		/**
+		 * Select the input queue according to the count of peers.
+		 * Invoked by the Wire with this pin locked.
+		 */
+		void peersChanged(void);
+
 		/**
 		 * Build a DataPin. The accepted parameters must be set
 		 * using some tuning criteria.
@@ -155,8 +293,80 @@ namespace uStreamLib {
 		{
 		}
 
-		/* input priority queue used to receive messages */
+		/* input queue used to receive messages from many peers */
 		SharedQueue _iq;
+
+		/* input queue used to receive messages from a single peer */
+		TypedSPSCQueue<dmessage> _rq;
+
+		/* flag: messages are put into _rq (single peer) */
+		volatile int32 _spsc;
+
+		/* flag: switch to _rq once _iq is empty */
+		volatile int32 _wantSpsc;
+
+		/* bit signalled to the block when data arrives */
+		uint32 _wmask;
+
+		/*
+		 * Put a message into the input queue of this pin. The caller
+		 * must hold this pin's lock.
+		 */
+		int32 _put(dmessage* m, bool wait);
+
+		/*
+		 * Put some messages into the input queue of this pin. The
+		 * caller must hold this pin's lock. Returns the count put.
+		 */
+		uint32 _putMany(dmessage* m, uint32 n, bool wait);
+
+		/* get the queued messages, up to n */
+		uint32 _getMany(dmessage* m, uint32 n);
+
+		/*
+		 * Switch to _rq if asked by peersChanged() and no message
+		 * is left in _iq. Called by the consumer.
+		 */
+		void _trySwitch(void);
+
+		/*
+		 * Drop up to n queued messages, oldest first, and free their
+		 * buffers, counting them on w. The caller must hold this
+		 * pin's lock. Returns the count evicted.
+		 */
+		uint32 _evict(uint32 n, Wire* w);
+
+		/* get the max count of buffers to deliver at once */
+		uint32 _maxBatch(void);
+
+		/* buffer got by acquireOutputBuffer() and its pool */
+		DataBuf* _obuf;
+		BufferPool* _obp;
+
+		/* channel shared with another process (or NULL) */
+		ShmChannel* _shm;
+
+		/* copy a buffer into the channel and commit it */
+		int32 _sendToChannel(DataBuf* buf, avt_metadata* md, datainfo* di,
+			bool wait);
+
+		/* commit a channel buffer with its metadata */
+		int32 _commitToChannel(DataBuf* buf, avt_metadata* md, datainfo* di);
+
+		/* receive a message from the channel */
+		int32 _recvFromChannel(dmessage* m, bool wait);
+
+		/*
+		 * Deliver up to US_DP_MAX_BATCH buffers to each peer. Peers
+		 * sharing a buffer pool get the same buffers. If bp is not NULL,
+		 * bufs belong to bp and the caller's references are dropped.
+		 * Returns the count of peers reached on blocking wires, 0 if
+		 * one of them missed a buffer, or the count of peers reached
+		 * if no wire is blocking: peers on lossy wires always accept
+		 * buffers, so they must not hide a loss on the others.
+		 */
+		int32 _deliver(DataBuf** bufs, uint32 n, BufferPool* bp,
+			avt_metadata* md, datainfo* di, bool wait);
 	};
 }
 
@@ -23,6 +23,7 @@
 #define FILTER_HPP
 
 #include "block.hpp"
+#include "typed_spsc_queue.hpp"
 
 namespace uStreamLib {
 	/**
@@ -76,8 +77,92 @@ namespace uStreamLib {
 				int32 queuesz = US_CP_QUEUESZ  // control pin's queue size
 		);
 
+		/**
+		 * Task entry point: run the filter for a while (see
+		 * Block::step()).
+		 */
+		int32 step(void);
+
+		/**
+		 * Run the action handlers once for the upstream fused block
+		 * (see Block::fuse()).
+		 */
+		bool fusedRound(void);
+
+		/**
+		 * Transform one input buffer into one output buffer. Filters
+		 * whose work on a buffer does not depend on the other
+		 * buffers (eg. format or colorspace conversions) override
+		 * this method to run on several threads at once: set
+		 * USBL_REPLICAS before the start request. Input buffers of
+		 * the only input pin are then handed out to the least loaded
+		 * replica thread and output buffers are sent on the only
+		 * output pin in input order; the action handlers are not
+		 * invoked. This method is called by many threads together:
+		 * state shared between calls needs locks.
+		 * @param m the data message (seq tells the input order).
+		 * Its avt_metadata and datainfo are sent along with the
+		 * output buffer and may be changed.
+		 * @param in the input buffer.
+		 * @param out the output buffer, empty: fill it (see
+		 * DataBuf::xcopy()) or leave it empty to send nothing.
+		 * @return BlockHandler::HSUCCESS, HFAILURE or HCRITICAL.
+		 */
+		virtual int32 transform(dmessage* /* m */, DataBuf* /* in */,
+			DataBuf* /* out */)
+		{
+			return Block::HANDLER_UNDEFINED;
+		}
 
 	private:
+		/*
+		 * A buffer handed out to a replica.
+		 */
+		struct Job {
+			/* the data message and the output buffer */
+			dmessage m;
+			DataBuf out;
+
+			/* transform() return value */
+			int32 ret;
+
+			/* flag: transform() done */
+			volatile int32 done;
+		};
+
+		/*
+		 * A thread running transform() on the buffers handed out by
+		 * the filter (see USBL_REPLICAS).
+		 */
+		class Replica : public Thread {
+		public:
+			Replica(Filter* f)
+				: _filter(f), _pending(0), _quit(false)
+			{
+			}
+
+			int32 init(char* name, uint32 window);
+
+			void run(void);
+
+			/* stop the thread (the destructor waits for it) */
+			void stop(void);
+
+			/* hand out a buffer */
+			void push(uint32 job);
+
+			/* count of buffers handed out and not transformed */
+			int32 getPending(void)
+			{
+				return Atomic::load(&_pending);
+			}
+
+		private:
+			Filter* _filter;
+			TypedSPSCQueue<uint32> _queue;
+			volatile int32 _pending;
+			volatile bool _quit;
+		};
 
 		/*
 				 * Other constructors.
@@ -100,6 +185,67 @@ namespace uStreamLib {
 
 		/* quit semaphore */
 		Semaphore _quitSem;
+
+		/* flag: the action handlers would block */
+		bool _wouldBlock;
+
+		/* flag: data ready to be consumed */
+		bool _dataReady;
+
+		/* flag: the last round consumed data */
+		bool _consumed;
+
+		/* serialize action rounds (fused blocks run them too) */
+		Mutex _mutexRound;
+
+		/* replicas running transform() (see USBL_REPLICAS) */
+		Replica** _replicas;
+		uint32 _replicasCount;
+
+		/* buffers handed out, by sequence number modulo _window */
+		Job* _jobs;
+		uint32 _window;
+
+		/* sequence numbers of the next buffer to hand out and to send */
+		uint32 _issued;
+		uint32 _sent;
+
+		/* the pins of a replicated filter */
+		DataPin* _rin;
+		DataPin* _rout;
+
+		/* flag: USBL_REPLICAS has been read */
+		bool _replicasChecked;
+
+		/* start the replicas if USBL_REPLICAS asks for them */
+		void _startReplicas(void);
+
+		/* stop the replicas and free the buffers still handed out */
+		void _stopReplicas(void);
+
+		/* send transformed buffers and hand out new ones */
+		bool _actReplicas(void);
+
+		/* transform a buffer (called by replicas) */
+		void _runJob(uint32 job);
+
+		/* give back the input buffer of a job not transformed */
+		void _dropJob(uint32 job);
+
+		/* handle a control message (if any) and run the action handlers */
+		void _runOnce(cmessage* cm);
+
+		/* run the action handlers (true if fused blocks consumed data) */
+		bool _act(void);
+
+		/* this block runs its own action handlers */
+		bool _acts(void)
+		{
+			return _started && !getFusedPrev();
+		}
+
+		/* release the quit semaphore and notify the block manager */
+		void _quitting(void);
 	};
 }
 
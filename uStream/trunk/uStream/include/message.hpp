@@ -88,6 +88,10 @@ namespace uStreamLib {
 
 		/** sender pin of this message */
 		Pin* from_pin;
+
+		/** sequence number (set by replicated filters, see
+		    Filter::transform()) */
+		uint32 seq;
 	};
 
 	typedef struct dmessage_t dmessage;
@@ -282,6 +282,9 @@ namespace uStreamLib {
 		 * This method returns a databuf whose bid is specified as
 		 * parameter. The returned databuf is ready for reading and
 		 * has certainly been sent by the peer data pin.
+		 * When the peer sends to more pins sharing this buffer pool,
+		 * the same databuf is delivered to each of them: treat it as
+		 * read only.
 		 * @param bid the buffer identifier of the requested buffer.
 		 * @return the requested databuf or NULL if databuf cannot
 		 * be returned.
@@ -295,6 +298,15 @@ namespace uStreamLib {
 			return retval;
 		}
 
+		/**
+		 * Get the buffer pool of this pin's input buffers.
+		 * @return the buffer pool or NULL if not connected.
+		 */
+		BufferPool* getInputBufferPool(void)
+		{
+			return _ibp;
+		}
+
 		/**
 		 * Free the specified input buffer.
 		 * This method must be invoked when an input buffer as been
@@ -361,6 +373,27 @@ namespace uStreamLib {
 		{
 		}
 
+		/**
+		 * This method is invoked by the Wire, with this pin locked,
+		 * after a peer has been connected or disconnected. Derived
+		 * pins override it to adapt to the new set of peers.
+		 */
+		virtual void peersChanged(void)
+		{
+		}
+
+		/**
+		 * Make this pin read its input buffers from a buffer pool
+		 * it does not share with any wire (eg. the view of a
+		 * ShmChannel). The pin must be unconnected.
+		 * @param bp the buffer pool or NULL.
+		 */
+		void setInputBufferPool(BufferPool* bp)
+		{
+			_ibp = bp;
+			_bpSet = (bp != NULL);
+		}
+
 		/**
 		 * Get next free buffer.
 		 * This method blocks until a buffer is available.
@@ -75,6 +75,12 @@ namespace uStreamLib {
 						int32 queuesz = US_CP_QUEUESZ  // control pin's queue size
 		);
 
+		/**
+		 * Task entry point: run the sink for a while (see
+		 * Block::step()).
+		 */
+		int32 step(void);
+
 
 	private:
 		/*
@@ -92,6 +98,15 @@ namespace uStreamLib {
 
 		/* quit semaphore */
 		Semaphore _quitSem;
+
+		/* flag: data ready to be consumed */
+		bool _dataReady;
+
+		/* handle a control message (if any) and run the action handlers */
+		void _runOnce(cmessage* cm);
+
+		/* release the quit semaphore and notify the block manager */
+		void _quitting(void);
 	};
 }
 
@@ -60,6 +60,42 @@ namespace uStreamLib {
 				 */
 		void run(void);
 
+		/**
+		 * Pace this source: the ACTION_DATA_PRODUCE handler runs
+		 * once per period, on deadlines of the monotonic clock
+		 * counted from the start request, instead of as fast as it
+		 * returns. Deadlines are added up exactly, so production
+		 * does not drift. Deadlines missed by more than a period
+		 * are skipped and counted as overruns (see getOverruns()).
+		 * Call it before the start request or from the action
+		 * handlers of this source.
+		 * @param ns the period in nanoseconds (0 stops pacing).
+		 */
+		void setPeriod(uint64 ns)
+		{
+			setRate(1000000000, ns);
+		}
+
+		/**
+		 * Pace this source at a media rate (see setPeriod()), eg.
+		 * an audio period of frames samples at rate samples per
+		 * second, or a video frame (frames = 1) at rate frames
+		 * per second.
+		 * @param rate units per second.
+		 * @param frames units produced per period (0 stops pacing).
+		 */
+		void setRate(uint32 rate, uint64 frames);
+
+		/**
+		 * Get the count of periods skipped because the source was
+		 * late.
+		 * @return the count of overruns since init().
+		 */
+		uint32 getOverruns(void)
+		{
+			return _overruns;
+		}
+
 	protected:
 		/**
 			 * Build a source. A source inherits from Block.
@@ -76,6 +112,12 @@ namespace uStreamLib {
 				int32 queuesz = US_CP_QUEUESZ  // control pin's queue size
 		);
 
+		/**
+		 * Task entry point: run the source for a while (see
+		 * Block::step()).
+		 */
+		int32 step(void);
+
 	private:
 		/*
 			* Other constructors.
@@ -92,6 +134,41 @@ namespace uStreamLib {
 
 		/* quit semaphore */
 		Semaphore _quitSem;
+
+		/* flag: the action handler would block */
+		bool _wouldBlock;
+
+		/* pacing period: _period + _periodRem / _periodDen ns */
+		uint64 _period;
+		uint64 _periodRem;
+		uint64 _periodDen;
+
+		/* fractions of ns added up so far (less than _periodDen) */
+		uint64 _periodAcc;
+
+		/* next deadline (monotonic ns, 0 when not started) */
+		uint64 _next;
+
+		/* skipped periods */
+		uint32 _overruns;
+
+		/* check if the source is paced and early */
+		bool _early(void);
+
+		/* move the deadline on when it passed: true if it did */
+		bool _tick(void);
+
+		/* sleep until the deadline or a control message */
+		int32 _waitTick(cmessage* cm);
+
+		/* handle a control message (if any) and run the action handlers */
+		void _runOnce(cmessage* cm);
+
+		/* run the action handler (and the fused blocks' ones) */
+		void _act(void);
+
+		/* release the quit semaphore and notify the block manager */
+		void _quitting(void);
 	};
 }
 
@@ -26,6 +26,7 @@
 #include "sharedvars.hpp"
 #include "constants.hpp"
 #include "types.hpp"
+#include "atomic.hpp"
 
 namespace uStreamLib {
 	/*
@@ -52,6 +53,25 @@ namespace uStreamLib {
 		UNIDIRECTIONAL = 0, /** the wire is bidirectional */
 		BIDIRECTIONAL = 1 };
 
+		/**
+		 * What the wire does when the peer pin has no free buffers
+		 * or its queue is full (see USPN_BACKPRESSURE).
+		 */
+		enum BackPressure { /** wait for the peer (default) */
+		BP_BLOCK = 0, /** drop the data being sent */
+		BP_DROP_NEWEST = 1, /** drop the oldest queued data */
+		BP_DROP_OLDEST = 2, /** queue only the data just sent */
+		BP_KEEP_LATEST = 3 };
+
+		/**
+		 * Why data has been dropped on the wire.
+		 */
+		enum DropCause { /** no free buffer in the peer's pool */
+		DROP_NO_BUFFER = 0, /** the peer's queue was full */
+		DROP_QUEUE_FULL = 1, /** queued data evicted by newer data */
+		DROP_EVICTED = 2, /** count of causes */
+		DROP_CAUSES = 3 };
+
 		/**
 		 * Constructor.
 		 */
@@ -74,7 +94,9 @@ namespace uStreamLib {
 		 * Connect two pins. If one of the two pins is already connected
 		 * to another pin using another Wire, this method shares the
 		 * same buffer pool of connected pin. This behaviour allows point
-		 * to multipoint connections.
+		 * to multipoint connections: the input pins fed by the same output
+		 * pin share one buffer pool, so each buffer is filled once and
+		 * reference counted by its consumers.
 		 * If unidirectional, data flows from p1 to p2.
 		 * @param b1 the block whose pin we wish to connect to.
 		 * @param p1 the first pin.
@@ -104,6 +126,59 @@ namespace uStreamLib {
 			return (which <= 1 ? _bp1 : _bp2);
 		}
 
+		/**
+		 * Get the back-pressure policy of this wire.
+		 * @return one of BackPressure.
+		 */
+		int32 getBackPressure(void)
+		{
+			return Atomic::load(&_policy);
+		}
+
+		/**
+		 * Set the back-pressure policy of this wire. The policy is
+		 * read from the USPN_BACKPRESSURE property of the pins when
+		 * they are connected: then a wire which drops data gets a
+		 * buffer pool of its own instead of sharing the one of its
+		 * siblings.
+		 * @param policy one of BackPressure.
+		 * @return SUCCESS or FAILURE if policy is unknown or the
+		 * wire is not connected.
+		 */
+		int32 setBackPressure(int32 policy);
+
+		/**
+		 * Get the count of data dropped on this wire.
+		 * @param cause one of DropCause.
+		 * @return the count of drops for cause.
+		 */
+		int32 getDropCount(int32 cause)
+		{
+			if (cause < 0 || cause >= DROP_CAUSES)
+				return 0;
+			return Atomic::load(&_drops[cause]);
+		}
+
+		/**
+		 * Account for data dropped on this wire.
+		 * @param cause one of DropCause.
+		 * @param n count of drops.
+		 */
+		void countDrop(int32 cause, int32 n = 1)
+		{
+			if (cause >= 0 && cause < DROP_CAUSES && n > 0)
+				Atomic::add(&_drops[cause], n);
+		}
+
+		/**
+		 * Reset the drop counters of this wire.
+		 */
+		void resetDropCounters(void)
+		{
+			for (int32 i = 0; i < DROP_CAUSES; i++)
+				Atomic::store(&_drops[i], 0);
+		}
+
 		/**
 		 * Get error string.
 		 * @return a string.
@@ -145,8 +220,21 @@ namespace uStreamLib {
 		/* flag: multipoint connection on bp2 */
 		bool _multipoint_on_bp2;
 
+		/* back-pressure policy */
+		volatile int32 _policy;
+
+		/* drop counters by cause */
+		volatile int32 _drops[DROP_CAUSES];
+
 		/* allocate buffers */
 		int32 _allocate(void);
+
+		/* get an integer pin property, from pin2 first */
+		int32 _getPinProperty(char* key);
+
+		/* get buffer pool allocation options from pin properties */
+		void _getAllocOptions(DataBuf::AllocStrategy* strategy,
+			uint32* flags);
 	};
 }
 
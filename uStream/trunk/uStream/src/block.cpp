@@ -21,6 +21,8 @@
 
 #include <ctype.h>
 
+#include "timer.hpp"
+#include "cpu_topology.hpp"
 #include "block.hpp"
 #include "block_manager.hpp"
 
@@ -50,6 +52,20 @@ namespace uStreamLib {
 		// nothing to do
 	}
 
+	int32 BlockHandler::parallelFor(uint32 begin, uint32 end, uint32 grain,
+		LoopBody* body)
+	{
+		uint64 cpus = _block->getAffinity();
+		uint32 threads = 0;
+
+		// as many threads as processors the block may run on
+		for (; cpus; cpus &= cpus - 1)
+			threads++;
+
+		return _block->getBlockManager()->parallelFor(begin, end, grain, body,
+			threads);
+	}
+
 	StatusListener::StatusListener(Block* b)
 		: Object(UOSUTIL_RTTI_STATUS_LISTENER), _block(b)
 	{
@@ -91,7 +107,9 @@ namespace uStreamLib {
 	char* Block::_cmdstrings[Block::EVENT_HANDLERS_TABLE_SIZE];
 
 	Block::Block(void)
-		: _bm(NULL)
+		: _bm(NULL), _wsOutput(&_ws, WAIT_OUTPUT), _deadline(0),
+		_starved(NULL), _task(this), _armed(false), _fusedNext(NULL),
+		_fusedPrev(NULL)
 	{
 		// nothing to do
 	}
@@ -101,6 +119,9 @@ namespace uStreamLib {
 		// DEBUG
 		UOSUTIL_DOUT(("~Block(): entered\n"));
 
+		// leave fused chains
+		unfuse();
+
 		// destroy callbacks
 		destroyHandlers();
 
@@ -108,12 +129,7 @@ namespace uStreamLib {
 		destroyPins();
 
 		// delete wires for control pins
-		Enumeration* ew = _cp.getWires();
-		while (ew->hasMoreElements()) {
-			Wire* w = (Wire*) ew->nextElement();
-			if (w)
-				delete w;
-		}
+		_unwire(&_cp);
 
 		// DEBUG
 		UOSUTIL_DOUT(("~Block(): exited\n"));
@@ -122,13 +138,19 @@ namespace uStreamLib {
 	int32 Block::init(BlockManager* bm, char* name, uint32 bufsz,
 		uint32 bufcount, int32 queuesz)
 	{
+		TaskScheduler* sched = bm ? bm->getScheduler() : NULL;
 		int32 ret = 0, i = 0;
 
 		// initialize members
 		_bm = bm;
 
-		// initialize thread
-		ret = Thread::init(name);
+		// stack size, unless a subclass chose it
+		if (bm && !getStackSize() &&
+			bm->getInt(USBM_STACK_SIZE, &i) == SUCCESS && i > 0)
+			setStackSize((uint32) i);
+
+		// initialize thread (tasks need no system thread)
+		ret = Thread::init(name, !sched);
 		if (ret == FAILURE)
 			return FAILURE;
 
@@ -150,11 +172,31 @@ namespace uStreamLib {
 		if (ret == FAILURE)
 			return FAILURE;
 
+		// create wait set
+		ret = _ws.init();
+		if (ret == FAILURE)
+			return FAILURE;
+
+		// as a task, run whenever the wait set gets signalled
+		if (sched) {
+			ret = _task.init(name);
+			if (ret == FAILURE)
+				return FAILURE;
+
+			ret = sched->add(&_task);
+			if (ret == FAILURE)
+				return FAILURE;
+
+			_ws.setCallBack(&_task);
+		}
+
 		// create control pin
 		ret = _cp.init(this, bufsz, bufcount, queuesz);
 		if (ret == FAILURE)
 			return FAILURE;
 
+		_cp.setWaitSet(&_ws, WAIT_CONTROL);
+
 		// create table for input data pins
 		ret = _idp.init(US_DPT_HSIZE);
 		if (ret == FAILURE)
@@ -193,7 +235,7 @@ namespace uStreamLib {
 	{
 		DataPin* dp = NULL;
 		char tmp[4096];
-		int32 ret = 0;
+		int32 ret = 0, i = 0;
 
 		dp = new DataPin();
 		if (!dp)
@@ -225,6 +267,12 @@ namespace uStreamLib {
 				// fail
 				return NULL;
 			}
+
+			// the pin signals its own bit (the last one is shared)
+			i = _idp.getCount() - 1;
+			dp->_wmask = (uint32) WAIT_INPUT << (i < 28 ? i : 28);
+			dp->_iq.setWaitSet(&_ws, dp->_wmask);
+			dp->_rq.setWaitSet(&_ws, dp->_wmask);
 			break;
 		case Pin::DIR_OUTPUT:
 			ret = _odp.pput(dp->getName(), (char *) dp);
@@ -409,6 +457,19 @@ namespace uStreamLib {
 	{
 		Enumeration* en = NULL;
 
+		/*
+		 * Disconnect pins before deleting them: peers running meanwhile
+		 * must not find them. Wires check pins with belongs(), which
+		 * locks the pins tables, so this is done without locks.
+		 */
+		en = _idp.values();
+		while (en->hasMoreElements())
+			_unwire((Pin *) en->nextElement());
+
+		en = _odp.values();
+		while (en->hasMoreElements())
+			_unwire((Pin *) en->nextElement());
+
 		// lock input pins table
 		_idp.lock();
 
@@ -432,6 +493,36 @@ namespace uStreamLib {
 		_odp.unlock();
 	}
 
+	void Block::_unwire(Pin* p)
+	{
+		Enumeration* ew = NULL;
+		Wire** w = NULL;
+		uint32 n = 0, i = 0;
+
+		// pins enumerate their wires while disconnecting: copy them first
+		p->lockTable(Pin::WIRES_TABLE);
+
+		ew = p->getWires();
+		n = ew->getCount();
+		if (n)
+			w = new Wire * [n];
+
+		for (i = 0; w && i < n; i++)
+			w[i] = (Wire *) ew->nextElement();
+
+		p->unlockTable(Pin::WIRES_TABLE);
+
+		if (!w)
+			return;
+
+		for (i = 0; i < n; i++) {
+			if (w[i])
+				delete w[i];
+		}
+
+		delete[] w;
+	}
+
 	void Block::destroyHandlers(void)
 	{
 		int32 i = 0;
@@ -449,10 +540,7 @@ namespace uStreamLib {
 
 	int32 Block::notifyPeersOf(DataPin* dp)
 	{
-		cmessage cm;
-
 		dp->lockTable(Pin::PEERS_TABLE);
-		memset(&cm, 0, sizeof(cmessage));
 
 		Enumeration* peers = dp->getPeers();
 		while (peers->hasMoreElements()) {
@@ -461,10 +549,11 @@ namespace uStreamLib {
 			Block* b = dpi->getBlock();
 			ControlPin* cp = b->getControlPin();
 
-			cm.code = EVENT_DATA_READY;
-			cm.from = this;
+			// fused blocks run right after this one
+			if (b == getFusedNext())
+				continue;
 
-			cp->tryPutMessage(&cm);
+			cp->notifyDataReady();
 		}
 
 		dp->unlockTable(Pin::PEERS_TABLE);
@@ -473,6 +562,350 @@ namespace uStreamLib {
 		return SUCCESS;
 	}
 
+	void Block::wakeUp(void)
+	{
+		_ws.signal(WAIT_WAKEUP);
+	}
+
+	void Block::wakeUpAfter(uint32 ms)
+	{
+		_deadline = Timer::getMonotonicTime() + (uint64) ms * 1000;
+	}
+
+	uint32 Block::waitAny(int32 timeout)
+	{
+		uint32 bits = 0;
+		bool ready = false;
+
+		// a task must not keep its worker
+		if (isTask())
+			timeout = 0;
+
+		// free buffers cannot be waited for: poll
+		if (_armPools(true, &ready) == FAILURE &&
+			(timeout < 0 || timeout > US_BLOCK_POLL_MS))
+			timeout = US_BLOCK_POLL_MS;
+
+		if (ready)
+			_ws.signal(WAIT_OUTPUT);
+
+		bits = _ws.wait(timeout);
+
+		_armPools(false, NULL);
+
+		return bits;
+	}
+
+	void Block::prepare(void)
+	{
+		Logger* l = _bm ? _bm->getLogger() : NULL;
+		int32 policy = POLICY_DEFAULT, priority = 0, nice = 0;
+		uint64 cpus = 0;
+		char* s = NULL;
+
+		if (getString(USBL_CPUSET, &s) == SUCCESS && s && *s) {
+			if (CpuTopology::parseList(s, &cpus) == FAILURE ||
+				setAffinity(cpus) == FAILURE) {
+				if (l)
+					l->log(Logger::LEVEL_WARN,
+						"%s: cannot run on processors %s", getName(), s);
+			}
+		}
+
+		if (getInt(USBL_SCHEDPOLICY, &policy) == SUCCESS &&
+			policy != POLICY_DEFAULT) {
+			getInt(USBL_SCHEDPRIORITY, &priority);
+			if (setScheduling(policy, priority) == FAILURE) {
+				if (l)
+					l->log(Logger::LEVEL_WARN,
+						"%s: cannot set scheduling policy %d (priority %d)",
+						getName(), policy, priority);
+			}
+		}
+
+		if (getInt(USBL_NICE, &nice) == SUCCESS &&
+			setNice(nice) == FAILURE) {
+			if (l)
+				l->log(Logger::LEVEL_WARN, "%s: cannot set niceness %d",
+					getName(), nice);
+		}
+	}
+
+	int32 Block::waitForControlMessage(cmessage* cm)
+	{
+		uint64 now = 0;
+		int32 timeout = -1;
+
+		// messages may be queued already
+		if (_cp.tryRecvMessage(cm) == SUCCESS)
+			return SUCCESS;
+
+		if (_deadline) {
+			now = Timer::getMonotonicTime();
+			if (_deadline <= now) {
+				_deadline = 0;
+				return FAILURE;
+			}
+
+			timeout = (int32) ((_deadline - now + 999) / 1000);
+		}
+
+		// something happened while the handlers were running
+		if (waitAny(timeout) & WAIT_CONTROL)
+			return _cp.tryRecvMessage(cm);
+
+		return FAILURE;
+	}
+
+	int32 Block::fuse(void)
+	{
+		DataPin* in = NULL, * out = NULL;
+		Block* up = NULL, * b = NULL;
+		uint32 outs = 0, peers = 0;
+
+		if (getType() != TYPE_FILTER || getFusedPrev())
+			return FAILURE;
+
+		// one input pin...
+		lockTable(INPUT_TABLE);
+		if (_idp.getCount() == 1)
+			in = (DataPin *) getInputPins()->nextElement();
+		unlockTable(INPUT_TABLE);
+
+		if (!in || in->getChannel())
+			return FAILURE;
+
+		// ...with one peer...
+		in->lockTable(Pin::PEERS_TABLE);
+		if (in->getPeersCount() == 1)
+			out = (DataPin *) in->getPeers()->nextElement();
+		in->unlockTable(Pin::PEERS_TABLE);
+
+		if (!out || out->getChannel())
+			return FAILURE;
+
+		up = out->getBlock();
+		if (up == this || up->getType() == TYPE_SINK || up->getFusedNext())
+			return FAILURE;
+
+		// ...whose block feeds this block only
+		up->lockTable(OUTPUT_TABLE);
+		outs = up->_odp.getCount();
+		up->unlockTable(OUTPUT_TABLE);
+
+		out->lockTable(Pin::PEERS_TABLE);
+		peers = out->getPeersCount();
+		out->unlockTable(Pin::PEERS_TABLE);
+
+		if (outs != 1 || peers != 1)
+			return FAILURE;
+
+		// no loops
+		for (b = up; b; b = b->getFusedPrev()) {
+			if (b == this)
+				return FAILURE;
+		}
+
+		Atomic::storePtr(&_fusedPrev, up);
+		Atomic::storePtr(&up->_fusedNext, this);
+
+		// data may be waiting already
+		wakeFusedHead();
+
+		// ok
+		return SUCCESS;
+	}
+
+	void Block::unfuse(void)
+	{
+		Block* b = NULL;
+
+		// the downstream block runs on its own again
+		b = (Block *) Atomic::exchangePtr(&_fusedNext, NULL);
+		if (b) {
+			Atomic::storePtr(&b->_fusedPrev, NULL);
+			b->_kick();
+		}
+
+		// and so does this one
+		b = (Block *) Atomic::exchangePtr(&_fusedPrev, NULL);
+		if (b) {
+			Atomic::storePtr(&b->_fusedNext, NULL);
+			_kick();
+		}
+	}
+
+	void Block::wakeFusedHead(void)
+	{
+		Block* b = this, * prev = NULL;
+
+		while ((prev = b->getFusedPrev()) != NULL)
+			b = prev;
+
+		b->wakeUp();
+	}
+
+	void Block::_kick(void)
+	{
+		cmessage cm;
+
+		// a wake up message stops blocking receives too
+		memset(&cm, 0, sizeof(cmessage));
+		cm.code = EVENT_WAKEUP;
+		cm.from = this;
+
+		_cp.tryPutMessage(&cm);
+	}
+
+	int32 Block::step(void)
+	{
+		run();
+		return Task::TASK_DONE;
+	}
+
+	int32 Block::idleStep(void)
+	{
+		uint64 now = Timer::getMonotonicTime(), when = 0, poll = 0;
+		bool ready = false;
+
+		if (_deadline) {
+			if (_deadline <= now) {
+				_deadline = 0;
+				return Task::TASK_READY;
+			}
+
+			when = _deadline;
+		}
+
+		// free buffers cannot be waited for: poll
+		_armed = true;
+		if (_armPools(true, &ready) == FAILURE) {
+			poll = now + US_BLOCK_POLL_MS * 1000;
+			if (!when || poll < when)
+				when = poll;
+		}
+
+		if (when)
+			_task.getScheduler()->scheduleAt(&_task, when);
+
+		return ready ? Task::TASK_READY : Task::TASK_IDLE;
+	}
+
+	int32 Block::StepTask::execute(void)
+	{
+		// anything signalled from now on runs the block again
+		_block->_ws.wait(0);
+
+		if (_block->_armed) {
+			_block->_armPools(false, NULL);
+			_block->_armed = false;
+		}
+
+		return _block->step();
+	}
+
+	void Block::StepTask::done(void)
+	{
+		// the block may be deleted now
+		_block->doTerminate();
+	}
+
+	bool Block::hasInputData(void)
+	{
+		bool retval = false;
+
+		lockTable(INPUT_TABLE);
+
+		Enumeration* pins = getInputPins();
+		while (pins->hasMoreElements() && !retval) {
+			DataPin* dp = (DataPin*) pins->nextElement();
+			retval = (dp->getQueuedCount() > 0);
+		}
+
+		unlockTable(INPUT_TABLE);
+
+		return retval;
+	}
+
+	int32 Block::_armPools(bool arm, bool* ready)
+	{
+		int32 ret = SUCCESS;
+		Block* b = NULL;
+
+		// fused blocks produce in this thread too
+		for (b = this; b; b = b->getFusedNext()) {
+			b->lockTable(OUTPUT_TABLE);
+
+			Enumeration* pins = b->getOutputPins();
+			while (pins->hasMoreElements()) {
+				DataPin* dp = (DataPin*) pins->nextElement();
+
+				dp->lockTable(Pin::PEERS_TABLE);
+
+				Enumeration* peers = dp->getPeers();
+				while (peers->hasMoreElements()) {
+					DataPin* pin = (DataPin*) peers->nextElement();
+					MutexLocker ml(pin);
+
+					BufferPool* bp = pin->getInputBufferPool();
+					if (!bp)
+						continue;
+
+					if (!arm) {
+						bp->cancelNotify(&_wsOutput);
+						continue;
+					}
+
+					// only exhausted pools can stop this block
+					if (bp != b->_starved && bp->getFreeBuffersCount() > 0)
+						continue;
+
+					if (bp->notifyOnFree(&_wsOutput) == FAILURE)
+						ret = FAILURE;
+
+					// a buffer may have been freed before arming
+					else if (bp->getFreeBuffersCount() > 0)
+						*ready = true;
+				}
+
+				dp->unlockTable(Pin::PEERS_TABLE);
+			}
+
+			b->unlockTable(OUTPUT_TABLE);
+
+			if (!arm)
+				b->_starved = NULL;
+		}
+
+		return ret;
+	}
+
+	void Block::releaseBuffers(bool trim)
+	{
+		lockTable(INPUT_TABLE);
+
+		Enumeration* pins = getInputPins();
+		while (pins->hasMoreElements()) {
+			DataPin* dp = (DataPin*) pins->nextElement();
+
+			// the pin may be busy (eg. a wire is changing its pool)
+			if (dp->tryLock() == FAILURE)
+				continue;
+
+			BufferPool* bp = dp->getInputBufferPool();
+			if (bp) {
+				if (trim)
+					bp->trim();
+				else
+					bp->housekeep();
+			}
+
+			dp->unlock();
+		}
+
+		unlockTable(INPUT_TABLE);
+	}
+
 	int32 Block::sendMessageToPeersOf(DataPin* dp, uint32 code)
 	{
 		cmessage cm;
@@ -487,6 +920,11 @@ namespace uStreamLib {
 			Block* b = dpi->getBlock();
 			ControlPin* cp = b->getControlPin();
 
+			if (code == EVENT_DATA_READY) {
+				cp->notifyDataReady();
+				continue;
+			}
+
 			cm.code = code;
 			cm.from = this;
 
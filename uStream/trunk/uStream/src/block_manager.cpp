@@ -22,6 +22,8 @@
 #include <ctype.h>
 
 #include "block_manager.hpp"
+#include "memory.hpp"
+#include "timer.hpp"
 
 namespace uStreamLib {
 	/*
@@ -59,6 +61,88 @@ namespace uStreamLib {
 		BlockManager* _bm;
 	};
 
+	class TaskWorkers : public ConfigCallBack {
+	public:
+		TaskWorkers(BlockManager* bm)
+			: _bm(bm)
+		{
+			int32 ret = ConfigCallBack::init(USBM_TASK_WORKERS);
+			if (ret == FAILURE) {
+				fprintf(stderr, "Cannot initialize TaskWorkers callback.\n");
+			}
+		}
+
+		virtual ~TaskWorkers(void)
+		{
+			// nothing to do
+		}
+
+		int32 perform(void*)
+		{
+			// zero keeps a thread per block
+			if (!*ival)
+				return SUCCESS;
+
+			return _bm->startScheduler(*ival < 0 ? 0 : (uint32) *ival);
+		}
+	private:
+		/* the block manager */
+		BlockManager* _bm;
+	};
+
+	class LockMemory : public ConfigCallBack {
+	public:
+		LockMemory(BlockManager* bm)
+			: _bm(bm)
+		{
+			int32 ret = ConfigCallBack::init(USBM_LOCK_MEMORY);
+			if (ret == FAILURE) {
+				fprintf(stderr, "Cannot initialize LockMemory callback.\n");
+			}
+		}
+
+		virtual ~LockMemory(void)
+		{
+			// nothing to do
+		}
+
+		int32 perform(void*)
+		{
+			return _bm->lockMemory(*ival != 0);
+		}
+	private:
+		/* the block manager */
+		BlockManager* _bm;
+	};
+
+	class AutoPlacement : public ConfigCallBack {
+	public:
+		AutoPlacement(BlockManager* bm)
+			: _bm(bm)
+		{
+			int32 ret = ConfigCallBack::init(USBM_AUTO_PLACEMENT);
+			if (ret == FAILURE) {
+				fprintf(stderr, "Cannot initialize AutoPlacement callback.\n");
+			}
+		}
+
+		virtual ~AutoPlacement(void)
+		{
+			// nothing to do
+		}
+
+		int32 perform(void*)
+		{
+			if (!*ival)
+				return SUCCESS;
+
+			return _bm->placeBlocks();
+		}
+	private:
+		/* the block manager */
+		BlockManager* _bm;
+	};
+
 	/*
 	* Block Manager implementation.
 	*/
@@ -66,6 +150,8 @@ namespace uStreamLib {
 	char BlockManager::_version_string[BlockManager::_VERSION_STRING_SZ];
 
 	BlockManager::BlockManager(void)
+		: _sched(NULL), _pool(NULL), _memLocked(false), _senders(0),
+		_topology(NULL)
 	{
 		Thread::setClassID(UOSUTIL_RTTI_BLOCK_MANAGER);
 	}
@@ -98,6 +184,19 @@ namespace uStreamLib {
 		// wait on termination semaphore
 		_termSem.wait();
 
+		// stop the workers running blocks as tasks
+		if (_sched)
+			delete _sched;
+
+		if (_pool)
+			delete _pool;
+
+		if (_memLocked)
+			Memory::unlockAll();
+
+		if (_topology)
+			delete _topology;
+
 		// signal termination and delete logger
 		log(Logger::LEVEL_EMERG, "uStream successfully shutdown");
 
@@ -153,6 +252,11 @@ namespace uStreamLib {
 		if (ret == FAILURE)
 			return FAILURE;
 
+		// create table to contain only filters
+		ret = _ftb.init(US_BLOCKTABLE_HSIZE);
+		if (ret == FAILURE)
+			return FAILURE;
+
 		// create timer (the clock)
 		ret = _clock.init();
 		if (ret == FAILURE)
@@ -178,9 +282,15 @@ namespace uStreamLib {
 
 		// create parameter callbacks (CREATE HERE)
 		LoggerLevel* ll = new LoggerLevel(this);
+		TaskWorkers* tw = new TaskWorkers(this);
+		LockMemory* lm = new LockMemory(this);
+		AutoPlacement* ap = new AutoPlacement(this);
 
 		// register and attach parameter callbacks (REGISTER HERE)
 		attachWrite(USBM_LOGGER_LEVEL, ll, NULL);
+		attachWrite(USBM_TASK_WORKERS, tw, NULL);
+		attachWrite(USBM_LOCK_MEMORY, lm, NULL);
+		attachWrite(USBM_AUTO_PLACEMENT, ap, NULL);
 
 		/*
 			 * create property extended descriptors
@@ -199,22 +309,30 @@ namespace uStreamLib {
 
 	int32 BlockManager::sendMessage(char* block_name, cmessage* m)
 	{
+		int32 ret = FAILURE;
+
+		Atomic::increment(&_senders);
+
 		Block* b = getBlock(block_name);
-		if (!b)
-			return FAILURE;
+		if (b)
+			ret = b->getControlPin()->putMessage(m);
 
-		ControlPin* cp = b->getControlPin();
-		return cp->putMessage(m);
+		Atomic::decrement(&_senders);
+		return ret;
 	}
 
 	int32 BlockManager::trySendMessage(char* block_name, cmessage* m)
 	{
+		int32 ret = FAILURE;
+
+		Atomic::increment(&_senders);
+
 		Block* b = getBlock(block_name);
-		if (!b)
-			return FAILURE;
+		if (b)
+			ret = b->getControlPin()->tryPutMessage(m);
 
-		ControlPin* cp = b->getControlPin();
-		return cp->tryPutMessage(m);
+		Atomic::decrement(&_senders);
+		return ret;
 	}
 
 	int32 BlockManager::connectPins(DataPin* p1, DataPin* p2)
@@ -234,6 +352,9 @@ namespace uStreamLib {
 			return FAILURE;
 		}
 
+		// the chains these blocks belong to change
+		_unfusePins(p1, p2);
+
 		// create wire
 		w = new Wire();
 		if (!w)
@@ -275,10 +396,19 @@ namespace uStreamLib {
 			return FAILURE;
 		}
 
+		// pools of new wires must not fault either
+		if (_memLocked) {
+			_prefault(p1);
+			_prefault(p2);
+		}
+
 		// log notice
 		log(Logger::LEVEL_NOTICE, "%s: connect(%s,%s) ok", getName(),
 			p1->getAbsoluteName(), p2->getAbsoluteName());
 
+		// the graph changed
+		_autoPlace();
+
 		// ok
 		return SUCCESS;
 	}
@@ -301,6 +431,8 @@ namespace uStreamLib {
 		// get the wire that connects p1 to p2
 		w = p1->getWire(p2);
 		if (w) {
+			_unfusePins(p1, p2);
+
 			// delete this wire
 			delete w;
 
@@ -308,6 +440,9 @@ namespace uStreamLib {
 			log(Logger::LEVEL_WARN, "%s: disconnect(%s,%s) ok", getName(),
 				p1->getAbsoluteName(), p2->getAbsoluteName());
 
+			// the graph changed
+			_autoPlace();
+
 			return SUCCESS;
 		}
 
@@ -328,9 +463,14 @@ namespace uStreamLib {
 				w->getPin(1)->getAbsoluteName(),
 				w->getPin(2)->getAbsoluteName());
 
+			_unfusePins(w->getPin(1), w->getPin(2));
+
 			// delete this wire
 			delete w;
 
+			// the graph changed
+			_autoPlace();
+
 			// ok
 			return SUCCESS;
 		}
@@ -342,6 +482,42 @@ namespace uStreamLib {
 		return FAILURE;
 	}
 
+	int32 BlockManager::fuseChains(void)
+	{
+		int32 count = 0;
+
+		lockTable(FILTERS_TABLE);
+
+		Enumeration* filters = getFilters();
+		while (filters->hasMoreElements()) {
+			if (((Block *) filters->nextElement())->fuse() == SUCCESS)
+				count++;
+		}
+
+		unlockTable(FILTERS_TABLE);
+
+		log(Logger::LEVEL_NOTICE, "%s: %d filters fused", getName(), count);
+		return count;
+	}
+
+	void BlockManager::unfuseChains(void)
+	{
+		lockTable(BLOCKS_TABLE);
+
+		Enumeration* blocks = getBlocks();
+		while (blocks->hasMoreElements())
+			((Block *) blocks->nextElement())->unfuse();
+
+		unlockTable(BLOCKS_TABLE);
+	}
+
+	void BlockManager::_unfusePins(Pin* p1, Pin* p2)
+	{
+		// break the links of the blocks of these pins
+		p1->getBlock()->unfuse();
+		p2->getBlock()->unfuse();
+	}
+
 	void BlockManager::lockTable(int32 table_id)
 	{
 		switch (table_id) {
@@ -387,6 +563,83 @@ namespace uStreamLib {
 		// setup basic properties
 		setInt(USBM_ACTIONSCHEDULER_TIMEOUT, US_DEFAULT_BM_ASTIMEOUT);
 		setInt(USBM_LOGGER_LEVEL, US_DEFAULT_BM_LOGLEVEL);
+		setInt(USBM_TASK_WORKERS, US_DEFAULT_BM_TASKWORKERS);
+		setInt(USBM_STACK_SIZE, US_DEFAULT_BM_STACKSIZE);
+		setInt(USBM_LOCK_MEMORY, US_DEFAULT_BM_LOCKMEMORY);
+		setInt(USBM_AUTO_PLACEMENT, US_DEFAULT_BM_AUTOPLACEMENT);
+	}
+
+	int32 BlockManager::startScheduler(uint32 workers)
+	{
+		TaskScheduler* sched = NULL;
+		char tmp[256];
+		int32 ret = 0;
+
+		if (_sched) {
+			log(Logger::LEVEL_ERROR, "%s: task scheduler already started",
+				getName());
+			return FAILURE;
+		}
+
+		sched = new TaskScheduler();
+		if (!sched)
+			return FAILURE;
+
+		snprintf(tmp, sizeof(tmp), "%s[TS]", getName());
+		ret = sched->init(tmp, workers);
+		if (ret == FAILURE) {
+			log(Logger::LEVEL_ERROR, "%s: cannot start task scheduler",
+				getName());
+			delete sched;
+			return FAILURE;
+		}
+
+		_sched = sched;
+
+		log(Logger::LEVEL_NOTICE, "%s: blocks run as tasks on %u workers",
+			getName(), sched->getWorkersCount());
+
+		// ok
+		return SUCCESS;
+	}
+
+	int32 BlockManager::parallelFor(uint32 begin, uint32 end, uint32 grain,
+		LoopBody* body, uint32 threads)
+	{
+		TaskScheduler* pool = _sched;
+		uint32 workers = 0;
+		char tmp[256];
+
+		if (!pool)
+			pool = (TaskScheduler *) Atomic::loadPtr((void * volatile *) &_pool);
+
+		if (!pool) {
+			// the caller is the last thread of the pool
+			workers = Thread::getProcessorsCount();
+			workers = workers > 1 ? workers - 1 : 1;
+
+			pool = new TaskScheduler();
+			if (!pool)
+				return FAILURE;
+
+			snprintf(tmp, sizeof(tmp), "%s[PF]", getName());
+			if (pool->init(tmp, workers) == FAILURE) {
+				log(Logger::LEVEL_ERROR, "%s: cannot start parallel workers",
+					getName());
+				delete pool;
+				return FAILURE;
+			}
+
+			// another thread may have been faster
+			if (!Atomic::compareAndSwapPtr((void * volatile *) &_pool, NULL,
+				pool)) {
+				delete pool;
+				pool = (TaskScheduler *)
+					Atomic::loadPtr((void * volatile *) &_pool);
+			}
+		}
+
+		return pool->parallelFor(begin, end, grain, body, threads);
 	}
 
 	int32 BlockManager::addSource(Source* b)
@@ -456,8 +709,10 @@ namespace uStreamLib {
 
 		log(Logger::LEVEL_WARN, "Source \"%s\" deleted", bname);
 
-		if (del)
+		if (del) {
+			_waitSenders();
 			delete b;
+		}
 		return SUCCESS;
 	}
 
@@ -524,8 +779,11 @@ namespace uStreamLib {
 
 		log(Logger::LEVEL_WARN, "Sink \"%s\" deleted", bname);
 
-		if (del)
-			delete b; return SUCCESS;
+		if (del) {
+			_waitSenders();
+			delete b;
+		}
+		return SUCCESS;
 	}
 
 	int32 BlockManager::addFilter(Filter* b)
@@ -595,12 +853,35 @@ namespace uStreamLib {
 
 		log(Logger::LEVEL_WARN, "Filter \"%s\" deleted", bname);
 
-		if (del)
-			delete b; return SUCCESS;
+		if (del) {
+			_waitSenders();
+			delete b;
+		}
+		return SUCCESS;
 	}
 
 	int32 BlockManager::sendMessage(char* block_name, char* msg, smessage* sm,
 		bool wait)
+	{
+		int32 ret = 0;
+
+		// the block cannot be deleted meanwhile
+		Atomic::increment(&_senders);
+		ret = _sendMessage(block_name, msg, sm, wait);
+		Atomic::decrement(&_senders);
+
+		return ret;
+	}
+
+	void BlockManager::_waitSenders(void)
+	{
+		// a block out of the tables cannot be found by new senders
+		while (Atomic::load(&_senders))
+			Thread::sleep(1);
+	}
+
+	int32 BlockManager::_sendMessage(char* block_name, char* msg,
+		smessage* sm, bool wait)
 	{
 		cmessage cm;
 		int32 ret = 0;
@@ -659,90 +940,72 @@ namespace uStreamLib {
 
 	void BlockManager::run(void)
 	{
-		cmessage cm;
-		int32 ret, stop = 0, msg_recvd = 0;
-		int32 timeout = 0;
+		cmessage cm[US_CP_MAX_BATCH];
+		uint32 n = 0, i = 0;
+		int32 ret, stop = 0, timeout = 0;
 		int32 termination_request = 0, force_stop = 20;
+		uint64 now = 0, housekeeping = 0, watchdog = 0;
+		uint32 wait = 0;
 
-		while (!stop) {
-			// DEBUG
-			// printf("%s: checking (stop=%d)...\n",getName(),stop);
+		housekeeping = Timer::getMonotonicTime() +
+			US_DEFAULT_BM_HKPERIOD * 1000;
 
+		while (!stop) {
 			// get action scheduler timeout
 			ret = getInt(USBM_ACTIONSCHEDULER_TIMEOUT, &timeout);
 			if (ret == FAILURE)
 				timeout = US_DEFAULT_BM_ASTIMEOUT;
 
-			// wait for action scheduler timeout
-			// printf("%s: sleeping (stop=%d)...\n",getName(),stop);
-			Thread::sleep(timeout);
-			// printf("%s: sleeped (stop=%d)...\n",getName(),stop);
-
 			/*
-						 * Check for a message coming from any thread.
-						 * Notice that the invoked method is tryGetMessage()
-						 * which does not check if the pin is connected. Any thread
-						 * (block or block manager itself) can put message into this
-						 * control pin.
-						 */
-			// printf("%s: checking queue (stop=%d)...\n",getName(),stop);
-			ret = _cp.tryGetMessage(&cm);
-			if (ret == SUCCESS)
-				msg_recvd = 1;
-
-			if (msg_recvd) {
-				// DEBUG
-				UOSUTIL_DOUT(("%s: message (stop=%d)...\n", getName(), stop));
-
-				// execute message code
-				switch (cm.code) {
-				case BM_MESSAGE_SHUTDOWN:
-					// log this message
-					log(Logger::LEVEL_CRIT, "%s: MESSAGE(SHUTDOWN[%d],%s)",
-						getName(), cm.code,
-						cm.from ? cm.from->getName() : "unset");
-
-					termination_request = 1;
-					break;
-				case BM_MESSAGE_BLOCKQUIT:
-					// log this message
-					log(Logger::LEVEL_CRIT, "%s: MESSAGE(BLOCKQUIT[%d],%s)",
-						getName(), cm.code,
-						cm.from ? cm.from->getName() : "unset");
-
-					if (cm.from) {
-						char* bname = cm.from->getName();
-						switch (cm.from->getType()) {
-						case Block::TYPE_SOURCE:
-							delSource(bname, true); break;
-						case Block::TYPE_SINK:
-							delSink(bname, true); break;
-						case Block::TYPE_FILTER:
-							delFilter(bname, true); break;
-						default:
-							fprintf(stderr,
-								"******** INVALID BLOCK TYPE ********");
-							fprintf(stderr,
-								"********        %d          ********",
-								cm.from->getType());
-						}
+			 * Sleep on the control pin until a message comes or
+			 * periodic work is due: buffer pools housekeeping and,
+			 * while shutting down, the termination watchdog.
+			 * Notice that the invoked methods do not check if the pin
+			 * is connected. Any thread (block or block manager itself)
+			 * can put message into this control pin.
+			 */
+			now = Timer::getMonotonicTime();
+			wait = housekeeping > now ?
+				(uint32) ((housekeeping - now + 999) / 1000) : 0;
+			if (termination_request && wait > (uint32) timeout)
+				wait = timeout;
+
+			ret = _cp.timedGetMessage(cm, wait);
+			n = ret == SUCCESS ? 1 : 0;
+
+			// execute every message pending, a batch at a time
+			while (n) {
+				for (i = 0; i < n; i++) {
+					// DEBUG
+					UOSUTIL_DOUT(("%s: message (stop=%d)...\n", getName(),
+						stop));
+
+					if (_runMessage(&cm[i]) == BM_MESSAGE_SHUTDOWN &&
+						!termination_request) {
+						termination_request = 1;
+						watchdog = Timer::getMonotonicTime();
 					}
-					break;
 				}
 
-				// reset control message indicator
-				msg_recvd = 0;
+				n = _cp.tryGetMessages(cm, US_CP_MAX_BATCH);
 			}
 
-			// printf("%s: checking termination request (stop=%d)...\n",getName(),stop);
+			now = Timer::getMonotonicTime();
+
+			// housekeeping of buffer pools
+			if (now >= housekeeping) {
+				_releaseBuffers();
+				housekeeping = now + US_DEFAULT_BM_HKPERIOD * 1000;
+			}
 
 			if (termination_request) {
 				// check if there are active blocks
 				if (!_blocks.getCount() || !force_stop) {
 					stop = 1; log(Logger::LEVEL_NOTICE,
 								"Block Manager quitting");
-				} else {
+				} else if (now >= watchdog) {
 					log(Logger::LEVEL_NOTICE, "Waiting for blocks termination");
+					watchdog = now + timeout * 1000;
 					force_stop--;
 				}
 			}
@@ -755,6 +1018,326 @@ namespace uStreamLib {
 		_termSem.post();
 	}
 
+	int32 BlockManager::_runMessage(cmessage* cm)
+	{
+		// execute message code
+		switch (cm->code) {
+		case BM_MESSAGE_SHUTDOWN:
+			// log this message
+			log(Logger::LEVEL_CRIT, "%s: MESSAGE(SHUTDOWN[%d],%s)",
+				getName(), cm->code,
+				cm->from ? cm->from->getName() : "unset");
+			break;
+		case BM_MESSAGE_BLOCKQUIT:
+			// log this message
+			log(Logger::LEVEL_CRIT, "%s: MESSAGE(BLOCKQUIT[%d],%s)",
+				getName(), cm->code,
+				cm->from ? cm->from->getName() : "unset");
+
+			if (cm->from) {
+				char* bname = cm->from->getName();
+				switch (cm->from->getType()) {
+				case Block::TYPE_SOURCE:
+					delSource(bname, true); break;
+				case Block::TYPE_SINK:
+					delSink(bname, true); break;
+				case Block::TYPE_FILTER:
+					delFilter(bname, true); break;
+				default:
+					fprintf(stderr,
+						"******** INVALID BLOCK TYPE ********");
+					fprintf(stderr,
+						"********        %d          ********",
+						cm->from->getType());
+				}
+			}
+			break;
+		}
+
+		return cm->code;
+	}
+
+	int32 BlockManager::lockMemory(bool lock)
+	{
+		int32 ret = SUCCESS;
+
+		if (!lock) {
+			if (_memLocked)
+				Memory::unlockAll();
+			_memLocked = false;
+			return SUCCESS;
+		}
+
+		if (!_memLocked) {
+			if (Memory::lockAll() == FAILURE) {
+				log(Logger::LEVEL_ERROR, "%s: cannot lock memory",
+					getName());
+				return FAILURE;
+			}
+
+			_memLocked = true;
+		}
+
+		// allocate and touch the buffers of all input pins
+		lockTable(BLOCKS_TABLE);
+
+		Enumeration* blocks = getBlocks();
+		while (blocks->hasMoreElements()) {
+			Block* b = (Block *) blocks->nextElement();
+
+			b->lockTable(Block::INPUT_TABLE);
+
+			Enumeration* pins = b->getInputPins();
+			while (pins->hasMoreElements()) {
+				if (_prefault((DataPin *) pins->nextElement()) == FAILURE)
+					ret = FAILURE;
+			}
+
+			b->unlockTable(Block::INPUT_TABLE);
+		}
+
+		unlockTable(BLOCKS_TABLE);
+
+		log(Logger::LEVEL_NOTICE, "%s: memory locked", getName());
+		return ret;
+	}
+
+	int32 BlockManager::_prefault(DataPin* dp)
+	{
+		BufferPool* bp = NULL;
+		int32 ret = SUCCESS;
+
+		// only input pins own a pool
+		if (dp->getDirection() != Pin::DIR_INPUT)
+			return SUCCESS;
+
+		MutexLocker ml(dp);
+
+		bp = dp->getInputBufferPool();
+		if (bp && bp->prefault() == FAILURE) {
+			log(Logger::LEVEL_ERROR, "%s: cannot prefault buffers of %s",
+				getName(), dp->getAbsoluteName());
+			ret = FAILURE;
+		}
+
+		return ret;
+	}
+
+	int32 BlockManager::placeBlocks(void)
+	{
+		Block** blocks = NULL;
+		uint32* parent = NULL, * size = NULL;
+		uint32 n = 0, i = 0, j = 0, k = 0, d = 0, best = 0, ndoms = 0;
+		uint32 doms[CpuTopology::MAX_CPUS];
+		uint32 dload[CpuTopology::MAX_CPUS], dcpus[CpuTopology::MAX_CPUS];
+		uint32* nload = NULL, * ncpus = NULL;
+		double score = 0, bscore = 0;
+		CpuTopology::CpuInfo* c = NULL;
+
+		// read the topology once
+		if (!_topology) {
+			_topology = new CpuTopology();
+			if (!_topology || _topology->init() == FAILURE) {
+				delete _topology; _topology = NULL;
+				log(Logger::LEVEL_ERROR, "%s: cannot read processors topology",
+					getName());
+				return FAILURE;
+			}
+		}
+
+		/*
+		 * Placement domains are the last level caches: count their
+		 * processors and the processors of each node.
+		 */
+		nload = new uint32[_topology->getNodesCount()];
+		ncpus = new uint32[_topology->getNodesCount()];
+		memset(nload, 0, _topology->getNodesCount() * sizeof(uint32));
+		memset(ncpus, 0, _topology->getNodesCount() * sizeof(uint32));
+
+		for (i = 0; i < _topology->getCpusCount(); i++) {
+			c = _topology->getCpu(i);
+			ncpus[c->node]++;
+
+			for (d = 0; d < ndoms && doms[d] != c->l3; d++)
+				;
+			if (d == ndoms) {
+				doms[ndoms++] = c->l3;
+				dload[d] = 0; dcpus[d] = 0;
+			}
+			dcpus[d]++;
+		}
+
+		lockTable(BLOCKS_TABLE);
+
+		n = _blocks.getCount();
+		blocks = new Block*[n + 1];
+		parent = new uint32[n + 1];
+		size = new uint32[n + 1];
+
+		Enumeration* en = getBlocks();
+		for (i = 0; i < n && en->hasMoreElements(); i++) {
+			blocks[i] = (Block *) en->nextElement();
+			parent[i] = i;
+			size[i] = 0;
+		}
+		n = i;
+
+		// blocks connected by wires make a graph (union find)
+		for (i = 0; i < n; i++) {
+			blocks[i]->lockTable(Block::OUTPUT_TABLE);
+
+			Enumeration* pins = blocks[i]->getOutputPins();
+			while (pins->hasMoreElements()) {
+				DataPin* dp = (DataPin *) pins->nextElement();
+
+				dp->lockTable(Pin::PEERS_TABLE);
+
+				Enumeration* peers = dp->getPeers();
+				while (peers->hasMoreElements()) {
+					Block* b = ((DataPin *) peers->nextElement())->getBlock();
+
+					for (j = 0; j < n && blocks[j] != b; j++)
+						;
+					if (j == n)
+						continue;
+
+					for (k = i; parent[k] != k; k = parent[k])
+						;
+					for (; parent[j] != j; j = parent[j])
+						;
+					parent[j] = k;
+				}
+
+				dp->unlockTable(Pin::PEERS_TABLE);
+			}
+
+			blocks[i]->unlockTable(Block::OUTPUT_TABLE);
+		}
+
+		for (i = 0; i < n; i++) {
+			for (k = i; parent[k] != k; k = parent[k])
+				;
+			parent[i] = k;
+			size[k]++;
+		}
+
+		/*
+		 * Biggest graphs first, each on the least loaded cache of
+		 * the least loaded node.
+		 */
+		for (;;) {
+			for (i = 0, k = n; i < n; i++) {
+				if (size[i] && (k == n || size[i] > size[k]))
+					k = i;
+			}
+			if (k == n)
+				break;
+
+			best = 0; bscore = 0;
+			for (d = 0; d < ndoms; d++) {
+				uint32 node = 0;
+
+				for (i = 0; i < _topology->getCpusCount(); i++) {
+					c = _topology->getCpu(i);
+					if (c->l3 == doms[d]) {
+						node = c->node; break;
+					}
+				}
+
+				score = (double) nload[node] / ncpus[node] * 1000 +
+					(double) dload[d] / dcpus[d];
+				if (!d || score < bscore) {
+					best = d; bscore = score;
+				}
+			}
+
+			c = NULL;
+			for (i = 0; i < _topology->getCpusCount(); i++) {
+				c = _topology->getCpu(i);
+				if (c->l3 == doms[best])
+					break;
+			}
+
+			dload[best] += size[k];
+			nload[c->node] += size[k];
+
+			for (i = 0; i < n; i++) {
+				if (parent[i] == k)
+					_placeBlock(blocks[i],
+						_topology->getMask(c->cpu, CpuTopology::SHARE_L3),
+						c->node, _topology->getNodesCount() > 1);
+			}
+
+			size[k] = 0;
+		}
+
+		unlockTable(BLOCKS_TABLE);
+
+		log(Logger::LEVEL_NOTICE, "%s: %u blocks placed on %u caches and "
+			"%u nodes", getName(), n, ndoms, _topology->getNodesCount());
+
+		delete [] blocks;
+		delete [] parent;
+		delete [] size;
+		delete [] nload;
+		delete [] ncpus;
+
+		// ok
+		return SUCCESS;
+	}
+
+	void BlockManager::_placeBlock(Block* b, uint64 cpus, uint32 node,
+		bool numa)
+	{
+		char* s = NULL;
+
+		// blocks run as tasks have no thread; manual settings win
+		if (b->isTask() ||
+			(b->getString(USBL_CPUSET, &s) == SUCCESS && s && *s))
+			return;
+
+		if (b->setAffinity(cpus) == FAILURE)
+			log(Logger::LEVEL_WARN, "%s: cannot place block %s", getName(),
+				b->getName());
+
+		if (!numa)
+			return;
+
+		// buffers next to their consumer
+		b->lockTable(Block::INPUT_TABLE);
+
+		Enumeration* pins = b->getInputPins();
+		while (pins->hasMoreElements()) {
+			DataPin* dp = (DataPin *) pins->nextElement();
+			MutexLocker ml(dp);
+
+			BufferPool* bp = dp->getInputBufferPool();
+			if (bp)
+				bp->bindToNode(node);
+		}
+
+		b->unlockTable(Block::INPUT_TABLE);
+	}
+
+	void BlockManager::_autoPlace(void)
+	{
+		int32 value = 0;
+
+		if (getInt(USBM_AUTO_PLACEMENT, &value) == SUCCESS && value)
+			placeBlocks();
+	}
+
+	void BlockManager::_releaseBuffers(void)
+	{
+		lockTable(BLOCKS_TABLE);
+
+		Enumeration* blocks = getBlocks();
+		while (blocks->hasMoreElements())
+			((Block *) blocks->nextElement())->releaseBuffers(false);
+
+		unlockTable(BLOCKS_TABLE);
+	}
+
 	uint32 BlockManager::getVersion(int32 what)
 	{
 		switch (what) {
@@ -795,7 +1378,40 @@ namespace uStreamLib {
 		if (prop) {
 			prop->setAllowedMinInteger(10);
 			prop->setAllowedMaxInteger(1000);
-			prop->setDescription("Timeout for action scheduler to take an action");
+			prop->setDescription("Period of the termination watchdog while shutting down");
+		}
+
+		prop = createPropertyDescription(USBM_STACK_SIZE);
+		if (prop) {
+			prop->setAllowedMinInteger(0);
+			prop->setAllowedMaxInteger(0x7fffffff);
+			prop->setDescription("Stack size of block threads in bytes (0 "
+				"means system default); set before creating blocks");
+		}
+
+		prop = createPropertyDescription(USBM_LOCK_MEMORY);
+		if (prop) {
+			prop->setAllowedMinInteger(0);
+			prop->setAllowedMaxInteger(1);
+			prop->setDescription("Lock memory in RAM and prefault buffer "
+				"pools (needs privileges)");
+		}
+
+		prop = createPropertyDescription(USBM_AUTO_PLACEMENT);
+		if (prop) {
+			prop->setAllowedMinInteger(0);
+			prop->setAllowedMaxInteger(1);
+			prop->setDescription("Place block threads on processors by "
+				"topology whenever pins are connected");
+		}
+
+		prop = createPropertyDescription(USBM_TASK_WORKERS);
+		if (prop) {
+			prop->setAllowedMinInteger(-1);
+			prop->setAllowedMaxInteger(256);
+			prop->setDescription("Workers running blocks as tasks (0 means "
+				"a thread per block, -1 one per processor); set before "
+				"creating blocks");
 		}
 	}
 }
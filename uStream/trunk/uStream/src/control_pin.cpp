@@ -19,11 +19,16 @@
   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include <stdio.h>
+#include <string.h>
+
 #include "control_pin.hpp"
+#include "block.hpp"
 
 namespace uStreamLib {
 	ControlPin::ControlPin(void)
-		: _cmserial(0)
+		: _ready(0), _readyMax(0), _cwait(0), _ws(NULL),
+		_wsmask(0), _cmserial(0)
 	{
 		// nothing to do
 	}
@@ -46,9 +51,8 @@ namespace uStreamLib {
 		if (ret == FAILURE)
 			return FAILURE;
 
-		// initialize queue
-		ret = _iq.init(getAbsoluteName(), sizeof(cmessage), queuesz,
-					US_PRIORITY_LEVELS, US_OOB_QUEUE_SIZE);
+		// initialize input lanes
+		ret = _initLanes(queuesz);
 		if (ret == FAILURE)
 			return FAILURE;
 
@@ -72,9 +76,8 @@ namespace uStreamLib {
 		if (ret == FAILURE)
 			return FAILURE;
 
-		// initialize queue
-		ret = _iq.init(getAbsoluteName(), sizeof(cmessage), queuesz,
-					US_PRIORITY_LEVELS, US_OOB_QUEUE_SIZE);
+		// initialize input lanes
+		ret = _initLanes(queuesz);
 		if (ret == FAILURE)
 			return FAILURE;
 
@@ -85,6 +88,143 @@ namespace uStreamLib {
 		return SUCCESS;
 	}
 
+	int32 ControlPin::_initLanes(int32 queuesz)
+	{
+		char tmp[4096];
+		int32 ret = 0;
+
+		ret = _iq.init(getAbsoluteName(), queuesz);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		snprintf(tmp, sizeof(tmp), "%s[OOB]", getAbsoluteName());
+		ret = _oobq.init(tmp, US_OOB_QUEUE_SIZE);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		ret = _semItems.init(0);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		_readyMax = queuesz > 0 ? queuesz : 1;
+
+		// ok
+		return SUCCESS;
+	}
+
+	int32 ControlPin::_put(cmessage* m, int32 priority, bool wait)
+	{
+		TypedMPSCQueue<cmessage>* q = priority < 0 ? &_oobq : &_iq;
+		int32 ret = 0;
+
+		if (wait)
+			ret = q->put(m);
+		else
+			ret = q->tryPut(m);
+
+		if (ret == SUCCESS)
+			_notify();
+
+		return ret;
+	}
+
+	int32 ControlPin::notifyDataReady(void)
+	{
+		int32 n = 0;
+
+		for (;;) {
+			n = Atomic::load(&_ready);
+			if (n >= _readyMax)
+				return FAILURE;
+
+			if (Atomic::compareAndSwap(&_ready, n, n + 1))
+				break;
+		}
+
+		_notify();
+		return SUCCESS;
+	}
+
+	void ControlPin::_notify(void)
+	{
+		// wake up the consumer if it is sleeping
+		Atomic::barrier();
+		if (Atomic::load(&_cwait) && Atomic::compareAndSwap(&_cwait, 1, 0))
+			_semItems.post();
+
+		if (_ws)
+			_ws->signal(_wsmask);
+	}
+
+	bool ControlPin::_take(cmessage* m)
+	{
+		// out of band messages first
+		if (_oobq.tryGet(m) == SUCCESS)
+			return true;
+
+		if (_iq.tryGet(m) == SUCCESS)
+			return true;
+
+		// only this thread decrements the count
+		if (Atomic::load(&_ready) > 0) {
+			Atomic::decrement(&_ready);
+
+			memset(m, 0, sizeof(cmessage));
+			m->code = Block::EVENT_DATA_READY;
+			m->serial = (uint32) Atomic::increment(&_cmserial);
+			return true;
+		}
+
+		return false;
+	}
+
+	int32 ControlPin::_get(cmessage* m, int32 timeout)
+	{
+		for (;;) {
+			if (_take(m))
+				return SUCCESS;
+
+			if (!timeout)
+				return FAILURE;
+
+			// announce we are going to sleep, then check again
+			Atomic::store(&_cwait, 1);
+			Atomic::barrier();
+
+			if (_take(m)) {
+				Atomic::compareAndSwap(&_cwait, 1, 0);
+				return SUCCESS;
+			}
+
+			if (timeout < 0) {
+				_semItems.wait();
+				continue;
+			}
+
+			if (_semItems.timedWait((uint32) timeout) == FAILURE &&
+				!Atomic::compareAndSwap(&_cwait, 1, 0)) {
+				// a producer posted right after the timeout: take the post
+				_semItems.wait();
+			}
+
+			return _take(m) ? SUCCESS : FAILURE;
+		}
+	}
+
+	uint32 ControlPin::tryGetMessages(cmessage* m, uint32 max)
+	{
+		uint32 n = 0;
+
+		// drain the lanes in one pass, in priority order
+		n = _oobq.tryGetMany(m, max);
+		n += _iq.tryGetMany(m + n, max - n);
+
+		while (n < max && _take(m + n))
+			n++;
+
+		return n;
+	}
+
 	int32 ControlPin::sendMessage(cmessage* m, int32 priority)
 	{
 		Enumeration* en = NULL;
@@ -96,7 +236,7 @@ namespace uStreamLib {
 			return FAILURE;
 		}
 
-		m->serial = _cmserial++;
+		m->serial = (uint32) Atomic::increment(&_cmserial);
 
 		en = getPeers();
 		while (en->hasMoreElements()) {
@@ -106,7 +246,7 @@ namespace uStreamLib {
 			UOSUTIL_DOUT(("ControlPin::sendMessage(): -> %s\n",
 				p->getAbsoluteName()));
 
-			ret = p->_iq.put((char *) m, sizeof(cmessage), priority);
+			ret = p->_put(m, priority, true);
 			if (ret == FAILURE)
 				return FAILURE;
 		}
@@ -125,7 +265,7 @@ namespace uStreamLib {
 			return FAILURE;
 		}
 
-		m->serial = _cmserial++;
+		m->serial = (uint32) Atomic::increment(&_cmserial);
 
 		en = getPeers();
 		while (en->hasMoreElements()) {
@@ -135,7 +275,7 @@ namespace uStreamLib {
 			UOSUTIL_DOUT(("ControlPin::trySendMessage(): -> %s\n",
 				p->getAbsoluteName()));
 
-			ret = p->_iq.tryPut((char *) m, sizeof(cmessage), priority);
+			ret = p->_put(m, priority, false);
 			if (ret == FAILURE) {
 				/* to replace with logging methods */
 				/*
@@ -162,7 +302,7 @@ namespace uStreamLib {
 			return FAILURE;
 		}
 
-		return _iq.get((char *) m, sizeof(cmessage));
+		return _get(m, -1);
 	}
 
 	int32 ControlPin::tryRecvMessage(cmessage* m)
@@ -173,6 +313,17 @@ namespace uStreamLib {
 			return FAILURE;
 		}
 
-		return _iq.tryGet((char *) m, sizeof(cmessage));
+		return _get(m, 0);
+	}
+
+	int32 ControlPin::timedRecvMessage(cmessage* m, uint32 ms)
+	{
+		if (getStatus() == Pin::UNCONNECTED) {
+			// DEBUG
+			UOSUTIL_DOUT(("unconnected")); 
+			return FAILURE;
+		}
+
+		return timedGetMessage(m, ms);
 	}
 }
@@ -24,12 +24,16 @@
 
 namespace uStreamLib {
 	DataPin::DataPin(void)
+		: _spsc(1), _wantSpsc(0), _wmask(0), _obuf(NULL), _obp(NULL), _shm(NULL)
 	{
 		ConfigTable::setClassID(UOSUTIL_RTTI_DATA_PIN);
 	}
 
 	DataPin::~DataPin(void)
 	{
+		// give back a pending output buffer
+		abortOutputBuffer();
+
 		MutexLocker ml(this);
 	}
 
@@ -48,11 +52,15 @@ namespace uStreamLib {
 		if (ret == FAILURE)
 			return FAILURE;
 
-		// initialize queue 
+		// initialize queues
 		ret = _iq.init(getAbsoluteName(), sizeof(dmessage), queuesz);
 		if (ret == FAILURE)
 			return FAILURE;
 
+		ret = _rq.init(getAbsoluteName(), queuesz);
+		if (ret == FAILURE)
+			return FAILURE;
+
 		// setup data type
 		setDataType(DT_UNDEF);
 
@@ -63,22 +71,27 @@ namespace uStreamLib {
 	int32 DataPin::sendMessage(dmessage* m, int32)
 	{
 		Enumeration* en = NULL;
-		int32 ret = 0;
+		int32 ret = SUCCESS;
 
 		if (getStatus() == Pin::UNCONNECTED) {
 			puts("unconnected"); return FAILURE;
 		}
 
+		lockTable(PEERS_TABLE);
+
 		en = getPeers();
 		while (en->hasMoreElements()) {
 			DataPin* p = (DataPin*) en->nextElement();
+			MutexLocker ml(p);
 
-			ret = p->_iq.put((char *) m, sizeof(dmessage));
+			ret = p->_put(m, true);
 			if (ret == FAILURE)
-				return FAILURE;
+				break;
 		}
 
-		return SUCCESS;
+		unlockTable(PEERS_TABLE);
+
+		return ret;
 	}
 
 	int32 DataPin::trySendMessage(dmessage* m, int32)
@@ -90,48 +103,251 @@ namespace uStreamLib {
 			puts("unconnected"); return FAILURE;
 		}
 
+		lockTable(PEERS_TABLE);
+
 		en = getPeers();
 		while (en->hasMoreElements()) {
 			DataPin* p = (DataPin*) en->nextElement();
+			MutexLocker ml(p);
 
-			ret = p->_iq.tryPut((char *) m, sizeof(dmessage));
+			ret = p->_put(m, false);
 			if (ret == SUCCESS)
 				ok = SUCCESS;
 		}
 
+		unlockTable(PEERS_TABLE);
+
 		return ok;
 	}
 
 	int32 DataPin::recvMessage(dmessage* m)
 	{
+		int32 ret = 0;
+
+		if (_shm)
+			return _recvFromChannel(m, true);
+
 		if (getStatus() == Pin::UNCONNECTED) {
 			puts("unconnected"); return FAILURE;
 		}
 
-		return _iq.get((char *) m, sizeof(dmessage));
+		for (;;) {
+			// messages left in the ring go first
+			ret = _rq.tryGet(m);
+			if (ret == SUCCESS)
+				return SUCCESS;
+
+			_trySwitch();
+
+			/*
+			 * Wait on the queue in use. The wait on the ring is
+			 * interrupted when peersChanged() switches queue.
+			 */
+			if (Atomic::load(&_spsc)) {
+				ret = _rq.get(m);
+				if (ret == SUCCESS)
+					return SUCCESS;
+			} else {
+				return _iq.get((char *) m, sizeof(dmessage));
+			}
+		}
 	}
 
 	int32 DataPin::tryRecvMessage(dmessage* m)
 	{
+		int32 ret = 0;
+
+		if (_shm)
+			return _recvFromChannel(m, false);
+
 		if (getStatus() == Pin::UNCONNECTED) {
 			puts("unconnected"); return FAILURE;
 		}
 
+		ret = _rq.tryGet(m);
+		if (ret == SUCCESS)
+			return SUCCESS;
+
+		_trySwitch();
+
 		return _iq.tryGet((char *) m, sizeof(dmessage));
 	}
 
-	int32 DataPin::sendBuffer(DataBuf* buf, int32, avt_metadata* md,
-		datainfo* di)
+	int32 DataPin::recvMessages(dmessage* m, uint32 max)
+	{
+		int32 ret = 0;
+
+		if (!_shm && getStatus() == Pin::UNCONNECTED)
+			return FAILURE;
+
+		if (!max)
+			return 0;
+
+		// wait for the first message
+		ret = recvMessage(m);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		return (int32) (1 + _getMany(&m[1], max - 1));
+	}
+
+	int32 DataPin::tryRecvMessages(dmessage* m, uint32 max)
+	{
+		if (!_shm && getStatus() == Pin::UNCONNECTED)
+			return FAILURE;
+
+		return (int32) _getMany(m, max);
+	}
+
+	void DataPin::peersChanged(void)
 	{
 		Enumeration* en = NULL;
-		DataBuf* out = NULL;
-		dmessage m;
+		int32 spsc = (getPeersCount() <= 1);
+
+		// senders evict queued messages: only the locked queue allows it
+		lockTable(WIRES_TABLE);
+
+		en = getWires();
+		while (spsc && en->hasMoreElements()) {
+			Wire* w = (Wire*) en->nextElement();
+
+			if (w->getPin(2) == this &&
+				w->getBackPressure() >= Wire::BP_DROP_OLDEST)
+				spsc = 0;
+		}
+
+		unlockTable(WIRES_TABLE);
+
+		/*
+		 * Producers put messages holding this pin's lock, which is held
+		 * by the caller. Messages in the ring are older than those in
+		 * the shared queue, and the consumer reads the ring first: the
+		 * switch to the ring is left to the consumer, once the shared
+		 * queue is empty (see _trySwitch()).
+		 */
+		Atomic::store(&_wantSpsc, spsc);
+
+		if (!spsc && Atomic::load(&_spsc)) {
+			// wake up the consumer waiting on the ring
+			Atomic::store(&_spsc, 0);
+			_rq.wakeConsumer();
+		}
+	}
+
+	void DataPin::_trySwitch(void)
+	{
+		if (!Atomic::load(&_wantSpsc) || Atomic::load(&_spsc) ||
+			_iq.getCount() > 0)
+			return;
+
+		// lock out the producers, then check again
+		if (tryLock() == FAILURE)
+			return;
+
+		if (Atomic::load(&_wantSpsc) && !_iq.getCount())
+			Atomic::store(&_spsc, 1);
+
+		unlock();
+	}
+
+	int32 DataPin::_put(dmessage* m, bool wait)
+	{
+		if (Atomic::load(&_spsc)) {
+			if (wait)
+				return _rq.put(m);
+			return _rq.tryPut(m);
+		}
+
+		if (wait)
+			return _iq.put((char *) m, sizeof(dmessage));
+		return _iq.tryPut((char *) m, sizeof(dmessage));
+	}
+
+	uint32 DataPin::_putMany(dmessage* m, uint32 n, bool wait)
+	{
+		uint32 done = 0;
+
+		if (Atomic::load(&_spsc)) {
+			done = _rq.tryPutMany(m, n);
+
+			// wait for room, then put as much as possible again
+			while (wait && done < n) {
+				_rq.put(&m[done++]);
+				done += _rq.tryPutMany(&m[done], n - done);
+			}
+
+			return done;
+		}
+
+		done = _iq.tryPutMany((char *) m, sizeof(dmessage), n);
+
+		while (wait && done < n) {
+			if (_iq.put((char *) &m[done], sizeof(dmessage)) == FAILURE)
+				break;
+
+			done++;
+			done += _iq.tryPutMany((char *) &m[done], sizeof(dmessage),
+				n - done);
+		}
+
+		return done;
+	}
+
+	uint32 DataPin::_evict(uint32 n, Wire* w)
+	{
+		dmessage m[US_DP_MAX_BATCH];
+		uint32 evicted = 0, got = 0, i = 0;
+
+		while (evicted < n) {
+			got = _iq.tryGetMany((char *) m, sizeof(dmessage),
+				n - evicted < US_DP_MAX_BATCH ? n - evicted : US_DP_MAX_BATCH);
+			if (!got)
+				break;
+
+			for (i = 0; i < got; i++)
+				freeInputBuffer(m[i].bid);
+
+			evicted += got;
+		}
+
+		if (w)
+			w->countDrop(Wire::DROP_EVICTED, (int32) evicted);
+
+		return evicted;
+	}
+
+	uint32 DataPin::_getMany(dmessage* m, uint32 n)
+	{
+		uint32 done = 0;
+
+		if (_shm) {
+			while (done < n && _recvFromChannel(&m[done], false) == SUCCESS)
+				done++;
+			return done;
+		}
+
+		// messages left in the ring go first
+		done = _rq.tryGetMany(m, n);
+		if (done == n)
+			return done;
+
+		_trySwitch();
+
+		return done + _iq.tryGetMany((char *) &m[done], sizeof(dmessage),
+			n - done);
+	}
 
+	int32 DataPin::sendBuffer(DataBuf* buf, int32, avt_metadata* md,
+		datainfo* di)
+	{
 		Logger* l = getBlock()->getBlockManager()->getLogger();
 
 		l->log(Logger::LEVEL_DEBUG, "%s: sendBuffer(): [BID=%u,C=%u,SZ=%u]",
 			getAbsoluteName(), buf->getBID(), buf->getCount(), buf->getSize());
 
+		if (_shm)
+			return _sendToChannel(buf, md, di, true);
+
 		if (getStatus() == UNCONNECTED) {
 			// log critical situation
 			l->log(Logger::LEVEL_ERROR, "%s: SendBuffer: Not Connected",
@@ -152,88 +368,392 @@ namespace uStreamLib {
 			return FAILURE;
 		}
 
-		// lock peers table
-		lockTable(PEERS_TABLE);
+		// deliver to each peer, waiting for buffers and queues
+		_deliver(&buf, 1, NULL, md, di, true);
 
-		en = getPeers();
-		while (en->hasMoreElements()) {
-			DataPin* pin = (DataPin*) en->nextElement();
+		// ok 
+		return SUCCESS;
+	}
 
-			/* ----- */
+	int32 DataPin::trySendBuffer(DataBuf* buf, int32, avt_metadata* md,
+		datainfo* di)
+	{
+		Logger* l = getBlock()->getBlockManager()->getLogger();
 
-			/*
-			   * Here, we need to lock current pin so that no
-			   * modifications can be done to its internal properties.
-			   */
-			MutexLocker ml(pin);
+		if (_shm)
+			return _sendToChannel(buf, md, di, false);
 
-			/* ----- */
+		if (getStatus() == UNCONNECTED) {
+			// log critical situation
+			l->log(Logger::LEVEL_ERROR, "%s: TrySendBuffer: Not Connected",
+				getBlock()->getName());
 
-			out = pin->getFreeBuffer();
-			if (out) {
-				out->xcopy(buf);
+			// fail
+			return FAILURE;
+		}
 
-				m.bid = out->getBID();
-				m.from = getBlock();
-				m.from_pin = this;
+		if (buf && !buf->getCount()) {
+			// log critical situation
+			l->log(Logger::LEVEL_CRIT,
+				"%s: TrySendBuffer: EMPTY BUFFER (BID=%x,A=%x,C=%u,S=%u)",
+				getBlock()->getName(), buf->getBID(), buf->getAddr(),
+				buf->getCount(), buf->getSize());
 
-				if (md)
-					memcpy(&m.info, md, sizeof(avt_metadata));
-				if (di)
-					memcpy(&m.di, di, sizeof(datainfo));
+			// fail
+			return FAILURE;
+		}
 
-				/*
-					 * Do timestamping if SOURCE.
-					 */
-				if (getBlock()->getType() == Block::TYPE_SOURCE) {
-					getBlock()->getBlockManager()->getClockTime(&m.di.td);
-				}
+		// SUCCESS means that every blocking peer (or any, if none) got it
+		return (_deliver(&buf, 1, NULL, md, di, false) > 0 ? SUCCESS : FAILURE);
+	}
 
-				/*
-					 * I cannot use sendMessage here because this method
-					 * creates an enumeration of peers, invalidating the
-					 * enum on which this cycle is based.
-					 */
-				pin->_iq.put((char *) &m, sizeof(dmessage));
+	int32 DataPin::sendBuffers(DataBuf** bufs, uint32 n, int32,
+		avt_metadata* md, datainfo* di)
+	{
+		Logger* l = getBlock()->getBlockManager()->getLogger();
+		uint32 i = 0, chunk = 0;
+
+		if (_shm) {
+			for (i = 0; i < n; i++) {
+				if (_sendToChannel(bufs[i], md, di, true) == FAILURE)
+					return FAILURE;
 			}
+			return SUCCESS;
 		}
 
-		// unlock peers table
-		unlockTable(PEERS_TABLE);
+		if (getStatus() == UNCONNECTED) {
+			// log critical situation
+			l->log(Logger::LEVEL_ERROR, "%s: SendBuffers: Not Connected",
+				getBlock()->getName());
 
-		// ok 
+			// fail
+			return FAILURE;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (!bufs[i] || !bufs[i]->getCount()) {
+				// log critical situation
+				l->log(Logger::LEVEL_CRIT,
+					"%s: SendBuffers: EMPTY BUFFER (%u of %u)",
+					getBlock()->getName(), i, n);
+
+				// fail
+				return FAILURE;
+			}
+		}
+
+		// deliver to each peer, one batch at a time
+		for (i = 0; i < n; i += chunk) {
+			chunk = _maxBatch();
+			if (chunk > n - i)
+				chunk = n - i;
+
+			_deliver(&bufs[i], chunk, NULL, md, di, true);
+		}
+
+		// ok
 		return SUCCESS;
 	}
 
-	int32 DataPin::trySendBuffer(DataBuf* buf, int32, avt_metadata* md,
-		datainfo* di)
+	DataBuf* DataPin::acquireOutputBuffer(bool wait)
 	{
 		Enumeration* en = NULL;
-		DataBuf* out = NULL;
+		BufferPool* bp = NULL;
+		uint32 bid = 0, bufsz = 0;
+		int32 ret = 0;
 
-		dmessage m;
+		// a buffer is already pending
+		if (_obuf)
+			return _obuf;
 
-		int32 ret = 0, ok = FAILURE;
+		// the channel buffer is filled in place
+		if (_shm) {
+			_obuf = _shm->acquire(wait);
+			return _obuf;
+		}
+
+		if (getStatus() == UNCONNECTED)
+			return NULL;
+
+		// take the pool of the first peer which has one
+		lockTable(PEERS_TABLE);
+
+		en = getPeers();
+		while (en->hasMoreElements() && !bp) {
+			DataPin* pin = (DataPin*) en->nextElement();
+			MutexLocker ml(pin);
+
+			bp = pin->getInputBufferPool();
+			if (bp) {
+				// keep the pool alive while the buffer is pending
+				bp->attach();
+				bufsz = pin->getRealBufferSize();
+			}
+		}
+
+		unlockTable(PEERS_TABLE);
+
+		if (!bp)
+			return NULL;
+
+		// get a buffer out of the locks, the pool may be empty
+		if (wait) {
+			bid = bp->getBuffer();
+		} else {
+			ret = bp->tryGetBuffer(&bid);
+			if (ret == FAILURE) {
+				getBlock()->setStarvedPool(bp);
+				if (bp->detach() <= 0)
+					delete bp;
+				return NULL;
+			}
+		}
+
+		_obuf = bp->use(bid);
+		_obp = bp;
+
+		// memory of pool buffers is allocated on use
+		if (_obuf->getSize() < bufsz)
+			_obuf->realloc(bufsz);
+
+		_obuf->setCount(0);
+
+		// ok
+		return _obuf;
+	}
+
+	int32 DataPin::commitOutputBuffer(avt_metadata* md, datainfo* di,
+		bool wait)
+	{
 		Logger* l = getBlock()->getBlockManager()->getLogger();
+		int32 delivered = 0;
 
-		if (getStatus() == UNCONNECTED) {
+		if (!_obuf)
+			return FAILURE;
+
+		if (!_obuf->getCount()) {
 			// log critical situation
-			l->log(Logger::LEVEL_ERROR, "%s: TrySendBuffer: Not Connected",
-				getBlock()->getName());
+			l->log(Logger::LEVEL_CRIT,
+				"%s: CommitOutputBuffer: EMPTY BUFFER (BID=%x,S=%u)",
+				getBlock()->getName(), _obuf->getBID(), _obuf->getSize());
+
+			abortOutputBuffer();
 
 			// fail
 			return FAILURE;
 		}
 
-		if (buf && !buf->getCount()) {
-			// log critical situation
-			l->log(Logger::LEVEL_CRIT,
-				"%s: TrySendBuffer: EMPTY BUFFER (BID=%x,A=%x,C=%u,S=%u)",
-				getBlock()->getName(), buf->getBID(), buf->getAddr(),
-				buf->getCount(), buf->getSize());
+		l->log(Logger::LEVEL_DEBUG, "%s: commitOutputBuffer(): [BID=%u,C=%u]",
+			getAbsoluteName(), _obuf->getBID(), _obuf->getCount());
 
-			// fail
+		if (_shm) {
+			delivered = (_commitToChannel(_obuf, md, di) == SUCCESS);
+			_obuf = NULL;
+			return (delivered ? SUCCESS : FAILURE);
+		}
+
+		// peers using the buffer's pool share it, others get a copy
+		if (getStatus() != UNCONNECTED) {
+			delivered = _deliver(&_obuf, 1, _obp, md, di, wait);
+		} else {
+			_obp->freeBuffer(_obuf->getBID());
+		}
+
+		if (_obp->detach() <= 0)
+			delete _obp;
+
+		_obuf = NULL;
+		_obp = NULL;
+
+		// SUCCESS means that every blocking peer (or any, if none) got it
+		return (delivered > 0 ? SUCCESS : FAILURE);
+	}
+
+	void DataPin::abortOutputBuffer(void)
+	{
+		if (!_obuf)
+			return;
+
+		if (_shm) {
+			_shm->abort(_obuf);
+			_obuf = NULL;
+			return;
+		}
+
+		_obp->freeBuffer(_obuf->getBID());
+
+		if (_obp->detach() <= 0)
+			delete _obp;
+
+		_obuf = NULL;
+		_obp = NULL;
+	}
+
+	int32 DataPin::attachChannel(ShmChannel* ch)
+	{
+		MutexLocker ml(this);
+
+		// wires and channels do not mix
+		if (_obuf || (ch && getPeersCount() > 0))
+			return FAILURE;
+
+		if (ch && ch->getMetaSize() != getChannelMetaSize())
+			return FAILURE;
+
+		_shm = ch;
+
+		// input buffers are read in place
+		if (getDirection() == DIR_INPUT)
+			setInputBufferPool(ch ? ch->getBufferPool() : NULL);
+
+		// ok
+		return SUCCESS;
+	}
+
+	int32 DataPin::_sendToChannel(DataBuf* buf, avt_metadata* md,
+		datainfo* di, bool wait)
+	{
+		DataBuf* out = NULL;
+
+		if (!buf || !buf->getCount())
+			return FAILURE;
+
+		out = _shm->acquire(wait);
+		if (!out)
+			return FAILURE;
+
+		// a payload larger than a channel buffer cannot be sent whole
+		if (buf->getCount() > out->getSize()) {
+			_shm->abort(out);
+			return FAILURE;
+		}
+
+		// the one copy into shared memory
+		out->copy(buf);
+
+		return _commitToChannel(out, md, di);
+	}
+
+	int32 DataPin::_commitToChannel(DataBuf* buf, avt_metadata* md,
+		datainfo* di)
+	{
+		char meta[sizeof(avt_metadata) + sizeof(datainfo)];
+		datainfo* mdi = (datainfo *) &meta[sizeof(avt_metadata)];
+
+		memset(meta, 0, sizeof(meta));
+		if (md)
+			memcpy(meta, md, sizeof(avt_metadata));
+		if (di)
+			memcpy(mdi, di, sizeof(datainfo));
+
+		/*
+		 * Do timestamping if SOURCE.
+		 */
+		if (getBlock()->getType() == Block::TYPE_SOURCE) {
+			getBlock()->getBlockManager()->getClockTime(&mdi->td);
+		}
+
+		return _shm->commit(buf, meta);
+	}
+
+	int32 DataPin::_recvFromChannel(dmessage* m, bool wait)
+	{
+		char meta[sizeof(avt_metadata) + sizeof(datainfo)];
+		DataBuf* db = NULL;
+
+		db = _shm->receive(meta, wait);
+		if (!db)
 			return FAILURE;
+
+		// the sender lives in another process
+		memset(m, 0, sizeof(dmessage));
+		m->bid = db->getBID();
+		memcpy(&m->info, meta, sizeof(avt_metadata));
+		memcpy(&m->di, &meta[sizeof(avt_metadata)], sizeof(datainfo));
+
+		// ok
+		return SUCCESS;
+	}
+
+	uint32 DataPin::_maxBatch(void)
+	{
+		Enumeration* en = NULL;
+		uint32 max = US_DP_MAX_BATCH;
+		BufferPool* bp = NULL;
+
+		lockTable(PEERS_TABLE);
+
+		/*
+		 * A batch waits for all its buffers before delivering them:
+		 * take at most half of the smallest pool, so that consumers
+		 * keep some buffers to work on.
+		 */
+		en = getPeers();
+		while (en->hasMoreElements()) {
+			DataPin* pin = (DataPin*) en->nextElement();
+			MutexLocker ml(pin);
+
+			bp = pin->getInputBufferPool();
+			if (bp && (uint32) bp->getBuffersCount() / 2 < max)
+				max = (uint32) bp->getBuffersCount() / 2;
+		}
+
+		unlockTable(PEERS_TABLE);
+
+		return (max ? max : 1);
+	}
+
+	int32 DataPin::_deliver(DataBuf** bufs, uint32 n, BufferPool* bp,
+		avt_metadata* md, datainfo* di, bool wait)
+	{
+		/*
+		 * Buffers filled during this delivery, for each distinct
+		 * buffer pool. Peers sharing a pool (point to multipoint wires)
+		 * share the same buffers: each of them holds a reference and a
+		 * buffer goes home when the last peer frees it.
+		 */
+		struct {
+			BufferPool* bp;
+			DataBuf* out[US_DP_MAX_BATCH];
+			uint32 count;
+		} filled[US_DP_MAX_SHARED_POOLS];
+
+		DataBuf* priv[US_DP_MAX_BATCH];
+		dmessage m[US_DP_MAX_BATCH];
+		Enumeration* en = NULL;
+		DataBuf** out = NULL;
+		dmessage tmpl;
+
+		uint32 nfilled = 0, count = 0, put = 0, first = 0, i = 0, k = 0;
+		int32 delivered = 0, lossy = 0, policy = 0;
+		bool pwait = false, blocking = false, missed = false;
+
+		Logger* l = getBlock()->getBlockManager()->getLogger();
+
+		// prepare message
+		memset(&tmpl, 0, sizeof(dmessage));
+		tmpl.from = getBlock();
+		tmpl.from_pin = this;
+
+		if (md)
+			memcpy(&tmpl.info, md, sizeof(avt_metadata));
+		if (di)
+			memcpy(&tmpl.di, di, sizeof(datainfo));
+
+		/*
+		 * Do timestamping if SOURCE.
+		 */
+		if (getBlock()->getType() == Block::TYPE_SOURCE) {
+			getBlock()->getBlockManager()->getClockTime(&tmpl.di.td);
+		}
+
+		// the caller's buffers are shared by the peers using their pool
+		if (bp) {
+			filled[0].bp = bp;
+			filled[0].count = n;
+			for (k = 0; k < n; k++)
+				filled[0].out[k] = bufs[k];
+			nfilled = 1;
 		}
 
 		// lock peers table
@@ -253,52 +773,141 @@ namespace uStreamLib {
 
 			/* ----- */
 
-			out = pin->tryGetFreeBuffer();
-			if (out) {
-				out->xcopy(buf);
+			// only blocking wires wait for the peer
+			Wire* w = getWire(pin);
+			policy = (w ? w->getBackPressure() : Wire::BP_BLOCK);
+			pwait = (wait && policy == Wire::BP_BLOCK);
 
-				m.bid = out->getBID();
-				m.from = getBlock();
-				m.from_pin = this;
+			if (policy == Wire::BP_BLOCK)
+				blocking = true;
 
-				if (md)
-					memcpy(&m.info, md, sizeof(avt_metadata));
-				if (di)
-					memcpy(&m.di, di, sizeof(datainfo));
+			// look for buffers already filled in peer's pool
+			out = NULL;
+			for (i = 0; i < nfilled; i++) {
+				if (filled[i].bp == pin->getInputBufferPool()) {
+					out = filled[i].out; count = filled[i].count; break;
+				}
+			}
 
-				/*
-				 * Do timestamping if SOURCE.
-				 */
-				if (getBlock()->getType() == Block::TYPE_SOURCE) {
-					getBlock()->getBlockManager()->getClockTime(&m.di.td);
+			if (!out) {
+				// too many pools: this peer gets private copies
+				out = (nfilled < US_DP_MAX_SHARED_POOLS ?
+					filled[nfilled].out : priv);
+
+				for (count = 0; count < n; count++) {
+					out[count] = (pwait ? pin->getFreeBuffer() :
+						pin->tryGetFreeBuffer());
+
+					// recycle the buffer of the oldest queued message
+					if (!out[count] && policy >= Wire::BP_DROP_OLDEST &&
+						pin->_evict(1, w))
+						out[count] = pin->tryGetFreeBuffer();
+
+					if (!out[count]) {
+						getBlock()->setStarvedPool(pin->getInputBufferPool());
+						if (policy == Wire::BP_BLOCK)
+							l->log(Logger::LEVEL_EMERG,
+								"%s: TrySendMessage(%s): no buffers in buffer pool",
+								getAbsoluteName(), pin->getAbsoluteName());
+						if (w)
+							w->countDrop(Wire::DROP_NO_BUFFER,
+								(int32) (n - count));
+						break;
+					}
+
+					out[count]->xcopy(bufs[count]);
 				}
 
 				/*
-				 * I cannot use sendMessage here because this method
-				 * creates an enumeration of peers, invalidating the
-				 * enum on which this cycle is based.
+				 * Keep the references taken by getFreeBuffer() until
+				 * every peer got its own ones.
 				 */
-				ret = pin->_iq.tryPut((char *) &m, sizeof(dmessage));
-				if (ret == FAILURE) {
+				if (out != priv) {
+					filled[nfilled].bp = pin->getInputBufferPool();
+					filled[nfilled].count = count;
+					nfilled++;
+
+					for (k = 0; k < count; k++)
+						out[k]->addRef();
+				}
+			} else {
+				for (k = 0; k < count; k++)
+					out[k]->addRef();
+			}
+
+			if (!count) {
+				if (policy == Wire::BP_BLOCK)
+					missed = true;
+				continue;
+			}
+
+			for (k = 0; k < count; k++) {
+				memcpy(&m[k], &tmpl, sizeof(dmessage));
+				m[k].bid = out[k]->getBID();
+			}
+
+			// only the newest message replaces the queued ones
+			first = 0;
+			if (policy == Wire::BP_KEEP_LATEST) {
+				pin->_evict(0xffffffff, w);
+
+				first = count - 1;
+				for (k = 0; k < first; k++)
+					pin->freeInputBuffer(out[k]->getBID());
+				if (w)
+					w->countDrop(Wire::DROP_EVICTED, (int32) first);
+			}
+
+			/*
+			 * I cannot use sendMessage here because this method
+			 * creates an enumeration of peers, invalidating the
+			 * enum on which this cycle is based.
+			 */
+			put = first + pin->_putMany(&m[first], count - first, pwait);
+
+			// make room evicting the oldest messages, then retry
+			if (put < count && policy >= Wire::BP_DROP_OLDEST) {
+				pin->_evict(count - put, w);
+				put += pin->_putMany(&m[put], count - put, false);
+			}
+
+			if (put < count) {
+				if (policy == Wire::BP_BLOCK)
 					l->log(Logger::LEVEL_EMERG,
 						"%s: dmessage queue is full for pin %s",
 						getAbsoluteName(), pin->getAbsoluteName());
+				if (w)
+					w->countDrop(Wire::DROP_QUEUE_FULL, (int32) (count - put));
+			}
 
-					pin->freeInputBuffer(out->getBID());
-				} else {
-					ok = SUCCESS;
-				}
-			} else {
-				l->log(Logger::LEVEL_EMERG,
-					"%s: TrySendMessage(%s): no buffers in buffer pool",
-					getAbsoluteName(), pin->getAbsoluteName());
+			// drop the references of undelivered messages
+			for (k = put; k < count; k++)
+				pin->freeInputBuffer(out[k]->getBID());
+
+			// peers on lossy wires accept anything: they do not count
+			if (put > first) {
+				if (policy == Wire::BP_BLOCK)
+					delivered++;
+				else
+					lossy++;
 			}
+
+			if (policy == Wire::BP_BLOCK && put < n)
+				missed = true;
+		}
+
+		// drop the references we kept while delivering
+		for (i = 0; i < nfilled; i++) {
+			for (k = 0; k < filled[i].count; k++)
+				filled[i].bp->freeBuffer(filled[i].out[k]->getBID());
 		}
 
 		// unlock peers table
 		unlockTable(PEERS_TABLE);
 
 		// ok
-		return ok;
+		if (!blocking)
+			return lossy;
+		return (missed ? 0 : delivered);
 	}
 }
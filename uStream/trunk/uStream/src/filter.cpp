@@ -63,8 +63,20 @@ namespace uStreamLib {
 		// initialize members
 		_started = false;
 		_quit = false;
+		_wouldBlock = false;
+		_dataReady = false;
+		_consumed = false;
 		_doProduce = false;
 		_doFilter = false;
+		_replicas = NULL;
+		_replicasCount = 0;
+		_jobs = NULL;
+		_window = 0;
+		_issued = 0;
+		_sent = 0;
+		_rin = NULL;
+		_rout = NULL;
+		_replicasChecked = false;
 
 		/*
 		 * Create a semaphore which starts with the 0 value.
@@ -76,293 +88,655 @@ namespace uStreamLib {
 		if (ret == FAILURE)
 			return FAILURE;
 
+		ret = _mutexRound.init();
+		if (ret == FAILURE)
+			return FAILURE;
+
 		// ok
 		return SUCCESS;
 	}
 
 	void Filter::run(void)
 	{
-		int32 ret = 0, is_msg = 0, handler_ret = 0;
-		int32 data_ready = 0, cur_handler = 0;
+		int32 ret = 0;
 		cmessage cm;
 
-		char* handler_name[] = {
-			"data_consume", "data_produce", "data_filter"
-		};
-
-		Logger* sl = getBlockManager()->getLogger();
-
 		while (!_quit) {
-			if (_started) {
+			if (_acts() && _wouldBlock) {
+				if (!_consumed && hasInputData()) {
+					// data came before the last round: consume it first
+					_dataReady = true;
+					ret = FAILURE;
+				} else {
+					// sleep until something happens
+					ret = waitForControlMessage(&cm);
+					if (hasInputData())
+						_dataReady = true;
+				}
+			} else if (_acts()) {
 				// get a message from control pin w/o blocking
 				ret = getControlPin()->tryRecvMessage(&cm);
-				if (ret == SUCCESS)
-					is_msg = 1;
 			} else {
 				// get a message from control pin blocking
 				ret = getControlPin()->recvMessage(&cm);
-				if (ret == SUCCESS)
-					is_msg = 1;
 			}
 
-			if (is_msg) {
-				// detect terminate event
-				if (cm.code == Block::EVENT_TERMINATE) {
-					_started = false; _quit = true;
-					sl->log(Logger::LEVEL_NOTICE,
-							"%s: terminate request received", getName());
-
-					// set status
-					setStatus(STATUS_TERMINATING);
-				} else {
-					// check message codes and set status
-					switch (cm.code) {
-					case EVENT_PAUSE:
-						setStatus(STATUS_PAUSED);
-						_started = false;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: pause request received", getName());
-						break;
-					case EVENT_RESET:
-						setStatus(STATUS_RESETTING);
-						_started = false;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: reset request received", getName());
-						break;
-					case EVENT_START:
-						setStatus(STATUS_STARTED);
-						_started = true;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: start request received", getName());
-						break;
-					case EVENT_STOP:
-						setStatus(STATUS_STOPPED);
-						_started = false;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: stop request received", getName());
-						break;
-					case EVENT_BUFFERIZE:
-						setStatus(STATUS_BUFFERIZING);
-						_started = true;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: bufferize request received", getName());
-						break;
-					case EVENT_SEEK:
-						setStatus(STATUS_SEEKING);
-						setSeekInfo(&cm.seek);
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: seek request received", getName());
-						break;
-					case EVENT_TELL:
-						setStatus(STATUS_TELLING);
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: tell request received", getName());
-						break;
-					case EVENT_SKIP:
-						setStatus(STATUS_SKIPPING);
-						_started = true; setSeekInfo(&cm.seek);
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: skip request received", getName());
-						break;
-					case EVENT_QUIT:
-						setStatus(STATUS_QUITTING);
-						_started = false; _quit = true;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: quit request received", getName());
-						break;
-					case EVENT_TIMEOUT:
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: timeout request received", getName());
-						break;
-					case EVENT_DATA_READY:
-						setStatus(STATUS_STARTED);
-						_started = true; data_ready = 1;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: data_ready request received", getName());
-						break;
-					case EVENT_COMMAND:
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: command request received", getName());
-						break;
-					default:
-						if (cm.code >= EVENT_MAX_ID)
-							sl->log(Logger::LEVEL_CRIT,
-									"%s: invalid message code (%d)",
-									getName(), cm.code);
-						else
-							sl->log(Logger::LEVEL_CRIT,
-									"%s: user message %d received", getName(),
-									cm.code);
-					}
+			_runOnce(ret == SUCCESS ? &cm : NULL);
+		}
 
-					// execute event handler for this message code
-					handler_ret = executeEventHandler(cm.code);
-					if (handler_ret == Block::HANDLER_UNDEFINED) {
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: undefined handler %d", getName(), cm.code);
-					} else if (handler_ret == BlockHandler::HFAILURE) {
-						_started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_ERROR, "%s: handler %d failed",
-								getName(), cm.code);
-					}
+		_quitting();
+	}
 
-					/*
-					 * This block checks for StatusListeners availability. If
-					 * any status listener has been registered, this block sends
-					 * status messages to it.
-					 */
-					if (cm.status_listener) {
-						// DEBUG
-						//UOSUTIL_DOUT((stderr, "Untested code: status listener\n"));
-
-						smessage sm;
-						memset(&sm, 0, sizeof(smessage));
-
-						sm.code = cm.code;
-						sm.serial = cm.serial;
-						sm.status = getStatus();
-						sm.eh_return = handler_ret;
-						snprintf(sm.error, SM_MESSAGE_SZ, "%s",
-							getErrorString());
-
-						ret = cm.status_listener->notifyStatusMessage(&sm);
-						if (ret == FAILURE) {
-							sl->log(Logger::LEVEL_WARN,
-									"%s: cannot notify status to registered listener",
-									getName());
-						}
-
-						// DEBUG
-						//UOSUTIL_DOUT((stderr, "Untested code: status listener end\n"));
-					}
+	int32 Filter::step(void)
+	{
+		int32 i = 0;
+		cmessage cm;
 
-					// set status to ready if compatible
-					if (cm.code != EVENT_START &&
-						cm.code != EVENT_STOP &&
-						cm.code != EVENT_PAUSE &&
-						cm.code != EVENT_DATA_READY &&
-						cm.code != EVENT_COMMAND)
-						setStatus(STATUS_READY);
+		// something happened since the last step
+		if (_wouldBlock) {
+			_wouldBlock = false;
+			if (hasInputData())
+				_dataReady = true;
+		}
 
-					// wait for next message
-					is_msg = 0;
-				}
+		for (i = 0; i < US_BLOCK_TASK_QUANTUM && !_quit; i++) {
+			if (getControlPin()->tryRecvMessage(&cm) == SUCCESS) {
+				_runOnce(&cm);
+			} else if (_acts() && _wouldBlock && !_consumed &&
+				hasInputData()) {
+				// data came before the last round: consume it first
+				_dataReady = true;
+				_runOnce(NULL);
+			} else if (_acts() && !_wouldBlock) {
+				_runOnce(NULL);
+			} else {
+				break;
 			}
+		}
 
-			if (_started) {
-				/*
-				 * this flags control execution of filtering and production.
-				 * if data_consume returns values different from HSUCCESS,
-				 * _doFilter will be set to 0, making uStream not invoke
-				 * data_filter.
-				 * if data_filter returns values different from HSUCCESS,
-				 * _doProduce will be set to 0, making uStream not invoke
-				 * data_produce.
-				 */
-				_doFilter = 1;	_doProduce = true;
-
-				if (data_ready) {
-					/*
-					 * get data if ready and handle error conditions;
-					 * if handler returns HSUCCESS, do further processing,
-					 * else don't invoke filter and produce.
-					 */
-					cur_handler = 0;
-					handler_ret = executeActionHandler(ACTION_DATA_CONSUME);
-					if (handler_ret == Block::HANDLER_UNDEFINED) {
-						_doFilter = 0; _started = false; setStatus(STATUS_READY);
+		if (_quit) {
+			_quitting();
+			return Task::TASK_DONE;
+		}
+
+		// nothing to do now: sleep
+		if (_acts() && _wouldBlock)
+			return idleStep();
+
+		return i < US_BLOCK_TASK_QUANTUM ? Task::TASK_IDLE : Task::TASK_READY;
+	}
+
+	void Filter::_runOnce(cmessage* cm)
+	{
+		int32 ret = 0, handler_ret = 0;
+
+		Logger* sl = getBlockManager()->getLogger();
+
+		// wake ups carry no command
+		if (cm && cm->code == EVENT_WAKEUP)
+			cm = NULL;
+
+		if (cm) {
+			// detect terminate event
+			if (cm->code == Block::EVENT_TERMINATE) {
+				_started = false; _quit = true;
+				sl->log(Logger::LEVEL_NOTICE,
+						"%s: terminate request received", getName());
+
+				// set status
+				setStatus(STATUS_TERMINATING);
+			} else {
+				// check message codes and set status
+				switch (cm->code) {
+				case EVENT_PAUSE:
+					setStatus(STATUS_PAUSED);
+					_started = false;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: pause request received", getName());
+					releaseBuffers(true);
+					break;
+				case EVENT_RESET:
+					setStatus(STATUS_RESETTING);
+					_started = false;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: reset request received", getName());
+					break;
+				case EVENT_START:
+					setStatus(STATUS_STARTED);
+					_started = true; _replicasChecked = false;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: start request received", getName());
+					break;
+				case EVENT_STOP:
+					setStatus(STATUS_STOPPED);
+					_started = false;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: stop request received", getName());
+					releaseBuffers(true);
+					break;
+				case EVENT_BUFFERIZE:
+					setStatus(STATUS_BUFFERIZING);
+					_started = true;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: bufferize request received", getName());
+					break;
+				case EVENT_SEEK:
+					setStatus(STATUS_SEEKING);
+					setSeekInfo(&cm->seek);
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: seek request received", getName());
+					break;
+				case EVENT_TELL:
+					setStatus(STATUS_TELLING);
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: tell request received", getName());
+					break;
+				case EVENT_SKIP:
+					setStatus(STATUS_SKIPPING);
+					_started = true; setSeekInfo(&cm->seek);
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: skip request received", getName());
+					break;
+				case EVENT_QUIT:
+					setStatus(STATUS_QUITTING);
+					_started = false; _quit = true;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: quit request received", getName());
+					break;
+				case EVENT_TIMEOUT:
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: timeout request received", getName());
+					break;
+				case EVENT_DATA_READY:
+					setStatus(STATUS_STARTED);
+					_started = true; _dataReady = true;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: data_ready request received", getName());
+					break;
+				case EVENT_COMMAND:
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: command request received", getName());
+					break;
+				default:
+					if (cm->code >= EVENT_MAX_ID)
 						sl->log(Logger::LEVEL_CRIT,
-								"%s: undefined action handler for %s",
-								getName(), handler_name[cur_handler]);
-					} else if (handler_ret == BlockHandler::HSUCCESS) {
-						_doFilter = 1;
-						// DO NOTHING HERE (useless log)
-					} else if (handler_ret == BlockHandler::HFAILURE) {
-						_doFilter = 0; _started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_ERROR,
-						   		"%s: action handler for %s returned FAILURE",
-						   		getName(), handler_name[cur_handler]);
-					} else if (handler_ret == BlockHandler::HCRITICAL) {
-						_doFilter = 0; _started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_EMERG,
-						   		"%s: action handler for %s returned CRITICAL FAILURE",
-						   		getName(), handler_name[cur_handler]);
-					} else {
-						_doFilter = 0; _started = false; setStatus(STATUS_READY);
+								"%s: invalid message code (%d)",
+								getName(), cm->code);
+					else
 						sl->log(Logger::LEVEL_CRIT,
-						   		"%s: action handler for %s returned undefined value",
-						   		getName(), handler_name[cur_handler]);
-					}
+								"%s: user message %d received", getName(),
+								cm->code);
 				}
 
-				/*
-				 * don't invoke filter if consume does not return HSUCCESS.
-				 */
-				if (_doFilter) {
-					cur_handler = 2;
-					handler_ret = executeActionHandler(ACTION_DATA_FILTER);
-					if (handler_ret == Block::HANDLER_UNDEFINED) {
-						_doProduce = false; _started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_CRIT,
-								"%s: undefined action handler for %s",
-								getName(), handler_name[cur_handler]);
-					} else if (handler_ret == BlockHandler::HSUCCESS) {
-						_doProduce = true;
-						// DO NOTHING HERE (useless log)
-					} else if (handler_ret == BlockHandler::HFAILURE) {
-						_doProduce = false; _started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_ERROR,
-						   		"%s: action handler for %s returned FAILURE",
-						   		getName(), handler_name[cur_handler]);
-					} else if (handler_ret == BlockHandler::HCRITICAL) {
-						_doProduce = false; _started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_EMERG,
-						   		"%s: action handler for %s returned CRITICAL FAILURE",
-						   		getName(), handler_name[cur_handler]);
-					} else {
-						_doProduce = false; _started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_CRIT,
-						   		"%s: action handler for %s returned undefined value",
-						   		getName(), handler_name[cur_handler]);
-					}
+				// execute event handler for this message code
+				handler_ret = executeEventHandler(cm->code);
+				if (handler_ret == Block::HANDLER_UNDEFINED) {
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: undefined handler %d", getName(), cm->code);
+				} else if (handler_ret == BlockHandler::HFAILURE) {
+					_started = false; setStatus(STATUS_READY);
+					sl->log(Logger::LEVEL_ERROR, "%s: handler %d failed",
+							getName(), cm->code);
 				}
 
 				/*
-				 * invoke produce only if filter returned HSUCCESS.
+				 * This block checks for StatusListeners availability. If
+				 * any status listener has been registered, this block sends
+				 * status messages to it.
 				 */
-				if (_doProduce) {
-					cur_handler = 1;
-					handler_ret = executeActionHandler(ACTION_DATA_PRODUCE);
-					if (handler_ret == Block::HANDLER_UNDEFINED) {
-						_started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_CRIT,
-								"%s: undefined action handler for %s",
-								getName(), handler_name[cur_handler]);
-					} else if (handler_ret == BlockHandler::HSUCCESS) {
-						// DO NOTHING HERE (useless log)
-					} else if (handler_ret == BlockHandler::HFAILURE) {
-						   	_started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_ERROR,
-						   		"%s: action handler for %s returned FAILURE",
-						   		getName(), handler_name[cur_handler]);
-					} else if (handler_ret == BlockHandler::HCRITICAL) {
-						   	_started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_EMERG,
-						   		"%s: action handler for %s returned CRITICAL FAILURE",
-						   		getName(), handler_name[cur_handler]);
-					} else {
-						   	_started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_CRIT,
-						   		"%s: action handler for %s returned undefined value",
-						   		getName(), handler_name[cur_handler]);
+				if (cm->status_listener) {
+					// DEBUG
+					//UOSUTIL_DOUT((stderr, "Untested code: status listener\n"));
+
+					smessage sm;
+					memset(&sm, 0, sizeof(smessage));
+
+					sm.code = cm->code;
+					sm.serial = cm->serial;
+					sm.status = getStatus();
+					sm.eh_return = handler_ret;
+					snprintf(sm.error, SM_MESSAGE_SZ, "%s",
+						getErrorString());
+
+					ret = cm->status_listener->notifyStatusMessage(&sm);
+					if (ret == FAILURE) {
+						sl->log(Logger::LEVEL_WARN,
+								"%s: cannot notify status to registered listener",
+								getName());
 					}
+
+					// DEBUG
+					//UOSUTIL_DOUT((stderr, "Untested code: status listener end\n"));
 				}
 
-				// reset data_ready flag
-				data_ready = 0;
+				// set status to ready if compatible
+				if (cm->code != EVENT_START &&
+					cm->code != EVENT_STOP &&
+					cm->code != EVENT_PAUSE &&
+					cm->code != EVENT_DATA_READY &&
+					cm->code != EVENT_COMMAND)
+					setStatus(STATUS_READY);
+
+				// let the head of the chain see the new state
+				if (getFusedPrev() && cm->code != EVENT_DATA_READY)
+					wakeFusedHead();
+			}
+		}
+
+		if (_acts())
+			_act();
+	}
+
+	bool Filter::_act(void)
+	{
+		int32 handler_ret = 0, cur_handler = 0;
+
+		char* handler_name[] = {
+			"data_consume", "data_produce", "data_filter"
+		};
+
+		Logger* sl = getBlockManager()->getLogger();
+
+		/*
+		 * The upstream block may run this round too (see fuse()).
+		 */
+		_mutexRound.lock();
+
+		_wouldBlock = false;
+
+		/*
+		 * this flags control execution of filtering and production.
+		 * if data_consume returns values different from HSUCCESS,
+		 * _doFilter will be set to 0, making uStream not invoke
+		 * data_filter.
+		 * if data_filter returns values different from HSUCCESS,
+		 * _doProduce will be set to 0, making uStream not invoke
+		 * data_produce.
+		 */
+		_doFilter = 1;	_doProduce = true;
+		_consumed = _dataReady;
+
+		// replicas do the work instead of the action handlers
+		if (!_replicasChecked)
+			_startReplicas();
+
+		if (_replicas) {
+			_doFilter = 0; _doProduce = false; _consumed = true;
+			_wouldBlock = !_actReplicas();
+		}
+
+		if (_dataReady && !_replicas) {
+			/*
+			 * get data if ready and handle error conditions;
+			 * if handler returns HSUCCESS, do further processing,
+			 * else don't invoke filter and produce.
+			 */
+			cur_handler = 0;
+			handler_ret = executeActionHandler(ACTION_DATA_CONSUME);
+			if (handler_ret == Block::HANDLER_UNDEFINED) {
+				_doFilter = 0; _started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_CRIT,
+						"%s: undefined action handler for %s",
+						getName(), handler_name[cur_handler]);
+			} else if (handler_ret == BlockHandler::HSUCCESS) {
+				_doFilter = 1;
+				// DO NOTHING HERE (useless log)
+			} else if (handler_ret == BlockHandler::HWOULDBLOCK) {
+				_doFilter = 0; _wouldBlock = true;
+			} else if (handler_ret == BlockHandler::HFAILURE) {
+				_doFilter = 0; _started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_ERROR,
+				   		"%s: action handler for %s returned FAILURE",
+				   		getName(), handler_name[cur_handler]);
+			} else if (handler_ret == BlockHandler::HCRITICAL) {
+				_doFilter = 0; _started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_EMERG,
+				   		"%s: action handler for %s returned CRITICAL FAILURE",
+				   		getName(), handler_name[cur_handler]);
+			} else {
+				_doFilter = 0; _started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_CRIT,
+				   		"%s: action handler for %s returned undefined value",
+				   		getName(), handler_name[cur_handler]);
+			}
+		}
+
+		/*
+		 * don't invoke filter if consume does not return HSUCCESS.
+		 */
+		if (_doFilter) {
+			cur_handler = 2;
+			handler_ret = executeActionHandler(ACTION_DATA_FILTER);
+			if (handler_ret == Block::HANDLER_UNDEFINED) {
+				_doProduce = false; _started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_CRIT,
+						"%s: undefined action handler for %s",
+						getName(), handler_name[cur_handler]);
+			} else if (handler_ret == BlockHandler::HSUCCESS) {
+				_doProduce = true;
+				// DO NOTHING HERE (useless log)
+			} else if (handler_ret == BlockHandler::HWOULDBLOCK) {
+				_doProduce = false; _wouldBlock = true;
+			} else if (handler_ret == BlockHandler::HFAILURE) {
+				_doProduce = false; _started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_ERROR,
+				   		"%s: action handler for %s returned FAILURE",
+				   		getName(), handler_name[cur_handler]);
+			} else if (handler_ret == BlockHandler::HCRITICAL) {
+				_doProduce = false; _started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_EMERG,
+				   		"%s: action handler for %s returned CRITICAL FAILURE",
+				   		getName(), handler_name[cur_handler]);
+			} else {
+				_doProduce = false; _started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_CRIT,
+				   		"%s: action handler for %s returned undefined value",
+				   		getName(), handler_name[cur_handler]);
+			}
+		}
+
+		/*
+		 * invoke produce only if filter returned HSUCCESS.
+		 */
+		if (_doProduce) {
+			cur_handler = 1;
+			handler_ret = executeActionHandler(ACTION_DATA_PRODUCE);
+			if (handler_ret == Block::HANDLER_UNDEFINED) {
+				_started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_CRIT,
+						"%s: undefined action handler for %s",
+						getName(), handler_name[cur_handler]);
+			} else if (handler_ret == BlockHandler::HSUCCESS) {
+				// DO NOTHING HERE (useless log)
+			} else if (handler_ret == BlockHandler::HWOULDBLOCK) {
+				_wouldBlock = true;
+			} else if (handler_ret == BlockHandler::HFAILURE) {
+				   	_started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_ERROR,
+				   		"%s: action handler for %s returned FAILURE",
+				   		getName(), handler_name[cur_handler]);
+			} else if (handler_ret == BlockHandler::HCRITICAL) {
+				   	_started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_EMERG,
+				   		"%s: action handler for %s returned CRITICAL FAILURE",
+				   		getName(), handler_name[cur_handler]);
+			} else {
+				   	_started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_CRIT,
+				   		"%s: action handler for %s returned undefined value",
+				   		getName(), handler_name[cur_handler]);
+			}
+		}
+
+		// reset data_ready flag
+		_dataReady = false;
+
+		_mutexRound.unlock();
+
+		// fused filters go on with the data
+		if (!runFusedNext())
+			return false;
+
+		_wouldBlock = false;
+		return true;
+	}
+
+	bool Filter::fusedRound(void)
+	{
+		if (!_started || _quit)
+			return false;
+
+		// no data ready events between fused blocks
+		_dataReady = hasInputData();
+
+		if (_act())
+			return true;
+
+		// consumed data (see _doFilter)
+		return _consumed && _doFilter;
+	}
+
+	void Filter::_startReplicas(void)
+	{
+		Logger* sl = getBlockManager()->getLogger();
+		int32 count = 0;
+		uint32 i = 0;
+		char name[128];
+
+		_replicasChecked = true;
+
+		if (_replicas || getInt(USBL_REPLICAS, &count) == FAILURE ||
+			count < 1)
+			return;
+
+		// one input pin and one output pin
+		_rin = NULL; _rout = NULL;
+
+		lockTable(INPUT_TABLE);
+		Enumeration* ins = getInputPins();
+		if (ins->hasMoreElements())
+			_rin = (DataPin *) ins->nextElement();
+		if (ins->hasMoreElements())
+			_rin = NULL;
+		unlockTable(INPUT_TABLE);
+
+		lockTable(OUTPUT_TABLE);
+		Enumeration* outs = getOutputPins();
+		if (outs->hasMoreElements())
+			_rout = (DataPin *) outs->nextElement();
+		if (outs->hasMoreElements())
+			_rout = NULL;
+		unlockTable(OUTPUT_TABLE);
+
+		if (!_rin || !_rout) {
+			sl->log(Logger::LEVEL_ERROR,
+				"%s: replicas need one input pin and one output pin",
+				getName());
+			return;
+		}
+
+		// twice as many buffers in flight as replicas
+		for (_window = 2; _window < (uint32) count * 2; _window <<= 1)
+			;
+
+		_jobs = new Job[_window];
+		for (i = 0; i < _window; i++) {
+			_jobs[i].done = 0;
+			if (_jobs[i].out.init(_rout->getPreferredBufferSize(), 0,
+				_rout->getPreferredBufferSize()) == FAILURE) {
+				delete [] _jobs; _jobs = NULL;
+				return;
+			}
+		}
+
+		_issued = 0;
+		_sent = 0;
+
+		_replicas = new Replica*[count];
+		for (i = 0; i < (uint32) count; i++) {
+			snprintf(name, sizeof(name), "%s.%u", getName(), i);
+
+			_replicas[i] = new Replica(this);
+			if (_replicas[i]->init(name, _window) == FAILURE) {
+				delete _replicas[i];
+				break;
+			}
+
+			_replicas[i]->start();
+		}
+
+		_replicasCount = i;
+		if (!_replicasCount) {
+			_stopReplicas();
+			sl->log(Logger::LEVEL_ERROR, "%s: cannot start replicas",
+				getName());
+			return;
+		}
+
+		sl->log(Logger::LEVEL_NOTICE, "%s: %u replicas started", getName(),
+			_replicasCount);
+	}
+
+	void Filter::_stopReplicas(void)
+	{
+		uint32 i = 0;
+
+		if (_replicas) {
+			for (i = 0; i < _replicasCount; i++)
+				_replicas[i]->stop();
+
+			// wait for the threads to exit before freeing them
+			for (i = 0; i < _replicasCount; i++) {
+				_replicas[i]->join(NULL);
+				delete _replicas[i];
+			}
+
+			delete [] _replicas;
+			_replicas = NULL;
+			_replicasCount = 0;
+		}
+
+		if (_jobs) {
+			delete [] _jobs;
+			_jobs = NULL;
+		}
+	}
+
+	bool Filter::_actReplicas(void)
+	{
+		Logger* sl = getBlockManager()->getLogger();
+		Job* j = NULL;
+		dmessage m;
+		uint32 i = 0, r = 0;
+		bool moved = false, sent = false;
+
+		// send the transformed buffers in input order
+		while (_sent != _issued) {
+			j = &_jobs[_sent & (_window - 1)];
+			if (!Atomic::load(&j->done))
+				break;
+
+			if (j->ret == Block::HANDLER_UNDEFINED) {
+				_started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_CRIT, "%s: undefined transform()",
+						getName());
+			} else if (j->ret == BlockHandler::HFAILURE) {
+				_started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_ERROR,
+						"%s: transform() returned FAILURE", getName());
+			} else if (j->ret == BlockHandler::HCRITICAL) {
+				_started = false; setStatus(STATUS_READY);
+				sl->log(Logger::LEVEL_EMERG,
+						"%s: transform() returned CRITICAL FAILURE",
+						getName());
+			} else if (j->out.getCount() &&
+				_rout->trySendBuffer(&j->out, 0, &j->m.info,
+				&j->m.di) == FAILURE) {
+				// peers are full: send it later
+				break;
+			} else if (j->out.getCount()) {
+				sent = true;
+			}
+
+			Atomic::store(&j->done, 0);
+			_sent++; moved = true;
+		}
+
+		if (sent)
+			notifyPeersOf(_rout);
+
+		// hand out new buffers to the least loaded replicas
+		while (_started && _issued - _sent < _window &&
+			_rin->tryRecvMessage(&m) == SUCCESS) {
+			j = &_jobs[_issued & (_window - 1)];
+			j->m = m;
+			j->m.seq = _issued;
+
+			for (i = 1, r = 0; i < _replicasCount; i++) {
+				if (_replicas[i]->getPending() < _replicas[r]->getPending())
+					r = i;
 			}
+
+			_replicas[r]->push(_issued & (_window - 1));
+			_issued++; moved = true;
+		}
+
+		return moved;
+	}
+
+	void Filter::_runJob(uint32 job)
+	{
+		Job* j = &_jobs[job];
+		DataBuf* in = _rin->getInputBuffer(j->m.bid);
+
+		j->out.setCount(0);
+		j->ret = in ? transform(&j->m, in, &j->out) : BlockHandler::HSUCCESS;
+
+		_rin->freeInputBuffer(j->m.bid);
+
+		// the filter sends it
+		Atomic::store(&j->done, 1);
+		wakeUp();
+	}
+
+	void Filter::_dropJob(uint32 job)
+	{
+		_rin->freeInputBuffer(_jobs[job].m.bid);
+	}
+
+	int32 Filter::Replica::init(char* name, uint32 window)
+	{
+		int32 ret = 0;
+
+		ret = _queue.init(name, (int32) window);
+		if (ret == FAILURE)
+			return FAILURE;
+
+		return Thread::init(name);
+	}
+
+	void Filter::Replica::run(void)
+	{
+		uint32 job = 0;
+
+		while (!_quit) {
+			if (_queue.get(&job) == FAILURE)
+				continue;
+
+			_filter->_runJob(job);
+			Atomic::decrement(&_pending);
 		}
 
+		// the filter is quitting: give back the buffers
+		while (_queue.tryGet(&job) == SUCCESS)
+			_filter->_dropJob(job);
+	}
+
+	void Filter::Replica::stop(void)
+	{
+		_quit = true;
+		_queue.wakeConsumer();
+	}
+
+	void Filter::Replica::push(uint32 job)
+	{
+		Atomic::increment(&_pending);
+		_queue.put(&job);
+	}
+
+	void Filter::_quitting(void)
+	{
+		Logger* sl = getBlockManager()->getLogger();
+
+		// the chain goes on without this block
+		unfuse();
+
+		// wait for a round run by the upstream block
+		_mutexRound.lock();
+		_mutexRound.unlock();
+
+		_stopReplicas();
+
 		// release the quit semaphore
 		sl->log(Logger::LEVEL_CRIT,
 				"%s: Releasing QUIT SEMAPHORE (so quitting)", getName());
@@ -386,8 +760,5 @@ namespace uStreamLib {
 		bmm.from = this;
 
 		getControlPin()->sendMessage(&bmm);
-
-		// go away and don't execute any code (only onPostSelect())
-		return;
 	}
 }
@@ -21,6 +21,7 @@
 
 #include "block_manager.hpp"
 #include "source.hpp"
+#include "timer.hpp"
 
 namespace uStreamLib {
 	Source::Source(void)
@@ -62,6 +63,13 @@ namespace uStreamLib {
 		// initialize members
 		_started = false;
 		_quit = false;
+		_wouldBlock = false;
+		_period = 0;
+		_periodRem = 0;
+		_periodDen = 1;
+		_periodAcc = 0;
+		_next = 0;
+		_overruns = 0;
 
 		/*
 		 * Create a semaphore which starts with the 0 value.
@@ -79,198 +87,356 @@ namespace uStreamLib {
 
 	void Source::run(void)
 	{
-		int32 ret = 0, is_msg = 0, handler_ret = 0;
+		int32 ret = 0;
 		cmessage cm;
 
-		Logger* sl = getBlockManager()->getLogger();
-
 		while (!_quit) {
-			if (_started) {
+			if (_started && (_period || _periodRem)) {
+				// sleep until the next period
+				ret = _waitTick(&cm);
+			} else if (_started && _wouldBlock) {
+				// sleep until something happens
+				ret = waitForControlMessage(&cm);
+			} else if (_started) {
 				// get a message from control pin w/o blocking
 				ret = getControlPin()->tryRecvMessage(&cm);
-				if (ret == SUCCESS)
-					is_msg = 1;
 			} else {
 				// get a message from control pin blocking
 				ret = getControlPin()->recvMessage(&cm);
-				if (ret == SUCCESS)
-					is_msg = 1;
 			}
 
-			if (is_msg) {
-				// detect terminate event
-				if (cm.code == Block::EVENT_TERMINATE) {
-					_started = false; _quit = true;
-					sl->log(Logger::LEVEL_NOTICE,
-							"%s: terminate request received", getName());
-
-					// set status
-					setStatus(STATUS_TERMINATING);
-
-					// jump to while()
-					//continue;  TODO: Is this needed?
-				} else {
-					// check message codes and set status
-					switch (cm.code) {
-					case EVENT_PAUSE:
-						setStatus(STATUS_PAUSED);
-						_started = false;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: pause request received", getName());
-						break;
-					case EVENT_RESET:
-						setStatus(STATUS_RESETTING);
-						_started = false;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: reset request received", getName());
-						break;
-					case EVENT_START:
-						setStatus(STATUS_STARTED);
-						_started = true;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: start request received", getName());
-						break;
-					case EVENT_STOP:
-						setStatus(STATUS_STOPPED);
-						_started = false;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: stop request received", getName());
-						break;
-					case EVENT_BUFFERIZE:
-						setStatus(STATUS_BUFFERIZING);
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: bufferize request received (strange)",
-								getName());
-						break;
-					case EVENT_SEEK:
-						setStatus(STATUS_SEEKING);
-						setSeekInfo(&cm.seek);
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: seek request received", getName());
-						break;
-					case EVENT_TELL:
-						setStatus(STATUS_TELLING);
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: tell request received", getName());
-						break;
-					case EVENT_SKIP:
-						setStatus(STATUS_SKIPPING);
-						setSeekInfo(&cm.seek);
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: skip request received (strange)",
-								getName());
-						break;
-					case EVENT_QUIT:
-						setStatus(STATUS_QUITTING);
-						_started = false; _quit = true;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: quit request received", getName());
-						break;
-					case EVENT_TIMEOUT:
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: timeout request received", getName());
-						break;
-					case EVENT_DATA_READY:
-						setStatus(STATUS_READY);
-						_started = false;
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: mmh, data_ready request received",
-								getName());
-						break;
-					case EVENT_COMMAND:
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: command request received", getName());
-						break;
-					default:
-						if (cm.code >= EVENT_MAX_ID)
-							sl->log(Logger::LEVEL_CRIT,
-									"%s: invalid message code (%d)",
-									getName(), cm.code);
-						else
-							sl->log(Logger::LEVEL_CRIT,
-									"%s: user message %d received", getName(),
-									cm.code);
-					}
+			_runOnce(ret == SUCCESS ? &cm : NULL);
+		}
 
-					// execute event handler for this message code
-					handler_ret = executeEventHandler(cm.code);
-					if (handler_ret == Block::HANDLER_UNDEFINED) {
-						sl->log(Logger::LEVEL_NOTICE,
-								"%s: undefined handler %d", getName(), cm.code);
-					} else if (handler_ret == BlockHandler::HFAILURE) {
-						_started = false; setStatus(STATUS_READY);
-						sl->log(Logger::LEVEL_ERROR, "%s: handler %d failed",
-								getName(), cm.code);
-					}
+		_quitting();
+	}
 
-					/*
-					 * This block checks for StatusListeners availability. If
-					 * any status listener has been registered, this block sends
-					 * status messages to it.
-					 */
-					if (cm.status_listener) {
-						// DEBUG
-						UOSUTIL_DERR((stderr, "Using status listener\n"));
-
-						smessage sm;
-						memset(&sm, 0, sizeof(smessage));
-
-						sm.code = cm.code;
-						sm.serial = cm.serial;
-						sm.status = getStatus();
-						sm.eh_return = handler_ret;
-						snprintf(sm.error, SM_MESSAGE_SZ, "%s",
-							getErrorString());
-
-						ret = cm.status_listener->notifyStatusMessage(&sm);
-						if (ret == FAILURE) {
-							sl->log(Logger::LEVEL_WARN,
-									"%s: cannot notify status to registered listener",
-									getName());
-						}
-
-						// DEBUG
-						UOSUTIL_DERR((stderr, "Status listener done\n"));
-					}
+	int32 Source::step(void)
+	{
+		int32 i = 0;
+		cmessage cm;
+
+		// something happened since the last step: produce again
+		_wouldBlock = false;
+
+		for (i = 0; i < US_BLOCK_TASK_QUANTUM && !_quit; i++) {
+			if (getControlPin()->tryRecvMessage(&cm) == SUCCESS)
+				_runOnce(&cm);
+			else if (_started && !_wouldBlock && !_early())
+				_runOnce(NULL);
+			else
+				break;
+		}
+
+		if (_quit) {
+			_quitting();
+			return Task::TASK_DONE;
+		}
+
+		// wait for the next period
+		if (_started && (_period || _periodRem)) {
+			wakeUpAt(_next / 1000);
+			return idleStep();
+		}
+
+		// nothing to produce now: sleep
+		if (_started && _wouldBlock)
+			return idleStep();
+
+		return i < US_BLOCK_TASK_QUANTUM ? Task::TASK_IDLE : Task::TASK_READY;
+	}
+
+	void Source::_runOnce(cmessage* cm)
+	{
+		int32 ret = 0, handler_ret = 0;
+
+		Logger* sl = getBlockManager()->getLogger();
+
+		// wake ups carry no command
+		if (cm && cm->code == EVENT_WAKEUP)
+			cm = NULL;
 
-					// set status to ready if compatible
-					if (cm.code != EVENT_START &&
-						cm.code != EVENT_STOP &&
-						cm.code != EVENT_PAUSE &&
-						cm.code != EVENT_TELL &&
-						cm.code != EVENT_COMMAND)
-						setStatus(STATUS_READY);
+		if (cm) {
+			// detect terminate event
+			if (cm->code == Block::EVENT_TERMINATE) {
+				_started = false; _quit = true;
+				sl->log(Logger::LEVEL_NOTICE,
+						"%s: terminate request received", getName());
 
-					// wait for next message
-					is_msg = 0;
+				// set status
+				setStatus(STATUS_TERMINATING);
+
+				// jump to while()
+				//continue;  TODO: Is this needed?
+			} else {
+				// check message codes and set status
+				switch (cm->code) {
+				case EVENT_PAUSE:
+					setStatus(STATUS_PAUSED);
+					_started = false;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: pause request received", getName());
+					releaseBuffers(true);
+					break;
+				case EVENT_RESET:
+					setStatus(STATUS_RESETTING);
+					_started = false;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: reset request received", getName());
+					break;
+				case EVENT_START:
+					setStatus(STATUS_STARTED);
+					_started = true;
+					_next = 0;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: start request received", getName());
+					break;
+				case EVENT_STOP:
+					setStatus(STATUS_STOPPED);
+					_started = false;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: stop request received", getName());
+					releaseBuffers(true);
+					break;
+				case EVENT_BUFFERIZE:
+					setStatus(STATUS_BUFFERIZING);
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: bufferize request received (strange)",
+							getName());
+					break;
+				case EVENT_SEEK:
+					setStatus(STATUS_SEEKING);
+					setSeekInfo(&cm->seek);
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: seek request received", getName());
+					break;
+				case EVENT_TELL:
+					setStatus(STATUS_TELLING);
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: tell request received", getName());
+					break;
+				case EVENT_SKIP:
+					setStatus(STATUS_SKIPPING);
+					setSeekInfo(&cm->seek);
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: skip request received (strange)",
+							getName());
+					break;
+				case EVENT_QUIT:
+					setStatus(STATUS_QUITTING);
+					_started = false; _quit = true;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: quit request received", getName());
+					break;
+				case EVENT_TIMEOUT:
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: timeout request received", getName());
+					break;
+				case EVENT_DATA_READY:
+					setStatus(STATUS_READY);
+					_started = false;
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: mmh, data_ready request received",
+							getName());
+					break;
+				case EVENT_COMMAND:
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: command request received", getName());
+					break;
+				default:
+					if (cm->code >= EVENT_MAX_ID)
+						sl->log(Logger::LEVEL_CRIT,
+								"%s: invalid message code (%d)",
+								getName(), cm->code);
+					else
+						sl->log(Logger::LEVEL_CRIT,
+								"%s: user message %d received", getName(),
+								cm->code);
 				}
-			}
 
-			if (_started) {
-				// do source main action: produce data
-				handler_ret = executeActionHandler(ACTION_DATA_PRODUCE);
+				// execute event handler for this message code
+				handler_ret = executeEventHandler(cm->code);
 				if (handler_ret == Block::HANDLER_UNDEFINED) {
-					_started = false; setStatus(STATUS_READY);
-					sl->log(Logger::LEVEL_CRIT,
-							"%s: undefined action handler", getName());
-				} else if (handler_ret == BlockHandler::HSUCCESS) {
-					// DO NOTHING HERE (useless log)
+					sl->log(Logger::LEVEL_NOTICE,
+							"%s: undefined handler %d", getName(), cm->code);
 				} else if (handler_ret == BlockHandler::HFAILURE) {
-					   	_started = false; setStatus(STATUS_READY);
-					sl->log(Logger::LEVEL_ERROR,
-					   		"%s: action handler returned FAILURE", getName());
-				} else if (handler_ret == BlockHandler::HCRITICAL) {
-					   	_started = false; setStatus(STATUS_READY);
-					sl->log(Logger::LEVEL_EMERG,
-					   		"%s: action handler returned CRITICAL FAILURE",
-					   		getName());
-				} else {
-					sl->log(Logger::LEVEL_CRIT,
-					   		"%s: action handler returned undefined value",
-					   		getName());
+					_started = false; setStatus(STATUS_READY);
+					sl->log(Logger::LEVEL_ERROR, "%s: handler %d failed",
+							getName(), cm->code);
+				}
+
+				/*
+				 * This block checks for StatusListeners availability. If
+				 * any status listener has been registered, this block sends
+				 * status messages to it.
+				 */
+				if (cm->status_listener) {
+					// DEBUG
+					UOSUTIL_DERR((stderr, "Using status listener\n"));
+
+					smessage sm;
+					memset(&sm, 0, sizeof(smessage));
+
+					sm.code = cm->code;
+					sm.serial = cm->serial;
+					sm.status = getStatus();
+					sm.eh_return = handler_ret;
+					snprintf(sm.error, SM_MESSAGE_SZ, "%s",
+						getErrorString());
+
+					ret = cm->status_listener->notifyStatusMessage(&sm);
+					if (ret == FAILURE) {
+						sl->log(Logger::LEVEL_WARN,
+								"%s: cannot notify status to registered listener",
+								getName());
+					}
+
+					// DEBUG
+					UOSUTIL_DERR((stderr, "Status listener done\n"));
 				}
+
+				// set status to ready if compatible
+				if (cm->code != EVENT_START &&
+					cm->code != EVENT_STOP &&
+					cm->code != EVENT_PAUSE &&
+					cm->code != EVENT_TELL &&
+					cm->code != EVENT_COMMAND)
+					setStatus(STATUS_READY);
+			}
+		}
+
+		if (_started && _tick())
+			_act();
+	}
+
+	void Source::setRate(uint32 rate, uint64 frames)
+	{
+		uint64 part = 0;
+
+		if (!rate || !frames) {
+			_period = 0; _periodRem = 0; _periodDen = 1;
+			return;
+		}
+
+		// frames * 10^9 / rate without overflowing
+		part = (frames % rate) * 1000000000;
+		_period = (frames / rate) * 1000000000 + part / rate;
+		_periodRem = part % rate;
+		_periodDen = rate;
+		_periodAcc = 0;
+	}
+
+	bool Source::_early(void)
+	{
+		if (!_period && !_periodRem)
+			return false;
+
+		return _next && Timer::getMonotonicTime() * 1000 < _next;
+	}
+
+	bool Source::_tick(void)
+	{
+		uint64 now = 0, step = 0, missed = 0;
+
+		if (!_period && !_periodRem)
+			return true;
+
+		now = Timer::getMonotonicTime() * 1000;
+
+		// the first period starts now
+		if (!_next)
+			_next = now;
+
+		if (now < _next)
+			return false;
+
+		// skip the periods missed (their deadlines passed too)
+		step = _period ? _period : 1;
+		missed = (now - _next) / step;
+		if (missed) {
+			_overruns += (uint32) missed;
+			getBlockManager()->getLogger()->log(Logger::LEVEL_WARN,
+				"%s: late, %u periods skipped", getName(), (uint32) missed);
+		}
+
+		// the deadline moves on by whole periods only
+		missed += 1;
+		_periodAcc += missed * _periodRem;
+		_next += missed * _period + _periodAcc / _periodDen;
+		_periodAcc %= _periodDen;
+
+		return true;
+	}
+
+	int32 Source::_waitTick(cmessage* cm)
+	{
+		uint64 now = 0;
+
+		for (;;) {
+			// messages are handled at once
+			if (getControlPin()->tryRecvMessage(cm) == SUCCESS)
+				return SUCCESS;
+
+			now = Timer::getMonotonicTime() * 1000;
+			if (!_next || now >= _next)
+				return FAILURE;
+
+			// sleep for whole milliseconds and wake up on the dot
+			if (_next - now >= 2000000) {
+				if (waitAny((int32) ((_next - now) / 1000000) - 1) &
+					WAIT_CONTROL)
+					continue;
+			} else {
+				Thread::sleepUntil(_next / 1000);
 			}
 		}
+	}
+
+	void Source::_act(void)
+	{
+		int32 handler_ret = 0;
+
+		Logger* sl = getBlockManager()->getLogger();
+
+		_wouldBlock = false;
+
+		// do source main action: produce data
+		handler_ret = executeActionHandler(ACTION_DATA_PRODUCE);
+		if (handler_ret == Block::HANDLER_UNDEFINED) {
+			_started = false; setStatus(STATUS_READY);
+			sl->log(Logger::LEVEL_CRIT,
+					"%s: undefined action handler", getName());
+		} else if (handler_ret == BlockHandler::HSUCCESS) {
+			// DO NOTHING HERE (useless log)
+		} else if (handler_ret == BlockHandler::HWOULDBLOCK) {
+			// nothing to produce now: sleep
+			_wouldBlock = true;
+		} else if (handler_ret == BlockHandler::HFAILURE) {
+			   	_started = false; setStatus(STATUS_READY);
+			sl->log(Logger::LEVEL_ERROR,
+			   		"%s: action handler returned FAILURE", getName());
+		} else if (handler_ret == BlockHandler::HCRITICAL) {
+			   	_started = false; setStatus(STATUS_READY);
+			sl->log(Logger::LEVEL_EMERG,
+			   		"%s: action handler returned CRITICAL FAILURE",
+			   		getName());
+		} else {
+			sl->log(Logger::LEVEL_CRIT,
+			   		"%s: action handler returned undefined value",
+			   		getName());
+		}
+
+		// fused filters go on with the data
+		if (runFusedNext())
+			_wouldBlock = false;
+	}
+
+	void Source::_quitting(void)
+	{
+		Logger* sl = getBlockManager()->getLogger();
+
+		// the chain goes on without this block
+		unfuse();
 
 		// release the quit semaphore
 		sl->log(Logger::LEVEL_CRIT,
@@ -26,9 +26,9 @@ namespace uStreamLib {
 	Wire::Wire(void)
 		: Object(UOSUTIL_RTTI_WIRE), _type(0), _bp1(NULL), _bp2(NULL),
 		_p1(NULL), _p2(NULL), _multipoint_on_bp1(false),
-		_multipoint_on_bp2(false)
+		_multipoint_on_bp2(false), _policy(BP_BLOCK)
 	{
-		// nothing to do
+		memset((void *) _drops, 0, sizeof(_drops));
 	}
 
 	Wire::~Wire(void)
@@ -39,9 +39,12 @@ namespace uStreamLib {
 		UOSUTIL_DOUT(("~Wire(): entered"));
 
 		if (_p1 && _p2) {
-			MutexLocker ml1(_p1);
-			MutexLocker ml2(_p2);
-
+			/*
+			 * Senders lock their peers table, then each peer: remove
+			 * the peers before locking the pins, so that the two lock
+			 * orders never cross. Senders are done with the peers once
+			 * their locks are taken.
+			 */
 			ret = _p1->disconnect(_p2->getBlock(), _p2);
 			if (ret == FAILURE) {
 				// DEBUG
@@ -56,6 +59,13 @@ namespace uStreamLib {
 					_p2->getAbsoluteName()));
 			}
 
+			MutexLocker ml1(_p1);
+			MutexLocker ml2(_p2);
+
+			// let pins adapt to their new peers
+			_p1->peersChanged();
+			_p2->peersChanged();
+
 			/*
 			 * Pin2 is an input pin for sure, so the buffer pool is shared among
 			 * wires. If there are no more peers connected to pin2, it means
@@ -64,7 +74,9 @@ namespace uStreamLib {
 			 */
 
 			if (!_p2->getPeersCount()) {
-				delete _bp2; _p2->_ibp = NULL; _p2->_bpSet = false;
+				if (_bp2 && _bp2->detach() <= 0)
+					delete _bp2;
+				_p2->_ibp = NULL; _p2->_bpSet = false;
 			}
 
 			/*
@@ -78,7 +90,9 @@ namespace uStreamLib {
 					_p1->getAbsoluteName(), _p2->getAbsoluteName()));
 
 				if (!_p1->getPeersCount()) {
-					delete _bp1; _p1->_ibp = NULL; _p1->_bpSet = false;
+					if (_bp1 && _bp1->detach() <= 0)
+						delete _bp1;
+					_p1->_ibp = NULL; _p1->_bpSet = false;
 				}
 			}
 		}
@@ -235,6 +249,11 @@ namespace uStreamLib {
 		int32 max_buf_count = 0, p1_bco = 0, p2_bco = 0;
 		int32 ret = 0;
 
+		BufferPool* shared_bp = NULL;
+
+		DataBuf::AllocStrategy strategy = DataBuf::ALLOC_ONUSE;
+		uint32 flags = 0, maxcount = 0;
+
 		char tmp[4096];
 
 		// get right buffers info
@@ -262,6 +281,47 @@ namespace uStreamLib {
 		UOSUTIL_DOUT(("Wire::_allocate(): BSZ = %u, BCO = %d\n", max_buf_size,
 			max_buf_count));
 
+		// back-pressure policy, an unknown one blocks
+		_policy = _getPinProperty(USPN_BACKPRESSURE);
+		if (_policy < BP_BLOCK || _policy > BP_KEEP_LATEST)
+			_policy = BP_BLOCK;
+
+		/*
+		 * When pin1 already feeds other pins (point to multipoint), look
+		 * for the buffer pool of one of them: sharing it, a buffer sent
+		 * by pin1 is filled once and referenced by every peer. Peers
+		 * table must be locked before pins (see DataPin::sendBuffer()).
+		 * Wires which drop data get their own pool: a slow peer must
+		 * not hold the buffers of the blocking ones.
+		 */
+		if (_p1->_bpSet && !_p2->_bpSet && _type == UNIDIRECTIONAL &&
+			_policy == BP_BLOCK) {
+			Enumeration* en = NULL;
+
+			_p1->lockTable(Pin::PEERS_TABLE);
+
+			en = _p1->getPeers();
+			while (en->hasMoreElements()) {
+				Pin* sibling = (Pin*) en->nextElement();
+				Wire* w = _p1->getWire(sibling);
+
+				if (w && w->getBackPressure() != BP_BLOCK)
+					continue;
+
+				if (sibling != _p2 && sibling->_bpSet && sibling->_ibp) {
+					shared_bp = sibling->_ibp; break;
+				}
+			}
+
+			_p1->unlockTable(Pin::PEERS_TABLE);
+		}
+
+		// get alignment and layout of buffers
+		_getAllocOptions(&strategy, &flags);
+
+		// get the count buffer pools can grow to
+		maxcount = (uint32) _getPinProperty(USPN_MAXBUFCO);
+
 		// lock pins
 		MutexLocker ml1(_p1);
 		MutexLocker ml2(_p2);
@@ -280,7 +340,8 @@ namespace uStreamLib {
 					return FAILURE;
 
 				// allocate buffer pool for Pin 1
-				ret = _bp1->init(tmp, max_buf_size, max_buf_count);
+				ret = _bp1->init(tmp, max_buf_size, max_buf_count,
+					8388608, strategy, flags, maxcount);
 				if (ret == FAILURE) {
 					delete _bp1; return FAILURE;
 				}
@@ -317,6 +378,20 @@ namespace uStreamLib {
 		 * a buffer pool only for pin2.
 		 */
 
+		if (!_p2->_bpSet && shared_bp) {
+			// share the buffer pool of pin1's other peers
+			_bp2 = shared_bp;
+			_bp2->attach();
+
+			// associate bp2 to pin 2
+			_p2->_ibp = _bp2;
+			_p2->_bpSet = true;
+
+			// DEBUG
+			UOSUTIL_DOUT(("Wire::_allocate(): pin %s shares bp %s\n",
+				_p2->getAbsoluteName(), _bp2->getName()));
+		}
+
 		if (!_p2->_bpSet) {
 			// build buffer pool name
 			snprintf(tmp, sizeof(tmp), "BP2[%s,%s]", _p1->getAbsoluteName(),
@@ -328,7 +403,8 @@ namespace uStreamLib {
 				return FAILURE;
 
 			// allocate buffer pool for Pin 2
-			ret = _bp2->init(tmp, max_buf_size, max_buf_count);
+			ret = _bp2->init(tmp, max_buf_size, max_buf_count,
+				8388608, strategy, flags, maxcount);
 			if (ret == FAILURE) {
 				delete _bp2; return FAILURE;
 			}
@@ -361,7 +437,60 @@ namespace uStreamLib {
 		_p2->_real_bufsz = max_buf_size;
 		_p2->_real_bufcount = max_buf_count;
 
+		// let pins adapt to their new peers
+		_p1->peersChanged();
+		_p2->peersChanged();
+
 		// ok
 		return SUCCESS;
 	}
+
+	int32 Wire::setBackPressure(int32 policy)
+	{
+		if (policy < BP_BLOCK || policy > BP_KEEP_LATEST || !_p2)
+			return FAILURE;
+
+		// the input pin may need another kind of queue
+		MutexLocker ml(_p2);
+
+		Atomic::store(&_policy, policy);
+		_p2->peersChanged();
+
+		// ok
+		return SUCCESS;
+	}
+
+	int32 Wire::_getPinProperty(char* key)
+	{
+		int32 value = 0;
+
+		if (_p2->getInt(key, &value) == SUCCESS)
+			return value;
+		if (_p1->getInt(key, &value) == SUCCESS)
+			return value;
+		return 0;
+	}
+
+	void Wire::_getAllocOptions(DataBuf::AllocStrategy* strategy,
+		uint32* flags)
+	{
+		int32 align = _getPinProperty(USPN_BUFALIGN);
+
+		*strategy = DataBuf::ALLOC_ONUSE;
+		*flags = 0;
+
+		// alignment of each buffer
+		if (align > US_CACHE_LINE_SIZE)
+			*strategy = (DataBuf::AllocStrategy) (*strategy |
+				DataBuf::ALLOC_ALIGN_PAGE);
+		else if (align > 0)
+			*strategy = (DataBuf::AllocStrategy) (*strategy |
+				DataBuf::ALLOC_ALIGN_CACHE);
+
+		// layout of the buffer pool
+		if (_getPinProperty(USPN_CONTIGUOUS))
+			*flags |= BufferPool::POOL_CONTIGUOUS;
+		if (_getPinProperty(USPN_HUGEPAGES))
+			*flags |= BufferPool::POOL_HUGEPAGES;
+	}
 }